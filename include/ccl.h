@@ -30,12 +30,14 @@
 #include "ccl_cls.h"
 #include "ccl_background.h"
 #include "ccl_correlation.h"
+#include "ccl_cluster_counts.h"
 #include "ccl_massfunc.h"
 #include "ccl_neutrinos.h"
 #include "ccl_bcm.h"
 #include "ccl_bbks.h"
 #include "ccl_eh.h"
 #include "ccl_halomod.h"
+#include "ccl_covariance.h"
 #include "ccl_class.h"
 
 CCL_BEGIN_DECLS
@@ -2,6 +2,8 @@
 #ifndef __CCL_CLS_H_INCLUDED__
 #define __CCL_CLS_H_INCLUDED__
 
+#include <gsl/gsl_integration.h>
+
 typedef enum ccl_tracer_t
 {
   ccl_number_counts_tracer = 1,
@@ -20,8 +22,57 @@ typedef enum ccl_tracer_func_t
   ccl_trf_wM = 207, //Magnification window function
 } ccl_tracer_func_t;
 
+//Methods available to compute non-Limber power spectra
+typedef enum ccl_nonlimber_method_t
+{
+  ccl_nonlimber_native=1, //Native FFTLog calculation (default)
+  ccl_nonlimber_angpow=2, //Angpow (only for number counts without magnification)
+} ccl_nonlimber_method_t;
+
+typedef enum ccl_cl_component_t
+{
+  ccl_clc_density       = 0, //Clustering (b(z) x N(z))
+  ccl_clc_rsd           = 1, //Redshift-space distortions
+  ccl_clc_magnification = 2, //Lensing magnification
+  ccl_clc_lensing       = 3, //Weak lensing shear or CMB lensing convergence
+  ccl_clc_ia            = 4, //Intrinsic alignments
+} ccl_cl_component_t;
+
+//Number of kernel components
+#define CCL_CL_NCOMP 5
+//Bit mask for a given kernel component
+#define CCL_CLC_MASK(c) (1<<(c))
+//Bit mask including all kernel components
+#define CCL_CLC_ALL ((1<<CCL_CL_NCOMP)-1)
+
 CCL_BEGIN_DECLS
 
+/**
+ * ClTracerSpec structure. Holds the cosmology-independent part
+ * of a ClTracer: the normalized N(z) and its support in redshift,
+ * and splines for the redshift-dependent bias, magnification and
+ * alignment functions. A spec can be bound to any number of
+ * cosmologies with ccl_cl_tracer_bind.
+ */
+typedef struct {
+  int tracer_type; //Type (see above)
+  double zmin; //Limits in z where N(z) has support
+  double zmax;
+  double z_source; //Redshift of the source plane (for CMB lensing)
+  int has_rsd;
+  int has_magnification;
+  int has_intrinsic_alignment;
+  SplPar *spl_nz; //Spline for normalized N(z)
+  SplPar *spl_bz; //Spline for linear bias
+  SplPar *spl_sz; //Spline for magnification bias
+  SplPar *spl_rf; //Spline for red fraction
+  SplPar *spl_ba; //Spline for alignment bias
+  int nz_n; //Number of nodes in the normalized N(z)
+  double *z_n; //Redshift nodes of N(z)
+  double *n_norm; //Normalized N(z) at each node
+  double z_mean; //Mean redshift of N(z)
+} CCL_ClTracerSpec;
+
 /**
  * ClTracer structure, used to contain everything
  * that a Cl tracer could have, such as splines for
@@ -46,8 +97,69 @@ typedef struct {
   SplPar *spl_ba; //Spline for alignment bias
   SplPar *spl_wL; //Spline for lensing kernel
   SplPar *spl_wM; //Spline for magnification
+  CCL_ClTracerSpec *spec; //Cosmology-independent part of this tracer (owns spl_nz to spl_ba)
+  int owns_spec; //1 if spec should be freed together with this tracer
+  double nz_shift; //Shift and stretch currently applied to N(z) (see ccl_cl_tracer_nz_transform)
+  double nz_stretch;
+  SplPar *spl_nz_own; //Transformed N(z), if this tracer doesn't own its spec
 } CCL_ClTracer;
 
+/**
+ * Constructor for a ClTracerSpec. Takes the same arguments as ccl_cl_tracer, but
+ * doesn't need a cosmology. N(z) is normalized using the default GSL parameters.
+ * @param Tracer_type pass ccl_number_counts_tracer (number counts), ccl_weak_lensing_tracer (weak lensing) or ccl_cmb_lensing_tracer (CMB lensing)
+ * @param has_rsd Set to 1 if you want to compute the RSD contribution to number counts (0 otherwise)
+ * @param has_magnification Set to 1 if you want to compute the magnification contribution to number counts (0 otherwise)
+ * @param has_intrinsic_alignment Set to 1 if you want to compute the IA contribution to shear
+ * @param nz_n Number of bins in z_n and n
+ * @param z_n Redshifts for each redshift interval of n
+ * @param n Number count of objects per redshift interval (Note: arbitrary normalization - renormalized inside)
+ * @param nz_b Number of bins in z_b and b
+ * @param z_b Redshifts for each redshift interval of b
+ * @param b Clustering bias in each redshift bin
+ * @param nz_s Number of bins in z_s and s
+ * @param z_s Redshifts for each redshift interval of s
+ * @param s Magnification bias in each redshift bin
+ * @param nz_ba Number of bins in z_ba and ba
+ * @param z_ba Redshifts for each redshift interval of ba
+ * @param ba Alignment bias in each redshift bin
+ * @param nz_rf Number of bins in z_f and f
+ * @param z_rf Redshifts for each redshift interval of rf
+ * @param rf Aligned red fraction in each redshift bin
+ * @param z_source Redshift of source plane for CMB lensing (z~1100 for CMB lensing).
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.c
+ * @return CCL_ClTracerSpec object
+ */
+CCL_ClTracerSpec *ccl_cl_tracer_spec_new(int tracer_type,
+					 int has_rsd,int has_magnification,int has_intrinsic_alignment,
+					 int nz_n,double *z_n,double *n,
+					 int nz_b,double *z_b,double *b,
+					 int nz_s,double *z_s,double *s,
+					 int nz_ba,double *z_ba,double *ba,
+					 int nz_rf,double *z_rf,double *rf,
+					 double z_source,int *status);
+
+/**
+ * Destructor for a ClTracerSpec. Must not be called while tracers bound to it are in use.
+ * @param spec a ClTracerSpec
+ * @return void
+ */
+void ccl_cl_tracer_spec_free(CCL_ClTracerSpec *spec);
+
+/**
+ * Creates a ClTracer for a given cosmology from a ClTracerSpec.
+ * Only the distance-dependent quantities (support in comoving distance,
+ * lensing and magnification kernels) are computed. The spec is shared,
+ * not copied, and must outlive the returned tracer.
+ * @param cosmo Cosmological parameters
+ * @param spec a ClTracerSpec
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.c
+ * @return CCL_ClTracer object
+ */
+CCL_ClTracer *ccl_cl_tracer_bind(ccl_cosmology *cosmo,CCL_ClTracerSpec *spec,int *status);
+
 
 /**
  * Constructor for a ClTracer.
@@ -169,6 +281,27 @@ CCL_ClTracer *ccl_cl_tracer_lensing_simple(ccl_cosmology *cosmo,
  */
 CCL_ClTracer *ccl_cl_tracer_cmblens(ccl_cosmology *cosmo,double z_source,int *status);
 
+/**
+ * Applies a shift and a stretch to the redshift distribution of a tracer:
+ * N'(z) = N(z_mean+(z-z_mean-dz)/stretch)/stretch,
+ * where z_mean is the mean redshift of the original N(z). The transformation
+ * is always applied with respect to the original N(z) and preserves its normalization.
+ * The N(z) spline is updated in place, and the lensing and magnification kernels
+ * (if any) are recomputed from cumulative integrals over a fixed grid in
+ * comoving distance, without allocating new splines.
+ * Biases and alignment parameters are not affected.
+ * Transformations that would move any N(z) node below z=0 are rejected, leaving the tracer unchanged.
+ * @param cosmo Cosmological parameters (must be the cosmology the tracer was created with)
+ * @param clt a ClTracer of type ccl_number_counts_tracer or ccl_weak_lensing_tracer
+ * @param dz shift in redshift
+ * @param stretch stretch factor around the mean redshift (must be positive)
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.c
+ * @return void
+ */
+void ccl_cl_tracer_nz_transform(ccl_cosmology *cosmo,CCL_ClTracer *clt,
+				double dz,double stretch,int *status);
+
 /**
  * Destructor for a Cltracer
  * @param clt a Cltracer
@@ -209,7 +342,25 @@ double ccl_get_tracer_fa(ccl_cosmology *cosmo,CCL_ClTracer *clt,double a,int fun
 int ccl_get_tracer_fas(ccl_cosmology *cosmo,CCL_ClTracer *clt,int na,double *a,double *fa,
 		       int func_code,int *status);
 
-//Workspace for C_ell computations
+/**
+ * Limber kernel of a tracer at a given multipole, such that the Limber power spectrum of
+ * two tracers is C_ell = Integral[ dchi q_1(chi) q_2(chi) P((ell+1/2)/chi,a(chi)) / chi^2 ].
+ * All the kernel components of the tracer are included.
+ * @param cosmo Cosmological parameters
+ * @param clt ClTracer object
+ * @param l angular multipole
+ * @param n_chi number of comoving distances
+ * @param chi comoving distances in Mpc at which the kernel will be evaluated
+ * @param kernel output array with the n_chi values of q(chi)
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ */
+void ccl_get_tracer_limber_kernel(ccl_cosmology *cosmo,CCL_ClTracer *clt,double l,
+				  int n_chi,double *chi,double *kernel,int *status);
+
+//Workspace for C_ell computations.
+//It also owns the buffers, interpolation and integration workspaces used by
+//ccl_angular_cls, so that repeated calls with the same workspace don't allocate memory.
+//A workspace should therefore not be used by several threads at the same time.
 typedef struct {
   int lmax; //*Maximum multipole
   int l_limber; //*All power spectra for l>l_limber will be computed using Limber's approximation
@@ -217,6 +368,15 @@ typedef struct {
   int l_linstep; //*Linear step used at high l
   int n_ls; //Number of multipoles that result from the previous combination of parameters
   int *l_arr; //*Array of multipole values resulting from the previous parameters
+  double *l_nodes; //l_arr as doubles
+  double *cl_nodes; //Buffer for C_ell at the multipoles in l_arr
+  SplPar *spl_nodes; //Spline used to interpolate cl_nodes (allocated on first use)
+  int n_iteration; //Size of the integration workspaces below
+  gsl_integration_workspace *w_qag; //Integration workspaces (allocated on first use)
+  gsl_integration_cquad_workspace *w_cquad;
+  int nonlimber_method; //*Method used for l<=l_limber (see ccl_nonlimber_method_t)
+  int n_chi_nonlimber; //Number of radial samples allocated in buf_nonlimber
+  double *buf_nonlimber; //Buffer for the non-Limber calculation (allocated on first use)
 } CCL_ClWorkspace;
 
 //CCL_ClWorkspace constructor
@@ -229,7 +389,12 @@ CCL_ClWorkspace *ccl_cl_workspace_new_limber(int lmax, double l_logstep,int l_li
 void ccl_cl_workspace_free(CCL_ClWorkspace *w);
 
 /**
- * Computes limber or non-limber power spectrum for two different tracers
+ * Computes limber or non-limber power spectrum for two different tracers.
+ * Multipoles l<=w->l_limber are computed beyond the Limber approximation.
+ * By default this uses a native FFTLog calculation, where the exact projection
+ * of the linear power spectrum replaces its Limber counterpart:
+ * C_ell = C_ell^Limber[psp] + C_ell^exact[P_lin] - C_ell^Limber[P_lin].
+ * Angpow can be selected instead by setting w->nonlimber_method=ccl_nonlimber_angpow.
  * @param cosmo Cosmological parameters
  * @param w a ClWorkspace
  * @param clt1 a Cltracer
@@ -245,6 +410,79 @@ void ccl_angular_cls(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
 		     CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
 		     int nl_out,int *l,double *cl,int *status);
 
+/**
+ * Computes the Limber power spectrum for two tracers directly at a set of
+ * (not necessarily integer) multipoles, without interpolating between workspace nodes.
+ * @param cosmo Cosmological parameters
+ * @param w a ClWorkspace, only used for its integration workspaces (NULL to use a temporary one)
+ * @param clt1 a Cltracer
+ * @param clt2 a Cltracer
+ * @param psp the 3D power spectrum to project (NULL to use the non-linear matter power spectrum)
+ * @param nl number of multipoles
+ * @param l array of multipoles
+ * @param cl the C_ell output array
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.c
+ * @return void
+ */
+void ccl_angular_cls_limber(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+			    CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
+			    int nl,double *l,double *cl,int *status);
+
+/**
+ * Angular power spectra between each pair of kernel components
+ * (see ccl_cl_component_t) of two tracers. Since C_ell is a quadratic
+ * form in the amplitudes of these components, this can be used to
+ * recompute C_ell for new values of e.g. the galaxy bias or IA amplitudes
+ * without redoing any integrals.
+ */
+typedef struct {
+  int nl; //Number of multipoles
+  int *l; //Multipoles at which the C_ells are stored
+  int mask1; //Bit masks of the components present in each tracer
+  int mask2;
+  double *cl_comp; //C_ell for each pair of components c1, c2, stored in cl_comp[(c1*CCL_CL_NCOMP+c2)*nl+il]
+} CCL_ClComponents;
+
+/**
+ * Computes the angular power spectra between all pairs of kernel components
+ * of two tracers. Non-Limber corrections are applied to l<=w->l_limber as in
+ * ccl_angular_cls, except that Angpow is never used.
+ * @param cosmo Cosmological parameters
+ * @param w a ClWorkspace
+ * @param clt1 a Cltracer
+ * @param clt2 a Cltracer
+ * @param psp the 3D power spectrum to project (NULL to use the non-linear matter power spectrum)
+ * @param nl_out the number of ell values
+ * @param l an array of ell values
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.c
+ * @return CCL_ClComponents object
+ */
+CCL_ClComponents *ccl_angular_cls_components(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+					     CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
+					     int nl_out,int *l,int *status);
+
+/**
+ * Combines the component power spectra into a total C_ell:
+ * C_ell = sum_{c1,c2} amp1[c1] * amp2[c2] * C_ell^{c1,c2}
+ * For instance, a change in the linear bias b(z) -> A*b(z) of tracer 1 corresponds to
+ * amp1[ccl_clc_density]=A, and a change in the IA amplitude to amp[ccl_clc_ia].
+ * @param clc a ClComponents object
+ * @param amp1 CCL_CL_NCOMP amplitudes for the components of tracer 1 (NULL for all 1)
+ * @param amp2 CCL_CL_NCOMP amplitudes for the components of tracer 2 (NULL for all 1)
+ * @param cl output array with clc->nl values
+ * @return void
+ */
+void ccl_angular_cls_combine(CCL_ClComponents *clc,double *amp1,double *amp2,double *cl);
+
+/**
+ * Destructor for a ClComponents object
+ * @param clc a ClComponents object
+ * @return void
+ */
+void ccl_cl_components_free(CCL_ClComponents *clc);
+
 CCL_END_DECLS
 
 
@@ -0,0 +1,47 @@
+/** @file */
+
+#ifndef __CCL_CLUSTER_COUNTS_H_INCLUDED__
+#define __CCL_CLUSTER_COUNTS_H_INCLUDED__
+
+CCL_BEGIN_DECLS
+
+/**
+ * Selection function of a cluster sample, or any other kernel S(M,z) weighting
+ * the mass function in the counts. It is called with all the masses of the
+ * quadrature grid at once, for a single redshift, and may be called
+ * concurrently from several threads.
+ * @param n_m number of masses
+ * @param halomass halo masses in units of Msun
+ * @param z redshift
+ * @param sel output selection S(M,z) for each mass
+ * @param params user parameters
+ */
+typedef void (*ccl_cluster_selection)(int n_m, double *halomass, double z, double *sel, void *params);
+
+/**
+ * Expected number of haloes in bins of mass and redshift,
+ * N_ij = 4 pi f_sky int_{z_j} dz dV/dz dOmega int_{M_i} dlog10(M) dn/dlog10(M) S(M,z).
+ * The mass function is tabulated once on a fixed grid covering all the bins, with
+ * spline_params.N_M_HM points per decade in mass, and each bin is integrated with
+ * Simpson's rule. Redshift slices of the grid are computed in parallel.
+ * @param cosmo Cosmological parameters
+ * @param n_z_bins number of redshift bins
+ * @param z_edges edges of the redshift bins, of size n_z_bins+1, in increasing order
+ * @param n_m_bins number of mass bins
+ * @param m_edges edges of the mass bins in units of Msun, of size n_m_bins+1, in increasing order
+ * @param odelta overdensity with respect to the matter density used for halo masses.
+ *        The virial overdensity at each redshift is used if odelta<=0.
+ * @param f_sky sky fraction of the survey
+ * @param selection selection function S(M,z). If NULL, S=1.
+ * @param sel_params parameters passed to the selection function
+ * @param counts output counts, with counts[iz*n_m_bins+im] the number of haloes in the iz-th redshift bin and the im-th mass bin
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ */
+void ccl_cluster_counts(ccl_cosmology *cosmo, int n_z_bins, double *z_edges,
+			int n_m_bins, double *m_edges, double odelta, double f_sky,
+			ccl_cluster_selection selection, void *sel_params,
+			double *counts, int *status);
+
+CCL_END_DECLS
+
+#endif
@@ -145,6 +145,8 @@ typedef struct ccl_spline_params {
   int LOGM_SPLINE_NM;
   double LOGM_SPLINE_MIN;
   double LOGM_SPLINE_MAX;
+  int N_M_HM;
+  int SIGMA_SPLINE_2D;
 
   //PS a and k spline
   int A_SPLINE_NA_PK;
@@ -276,6 +278,9 @@ typedef struct ccl_parameters {
 } ccl_parameters;
 
 
+// Number of correlation function multipoles (l=0, 2, 4) cached per scale factor
+#define CCL_XI_CACHE_NL 3
+
 /**
  * Struct containing references to gsl splines for distance and acceleration calculations
  */
@@ -304,6 +309,11 @@ typedef struct ccl_data {
   gsl_spline * logsigma;
   gsl_spline * dlnsigma_dlogm;
 
+  // Functions of halo mass M and scale factor a, used instead of
+  // the two splines above when the growth is scale-dependent
+  gsl_spline2d * logsigma_2d;
+  gsl_spline2d * dlnsigma_dlogm_2d;
+
   // splines for halo mass function
   gsl_spline * alphahmf;
   gsl_spline * betahmf;
@@ -315,9 +325,13 @@ typedef struct ccl_data {
   ccl_p2d_t * p_lin;
   ccl_p2d_t * p_nl;
 
-  // real-space splines for RSD
-  SplPar* rsd_splines[3];
-  double rsd_splines_scalefactor;
+  // real-space splines for RSD: multipoles xi_l^2(r) (l=0, 2, 4) of the
+  // correlation function, cached for each scale factor xi_cache_a[i] in
+  // xi_cache_splines[CCL_XI_CACHE_NL*i+l/2] (see ccl_cosmology_clear_xi_cache)
+  int n_xi_cache;
+  int n_xi_cache_alloc;
+  double *xi_cache_a;
+  SplPar **xi_cache_splines;
 } ccl_data;
 
 /**
@@ -431,6 +445,32 @@ ccl_parameters ccl_parameters_read_yaml(const char * filename, int *status);
  */
 void ccl_cosmology_free(ccl_cosmology * cosmo);
 
+/**
+ * Create a copy of a cosmology for use by a single thread. The copy shares all
+ * the splines of the original, but has its own interpolation accelerators. It
+ * must only be used once the original has computed everything it needs, and
+ * does not outlive it.
+ * @param cosmo Cosmology to copy
+ * @return the copy, or NULL if there was not enough memory
+ */
+ccl_cosmology * ccl_cosmology_thread_copy(ccl_cosmology * cosmo);
+
+/**
+ * Free a copy created with ccl_cosmology_thread_copy. The shared splines are not freed.
+ * @param cosmo Copy to free
+ */
+void ccl_cosmology_thread_copy_free(ccl_cosmology * cosmo);
+
+/**
+ * Free the multipoles of the 3D correlation function cached by ccl_correlation_3d and
+ * related functions. The cache holds one entry per distinct scale factor and is not
+ * bounded otherwise, so long-lived cosmologies evaluated at many scale factors should
+ * clear it from time to time. Must not be called on a copy made with
+ * ccl_cosmology_thread_copy, which shares the cache with the original.
+ * @param cosmo Cosmology whose cache is cleared
+ */
+void ccl_cosmology_clear_xi_cache(ccl_cosmology * cosmo);
+
 int ccl_get_pk_spline_na(ccl_cosmology *cosmo);
 int ccl_get_pk_spline_nk(ccl_cosmology *cosmo);
 void ccl_get_pk_spline_a_array(ccl_cosmology *cosmo,int ndout,double* doutput,int *status);
@@ -41,8 +41,143 @@ void ccl_correlation(ccl_cosmology *cosmo,
 		     int corr_type,int do_taper_cl,double *taper_cl_limits,int flag_method,
 		     int *status);
 
+/**
+ * Computes the correlation function averaged over angular bins, using bin-averaged
+ * kernels instead of evaluating it at single angles. For CCL_CORR_BESSEL and
+ * CCL_CORR_FFTLOG the average is weighted by theta (flat sky). For CCL_CORR_LGNDRE
+ * it is an average over the solid angle of the bin.
+ * @param cosmo :Cosmological parameters
+ * @param n_ell : number of multipoles in the input power spectrum
+ * @param ell : multipoles at which the power spectrum is evaluated
+ * @param cls : input power spectrum
+ * @param n_bins : number of angular bins
+ * @param theta_lo : lower edges of the bins in degrees
+ * @param theta_hi : upper edges of the bins in degrees
+ * @param wtheta : the bin-averaged correlation function will be returned in this array, which should be pre-allocated
+ * @param corr_type : type of correlation function (see ccl_correlation)
+ * @param do_taper_cl : key for tapering
+ * @param taper_cl_limits : limits of tapering
+ * @param flag_method : method to compute the correlation function (see ccl_correlation)
+ */
+void ccl_correlation_binned(ccl_cosmology *cosmo,
+			    int n_ell,double *ell,double *cls,
+			    int n_bins,double *theta_lo,double *theta_hi,double *wtheta,
+			    int corr_type,int do_taper_cl,double *taper_cl_limits,int flag_method,
+			    int *status);
+
+/**
+ * Computes the correlation functions of two tracers for several correlation types,
+ * going directly from the tracers to the correlation function with FFTLog.
+ * The Limber power spectrum is evaluated at the ELL_MIN_CORR..ELL_MAX_CORR log-spaced
+ * multipoles used by FFTLog, without intermediate interpolation, and is shared by all
+ * correlation types.
+ * @param cosmo :Cosmological parameters
+ * @param clt1 : first tracer
+ * @param clt2 : second tracer
+ * @param psp : 3D power spectrum to project (NULL to use the non-linear matter power spectrum)
+ * @param n_theta : number of output values of the separation angle (theta)
+ * @param theta : values of the separation angle in degrees.
+ * @param n_corr : number of correlation types
+ * @param corr_type : correlation types (see ccl_correlation)
+ * @param wtheta : output correlation functions, with wtheta[ic*n_theta+ith] the ic-th type at theta[ith]. Should be pre-allocated
+ * @param do_taper_cl : key for tapering
+ * @param taper_cl_limits : limits of tapering
+ */
+void ccl_correlation_tracers(ccl_cosmology *cosmo,
+			     CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
+			     int n_theta,double *theta,
+			     int n_corr,int *corr_type,double *wtheta,
+			     int do_taper_cl,double *taper_cl_limits,
+			     int *status);
+
+/**
+ * Weights relating angular power spectra to correlation functions:
+ * w(theta_i) = Sum_{b<n_ell} w[i*n_ell+b] * C(l_b)
+ * where l_b = b for the full-sky Legendre weights (ccl_corr_matrix_new), or the
+ * multipoles passed to ccl_corr_matrix_bessel_new for the flat-sky Bessel weights.
+ * The weights only depend on the angular binning, so they can be computed once
+ * and applied to any number of power spectra or covariance matrices.
+ */
+typedef struct {
+  int corr_type; //Correlation type
+  int n_theta; //Number of angles or angular bins
+  int n_ell; //Number of multipoles
+  double *w; //Weights, stored as w[i*n_ell+l]
+} CCL_CorrMatrix;
+
+/**
+ * Computes the Legendre weights for full-sky correlation functions.
+ * The polynomials are computed with stable three-term recurrences.
+ * @param corr_type : type of correlation function (CCL_CORR_GG or CCL_CORR_GL)
+ * @param ell_max : the sum runs over 0<l<ell_max
+ * @param n_theta : number of angles or angular bins
+ * @param theta_lo : angles in degrees, or lower bin edges if theta_hi is not NULL
+ * @param theta_hi : upper bin edges in degrees. If not NULL, the weights are
+ *                   averaged over each bin in solid angle. If NULL, they are
+ *                   evaluated at theta_lo.
+ * @param status : status flag
+ * @return CCL_CorrMatrix object
+ */
+CCL_CorrMatrix *ccl_corr_matrix_new(int corr_type,int ell_max,int n_theta,
+				    double *theta_lo,double *theta_hi,int *status);
+
+/**
+ * Applies the weights to n_cls power spectra with a single matrix product.
+ * @param cm : CCL_CorrMatrix object
+ * @param n_cls : number of power spectra
+ * @param cls : power spectra, stored as cls[j*cm->n_ell+l] for 0<=l<cm->n_ell
+ * @param wtheta : output correlation functions, stored as wtheta[j*cm->n_theta+i]
+ */
+void ccl_corr_matrix_apply(CCL_CorrMatrix *cm,int n_cls,double *cls,double *wtheta);
+
+/**
+ * Computes flat-sky Bessel weights, w(theta) = Integral[ l dl J_n(l theta) C_l ]/(2 pi),
+ * discretized at a set of multipoles. These support all correlation types, including
+ * xi+ and xi-, and can be used with binned power spectra and covariances.
+ * @param corr_type : type of correlation function (see ccl_correlation)
+ * @param n_ell : number of multipoles
+ * @param ell : multipoles (or bin centres). If NULL, l=0,1,...,n_ell-1
+ * @param delta_ell : width of each multipole bin. If NULL, all widths are 1
+ * @param n_theta : number of angles or angular bins
+ * @param theta_lo : angles in degrees, or lower bin edges if theta_hi is not NULL
+ * @param theta_hi : upper bin edges in degrees. If not NULL, the Bessel functions are
+ *                   averaged analytically over each bin with weight theta.
+ * @param status : status flag
+ * @return CCL_CorrMatrix object
+ */
+CCL_CorrMatrix *ccl_corr_matrix_bessel_new(int corr_type,int n_ell,double *ell,double *delta_ell,
+					   int n_theta,double *theta_lo,double *theta_hi,
+					   int *status);
+
+/**
+ * Projects a covariance matrix between two power spectra into the covariance between
+ * the two corresponding correlation functions: cov_xi = W1 cov_cl W2^T.
+ * Both matrices must be defined on the same multipoles (status is set to
+ * CCL_ERROR_INCONSISTENT otherwise).
+ * @param cm1 : weights of the first correlation function
+ * @param cm2 : weights of the second correlation function
+ * @param cov_cl : covariance of the power spectra, of size cm1->n_ell * cm2->n_ell
+ * @param cov_xi : output covariance, of size cm1->n_theta * cm2->n_theta
+ * @param status : status flag
+ */
+void ccl_corr_matrix_project_cov(CCL_CorrMatrix *cm1,CCL_CorrMatrix *cm2,
+				 double *cov_cl,double *cov_xi,int *status);
+
+/**
+ * Same as ccl_corr_matrix_project_cov for a covariance that is diagonal in ell
+ * (e.g. Gaussian), given by its diagonal var_cl (of size cm1->n_ell, which must equal cm2->n_ell).
+ */
+void ccl_corr_matrix_project_cov_diag(CCL_CorrMatrix *cm1,CCL_CorrMatrix *cm2,
+				      double *var_cl,double *cov_xi,int *status);
+
+//CCL_CorrMatrix destructor
+void ccl_corr_matrix_free(CCL_CorrMatrix *cm);
+
 /**
  * Computes the 3dcorrelation function (wrapper)
+ * Without tapering, the multipoles of the correlation function at a are computed once and
+ * cached in cosmo, so later calls at the same scale factor only interpolate them. The cache
+ * gains one entry per distinct scale factor; free it with ccl_cosmology_clear_xi_cache.
  * @param cosmo :Cosmological parameters
  * @param a : scale factor
  * @param n_r : number of output values of distance r
@@ -62,6 +197,53 @@ void ccl_correlation_multipole(ccl_cosmology *cosmo,double a,double beta,
 
 void ccl_correlation_multipole_spline(ccl_cosmology *cosmo,double a,int *status);
 
+/**
+ * Computes the multipoles of the 3D correlation function for a list of scale factors
+ * and stores them in the cosmology's cache. All scale factors that are not cached yet
+ * are transformed in a single batched pass. Subsequent calls to ccl_correlation_3d
+ * (without tapering), ccl_correlation_multipole, ccl_correlation_3dRsd and
+ * ccl_correlation_pi_sigma at these scale factors use the cache.
+ * @param cosmo : Cosmological parameters
+ * @param n_a : number of scale factors
+ * @param a : scale factors
+ */
+void ccl_correlation_multipole_cache(ccl_cosmology *cosmo,int n_a,double *a,int *status);
+
+/**
+ * Tabulates the multipole xi_l^2(r) of the 3D correlation function (without redshift-space
+ * distortion factors) on a 2D grid of scale factors and distances, using the cache of multipoles.
+ * l=0 gives the real-space correlation function.
+ * @param cosmo : Cosmological parameters
+ * @param l : multipole order (0, 2 or 4)
+ * @param n_a : number of scale factors
+ * @param a : scale factors
+ * @param n_r : number of distances
+ * @param r : distances in Mpc
+ * @param xi : output table, with xi[ia*n_r+ir] the value at a[ia] and r[ir]. Should be pre-allocated
+ */
+void ccl_correlation_multipole_table(ccl_cosmology *cosmo,int l,
+				     int n_a,double *a,int n_r,double *r,
+				     double *xi,int *status);
+
+/**
+ * Computes the multipoles (l=0, 2, 4) of the redshift-space power spectrum in the Kaiser
+ * approximation for a set of scale factors, and optionally the corresponding multipoles of
+ * the correlation function, obtained from the same sampling of P(k,a).
+ * @param cosmo : Cosmological parameters
+ * @param n_a : number of scale factors
+ * @param a : scale factors
+ * @param beta : growth rate divided by bias, for each scale factor
+ * @param n_k : number of wavenumbers
+ * @param k : wavenumbers in Mpc^-1
+ * @param pk_ell : output power spectrum multipoles, with pk_ell[(ia*3+il)*n_k+ik] the multipole l=2*il at a[ia] and k[ik]. Should be pre-allocated
+ * @param n_r : number of distances (ignored if xi_ell is NULL)
+ * @param r : distances in Mpc (ignored if xi_ell is NULL)
+ * @param xi_ell : output correlation function multipoles, with xi_ell[(ia*3+il)*n_r+ir] the multipole l=2*il at a[ia] and r[ir]. Pass NULL to skip them
+ */
+void ccl_rsd_multipoles(ccl_cosmology *cosmo,int n_a,double *a,double *beta,
+			int n_k,double *k,double *pk_ell,
+			int n_r,double *r,double *xi_ell,int *status);
+
 void ccl_correlation_3dRsd(ccl_cosmology *cosmo,double a,
 			   int n_s,double *s,double mu,double beta,double *xi,
 			   int use_spline, int *status);
@@ -74,6 +256,23 @@ void ccl_correlation_pi_sigma(ccl_cosmology *cosmo,double a,double beta,
 			   double pi,int n_sig,double *sig,double *xi,
 			   int use_spline,int *status);
 
+/**
+ * Computes the redshift-space correlation function on a grid of pi and sigma values.
+ * The multipoles are only computed once for all grid cells.
+ * @param cosmo : Cosmological parameters
+ * @param a : scale factor
+ * @param beta : growth rate divided by bias
+ * @param n_pi : number of values of the longitudinal separation pi
+ * @param pi : values of pi in Mpc
+ * @param n_sig : number of values of the transverse separation sigma
+ * @param sig : values of sigma in Mpc
+ * @param xi : output correlation function, with xi[j*n_sig+i] the value at pi[j] and sig[i]. Should be pre-allocated
+ * @param use_spline : use the cached multipole splines (1) or recompute the multipoles (0)
+ */
+void ccl_correlation_pi_sigma_grid(ccl_cosmology *cosmo,double a,double beta,
+				   int n_pi,double *pi,int n_sig,double *sig,double *xi,
+				   int use_spline,int *status);
+
 CCL_END_DECLS
 
 #endif
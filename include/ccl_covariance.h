@@ -0,0 +1,93 @@
+/** @file */
+
+#ifndef __CCL_COVARIANCE_H_INCLUDED__
+#define __CCL_COVARIANCE_H_INCLUDED__
+
+CCL_BEGIN_DECLS
+
+/**
+ * Index of the tracer pair (i,j) in the data vectors used by the covariance routines.
+ * Pairs with i<=j are stored in row-major order: (0,0),(0,1),...,(0,n-1),(1,1),...
+ * (i,j) and (j,i) return the same index.
+ * @param n_tracers number of tracers
+ * @param i first tracer
+ * @param j second tracer
+ * @return index of the pair, between 0 and n_tracers*(n_tracers+1)/2-1
+ */
+int ccl_covariance_pair_index(int n_tracers,int i,int j);
+
+/**
+ * Gaussian (Knox) covariance of the angular power spectra of all pairs of n_tracers tracers:
+ * Cov[C_ij(l),C_km(l')] = delta_{ll'} (Ct_ik Ct_jm + Ct_im Ct_jk) / ((2l+1) Delta_l f_sky),
+ * where Ct_ij = C_ij + delta_ij N_i includes the noise of each tracer.
+ * The data vector holds the n_ell bins of each pair in the order given by
+ * ccl_covariance_pair_index, i.e. d[ccl_covariance_pair_index(n_tracers,i,j)*n_ell+l].
+ * The covariance is written in parallel into a dense, row-major buffer, that can be
+ * pre-allocated or memory-mapped by the caller.
+ * @param n_tracers number of tracers
+ * @param n_ell number of ell bins
+ * @param ell effective multipole of each bin
+ * @param delta_ell width of each bin
+ * @param cls power spectra without noise, with cls[(i*n_tracers+j)*n_ell+l] the value for tracers i and j in the l-th bin. Only entries with i<=j are read.
+ * @param noise noise power spectrum of each tracer (e.g. sigma_e^2/n for shear, 1/n for number counts)
+ * @param f_sky sky fraction
+ * @param cov output covariance, of size N*N with N = n_ell*n_tracers*(n_tracers+1)/2
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ */
+void ccl_covariance_cls_gaussian(int n_tracers,int n_ell,double *ell,double *delta_ell,
+				 double *cls,double *noise,double f_sky,
+				 double *cov,int *status);
+
+/**
+ * Same as ccl_covariance_cls_gaussian, but computing the Limber power spectra of all
+ * pairs of tracers first. Each pair is only computed once.
+ * @param cosmo Cosmological parameters
+ * @param w a ClWorkspace, only used for its integration workspaces (NULL to use a temporary one)
+ * @param n_tracers number of tracers
+ * @param tracers array of n_tracers tracers
+ * @param psp the 3D power spectrum to project (NULL to use the non-linear matter power spectrum)
+ * @param noise noise power spectrum of each tracer
+ * @param f_sky sky fraction
+ * @param n_ell number of ell bins
+ * @param ell effective multipole of each bin
+ * @param delta_ell width of each bin
+ * @param cov output covariance (see ccl_covariance_cls_gaussian)
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ */
+void ccl_covariance_gaussian(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+			     int n_tracers,CCL_ClTracer **tracers,ccl_p2d_t *psp,
+			     double *noise,double f_sky,
+			     int n_ell,double *ell,double *delta_ell,
+			     double *cov,int *status);
+
+/**
+ * Non-Gaussian covariance of the Limber angular power spectra of all pairs of n_tracers
+ * tracers, from the connected one-halo trispectrum and from super-sample covariance
+ * (Takada & Hu 2013; Krause & Eifler 2017):
+ * Cov_1h[C_ij(l),C_km(l')] = Integral[ dchi q_i q_j q_k q_m T_1h(k,k',a) / chi^6 ] / (4 pi f_sky),
+ * Cov_SSC[C_ij(l),C_km(l')] = Integral[ dchi q_i q_j q_k q_m dP/ddelta_b(k) dP/ddelta_b(k') sigma_b^2 / chi^4 ],
+ * with k=(l+1/2)/chi, k'=(l'+1/2)/chi and q the Limber kernels of the tracers at l and l'.
+ * sigma_b^2 is the variance of the linear density field in a circular footprint of area
+ * 4 pi f_sky. The distance integrals use the scale factors of the halo-model workspace as
+ * nodes, so these should resolve the tracer kernels, and the halo-model quantities are
+ * interpolated in k over the workspace wavenumbers (and taken to vanish outside them).
+ * The data vector is ordered as in ccl_covariance_cls_gaussian.
+ * @param cosmo Cosmological parameters
+ * @param hw halo-model workspace built with ccl_halomod_workspace_new
+ * @param n_tracers number of tracers
+ * @param tracers array of n_tracers tracers
+ * @param f_sky sky fraction
+ * @param n_ell number of multipoles
+ * @param ell multipoles
+ * @param cov_1h output one-halo trispectrum covariance, of size N*N with N = n_ell*n_tracers*(n_tracers+1)/2. May be NULL.
+ * @param cov_ssc output super-sample covariance, of the same size. May be NULL.
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ */
+void ccl_covariance_nongaussian(ccl_cosmology *cosmo,ccl_halomod_workspace *hw,
+				int n_tracers,CCL_ClTracer **tracers,double f_sky,
+				int n_ell,double *ell,
+				double *cov_1h,double *cov_ssc,int *status);
+
+CCL_END_DECLS
+
+#endif
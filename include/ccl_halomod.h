@@ -40,6 +40,220 @@ CCL_BEGIN_DECLS
    */
   double ccl_halomodel_matter_power(ccl_cosmology *cosmo, double k, double a, int *status);
 
+  /**
+   * Computes the Fourier transform of the NFW profile of a halo, normalised to
+   * unity at k=0, for several wavenumbers. The sine and cosine integrals are
+   * evaluated through a Chebyshev approximation of their auxiliary functions,
+   * with a relative error below 1E-13.
+   * @param rv: halo radius in units of Mpc
+   * @param c: halo concentration
+   * @param n_k: number of wavenumbers
+   * @param k: wavenumbers in units of Mpc^{-1}
+   * @param uk: output array with the normalised profile at each k. Should be pre-allocated.
+   */
+  void ccl_halo_profile_nfw_fourier(double rv, double c, int n_k, double *k, double *uk);
+
+  /**
+   * Halo-model mass table at a single scale factor.
+   * The mass function, halo bias, concentration and halo radius are sampled
+   * once on a fixed grid in log10(M) between HM_MMIN and HM_MMAX, together
+   * with the Simpson weights of that grid, so that the one- and two-halo
+   * mass integrals can be evaluated for many wavenumbers as weighted sums.
+   */
+  typedef struct {
+    double a; /**< Scale factor */
+    double odelta; /**< Halo overdensity with respect to the matter density */
+    double rho_m; /**< Comoving matter density, units of Msun/Mpc^{3} */
+    int n_m; /**< Number of mass samples */
+    double *lmass; /**< log10 of the halo masses, units of Msun */
+    double *weight; /**< Integration weights in log10(M) */
+    double *dndlogm; /**< Mass function dn/dlog10(M) */
+    double *bias; /**< Linear halo bias */
+    double *conc; /**< Halo concentration */
+    double *rdelta; /**< Halo radius, units of Mpc */
+    double corr_2h; /**< Two-halo correction for masses below HM_MMIN, 1-I_2h(k=0) */
+  } ccl_halomod_table;
+
+  /**
+   * Tabulates the halo properties entering the halo model at scale factor a.
+   * The grid has spline_params.N_M_HM samples per decade in mass.
+   * @param cosmo: cosmology object containing parameters
+   * @param a: scale factor normalised to a=1 today
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   * @return the mass table, to be freed with ccl_halomod_table_free, or NULL on error
+   */
+  ccl_halomod_table *ccl_halomod_table_new(ccl_cosmology *cosmo, double a, int *status);
+
+  /**
+   * Frees a halo-model mass table.
+   * @param tab: table to free
+   */
+  void ccl_halomod_table_free(ccl_halomod_table *tab);
+
+  /**
+   * Computes the one- and two-halo terms of the matter power spectrum for
+   * several wavenumbers from a mass table.
+   * @param cosmo: cosmology object containing parameters
+   * @param tab: mass table built with ccl_halomod_table_new
+   * @param n_k: number of wavenumbers
+   * @param k: wavenumbers in units of Mpc^{-1}
+   * @param pk_1h: output one-halo term for each k, units of Mpc^{3}. May be NULL.
+   * @param pk_2h: output two-halo term for each k, units of Mpc^{3}. May be NULL.
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   */
+  void ccl_halomod_table_power(ccl_cosmology *cosmo, ccl_halomod_table *tab,
+			       int n_k, double *k, double *pk_1h, double *pk_2h, int *status);
+
+  /**
+   * Computes the halo model power spectrum on a grid of scale factors and
+   * wavenumbers. One mass table is built per scale factor, so this is much
+   * faster than calling ccl_halomodel_matter_power for every pair, which
+   * integrates over mass adaptively at each (k,a).
+   * @param cosmo: cosmology object containing parameters
+   * @param n_a: number of scale factors
+   * @param a: scale factors normalised to a=1 today
+   * @param n_k: number of wavenumbers
+   * @param k: wavenumbers in units of Mpc^{-1}
+   * @param pk: output array of size n_a*n_k, with pk[ia*n_k+ik] = P(k[ik],a[ia]) in units of Mpc^{3}
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   */
+  void ccl_halomodel_matter_power_array(ccl_cosmology *cosmo, int n_a, double *a,
+					int n_k, double *k, double *pk, int *status);
+
+  /**
+   * Halo-model workspace on a grid of scale factors and wavenumbers.
+   * It holds one mass table per scale factor, the NFW profile of every halo
+   * at every wavenumber, the linear power spectrum and the matter power
+   * spectrum, so that tracers built on top of the halo model (e.g. HOD
+   * galaxies) can be evaluated without redoing any cosmology-dependent work.
+   */
+  typedef struct {
+    int n_a; /**< Number of scale factors */
+    double *a; /**< Scale factors, in ascending order */
+    int n_k; /**< Number of wavenumbers */
+    double *lk; /**< Natural logarithm of the wavenumbers, in units of Mpc^{-1} */
+    int n_m; /**< Number of mass samples, the same for all mass tables */
+    ccl_halomod_table **tab; /**< Mass table at each scale factor */
+    double *uk; /**< NFW profile normalised to unity at k=0, uk[(ia*n_m+im)*n_k+ik] */
+    double *pk_lin; /**< Linear matter power spectrum, pk_lin[ia*n_k+ik], units of Mpc^{3} */
+    double *i_m; /**< Two-halo matter integral, including the low-mass correction, i_m[ia*n_k+ik] */
+    double *pk_mm; /**< Halo-model matter power spectrum, pk_mm[ia*n_k+ik], units of Mpc^{3} */
+  } ccl_halomod_workspace;
+
+  /**
+   * Parameters of the halo occupation distribution (Zheng et al. 2005).
+   * The mean number of centrals is N_c(M) = [1+erf((log10(M)-log10_mmin)/sigma_logm)]/2,
+   * and the mean number of satellites is N_s(M) = N_c(M) [(M-M_0)/M_1]^alpha for M>M_0.
+   * Satellites follow the NFW profile of their halo. Masses are virial, in units of Msun.
+   */
+  typedef struct {
+    double log10_mmin; /**< Characteristic mass of central hosts */
+    double sigma_logm; /**< Width of the central occupation in log10(M), must be positive */
+    double log10_m0; /**< Minimum mass of satellite hosts */
+    double log10_m1; /**< Characteristic mass of satellite hosts */
+    double alpha; /**< Slope of the satellite occupation */
+  } ccl_hod_params;
+
+  /**
+   * Builds a halo-model workspace. Memory scales as n_a*n_k times the number
+   * of mass samples (set by spline_params.N_M_HM).
+   * @param cosmo: cosmology object containing parameters
+   * @param n_a: number of scale factors, at least 1
+   * @param a: scale factors normalised to a=1 today, in ascending order
+   * @param n_k: number of wavenumbers, at least 1
+   * @param k: wavenumbers in units of Mpc^{-1}, in ascending order
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   * @return the workspace, to be freed with ccl_halomod_workspace_free, or NULL on error
+   */
+  ccl_halomod_workspace *ccl_halomod_workspace_new(ccl_cosmology *cosmo, int n_a, double *a,
+						   int n_k, double *k, int *status);
+
+  /**
+   * Frees a halo-model workspace.
+   * @param w: workspace to free
+   */
+  void ccl_halomod_workspace_free(ccl_halomod_workspace *w);
+
+  /**
+   * Computes the galaxy-galaxy and galaxy-matter power spectra of an HOD
+   * sample on the grid of a halo-model workspace. Only sums over the cached
+   * mass tables are done, so this is cheap to call for many HOD parameters.
+   * @param cosmo: cosmology object containing parameters
+   * @param w: workspace built with ccl_halomod_workspace_new
+   * @param hod: HOD parameters
+   * @param n_g: output comoving galaxy number density at each scale factor, units of Mpc^{-3}. May be NULL.
+   * @param pk_gg: output galaxy-galaxy power spectrum, pk_gg[ia*n_k+ik], units of Mpc^{3}. May be NULL.
+   * @param pk_gm: output galaxy-matter power spectrum, pk_gm[ia*n_k+ik], units of Mpc^{3}. May be NULL.
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   */
+  void ccl_halomod_hod_power(ccl_cosmology *cosmo, ccl_halomod_workspace *w, ccl_hod_params *hod,
+			     double *n_g, double *pk_gg, double *pk_gm, int *status);
+
+  /**
+   * Computes the galaxy-galaxy, galaxy-matter and matter-matter power spectra
+   * of an HOD sample as ccl_p2d_t objects that can be passed to ccl_angular_cls.
+   * The splines are bicubic, so the workspace needs at least 4 scale factors and
+   * 4 wavenumbers, and its last scale factor must be 1.
+   * @param cosmo: cosmology object containing parameters
+   * @param w: workspace built with ccl_halomod_workspace_new
+   * @param hod: HOD parameters. Only needed if p_gg or p_gm are not NULL.
+   * @param p_gg: output galaxy-galaxy power spectrum. May be NULL.
+   * @param p_gm: output galaxy-matter power spectrum. May be NULL.
+   * @param p_mm: output matter power spectrum. May be NULL.
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   */
+  void ccl_halomod_hod_p2d(ccl_cosmology *cosmo, ccl_halomod_workspace *w, ccl_hod_params *hod,
+			   ccl_p2d_t **p_gg, ccl_p2d_t **p_gm, ccl_p2d_t **p_mm, int *status);
+
+  /**
+   * Computes the one-halo matter trispectrum in the squeezed-parallelogram
+   * configuration used for power spectrum covariances,
+   * T_1h(k1,k2,a) = Integral[ dn/dlog10(M) (M/rho_m)^4 u^2(k1,M) u^2(k2,M) ],
+   * on the grid of a halo-model workspace. The (k1,k2) grid is computed in parallel.
+   * @param cosmo: cosmology object containing parameters
+   * @param w: workspace built with ccl_halomod_workspace_new
+   * @param tk: output array of size n_a*n_k*n_k, with tk[(ia*n_k+ik1)*n_k+ik2] = T_1h(k1,k2,a)
+   *        in units of Mpc^{9}
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   */
+  void ccl_halomod_trispectrum_1h(ccl_cosmology *cosmo, ccl_halomod_workspace *w,
+				  double *tk, int *status);
+
+  /**
+   * Computes the response of the matter power spectrum to a large-scale density
+   * mode (super-sample covariance response) on the grid of a halo-model workspace,
+   * dP/ddelta_b = [68/21 - dlog(k^3 P_lin)/dlog(k)/3] I_m^2(k) P_lin(k) + I_1^2(k),
+   * where I_m is the two-halo matter integral and
+   * I_1^2(k) = Integral[ dn/dlog10(M) b(M) (M/rho_m)^2 u^2(k,M) ] (Takada & Hu 2013).
+   * @param cosmo: cosmology object containing parameters
+   * @param w: workspace built with ccl_halomod_workspace_new
+   * @param dpk: output array of size n_a*n_k, with dpk[ia*n_k+ik] = dP/ddelta_b in units of Mpc^{3}
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   */
+  void ccl_halomod_ssc_response(ccl_cosmology *cosmo, ccl_halomod_workspace *w,
+				double *dpk, int *status);
+
+  /**
+   * Annotates a halo catalogue with the mass function, halo bias, concentration
+   * and comoving radial distance of every halo. The catalogue is processed in
+   * chunks of bounded size that are sorted by redshift and evaluated in parallel,
+   * and the outputs are written in place, so the columns can be memory-mapped files.
+   * @param cosmo: cosmology object containing parameters
+   * @param n_halo: number of haloes
+   * @param halomass: halo masses in units of Msun
+   * @param z: halo redshifts
+   * @param odelta: overdensity criteria (with respect to matter density) used for halo mass.
+   *        The virial overdensity at each redshift is used if odelta<=0.
+   * @param dndlogm: output mass function dn/dlog10(M) in units of Mpc^{-3}. May be NULL.
+   * @param bias: output linear halo bias. May be NULL.
+   * @param conc: output halo concentration. May be NULL.
+   * @param chi: output comoving radial distance in units of Mpc. May be NULL.
+   * @param status: Status flag: 0 if there are no errors, non-zero otherwise
+   */
+  void ccl_halo_catalog_annotate(ccl_cosmology *cosmo, long n_halo, double *halomass, double *z,
+				 double odelta, double *dndlogm, double *bias, double *conc,
+				 double *chi, int *status);
+
   /**
    * Computes the concentration of a halo of mass M.
    * This is the ratio of virial raidus to scale radius for an NFW halo.
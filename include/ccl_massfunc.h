@@ -38,6 +38,70 @@ double ccl_massfunc(ccl_cosmology *cosmo, double smooth_mass, double a, double o
  */
 double ccl_halo_bias(ccl_cosmology *cosmo, double smooth_mass, double a, double odelta, int *status);
 
+/*
+ * Compute the halo mass function dn/dlog10(M) for an array of masses at a single scale factor
+ * @param cosmo Cosmological parameters
+ * @param n_m Number of masses
+ * @param halomass Masses to compute at, in units of Msun
+ * @param a Scale factor, normalized to a=1 today
+ * @param odelta choice of Delta
+ * @param dndlogm Output array of size n_m. Should be pre-allocated.
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.
+ */
+void ccl_massfunc_array(ccl_cosmology *cosmo, int n_m, double *halomass, double a, double odelta,
+			double *dndlogm, int *status);
+
+/*
+ * Compute the linear halo bias for an array of masses at a single scale factor
+ * @param cosmo Cosmological parameters
+ * @param n_m Number of masses
+ * @param halomass Masses to compute at, in units of Msun
+ * @param a Scale factor, normalized to a=1 today
+ * @param odelta choice of Delta
+ * @param bias Output array of size n_m. Should be pre-allocated.
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.
+ */
+void ccl_halo_bias_array(ccl_cosmology *cosmo, int n_m, double *halomass, double a, double odelta,
+			 double *bias, int *status);
+
+/*
+ * Compute the halo mass function dn/dlog10(M) and the linear halo bias together for an
+ * array of masses at a single scale factor. sigma(M) and the fitting-function parameters
+ * are shared by both. If a fitting function is not available for this configuration,
+ * its output is filled with the value ccl_massfunc or ccl_halo_bias would return.
+ * @param cosmo Cosmological parameters
+ * @param n_m Number of masses
+ * @param halomass Masses to compute at, in units of Msun
+ * @param a Scale factor, normalized to a=1 today
+ * @param odelta choice of Delta
+ * @param dndlogm Output mass function, of size n_m. May be NULL.
+ * @param bias Output halo bias, of size n_m. May be NULL.
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.
+ */
+void ccl_massfunc_bias_array(ccl_cosmology *cosmo, int n_m, double *halomass, double a, double odelta,
+			     double *dndlogm, double *bias, int *status);
+
+/*
+ * Compute the halo mass function dn/dlog10(M) and the linear halo bias on a grid of
+ * scale factors and masses. Mass-dependent quantities are interpolated once for all
+ * scale factors, and redshift-dependent ones once for all masses.
+ * @param cosmo Cosmological parameters
+ * @param n_a Number of scale factors
+ * @param a Scale factors, normalized to a=1 today
+ * @param odelta choice of Delta for each scale factor, of size n_a
+ * @param n_m Number of masses
+ * @param halomass Masses to compute at, in units of Msun
+ * @param dndlogm Output mass function, with dndlogm[ia*n_m+im] at (a[ia],halomass[im]). May be NULL.
+ * @param bias Output halo bias, with the same layout as dndlogm. May be NULL.
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.
+ */
+void ccl_massfunc_bias_grid(ccl_cosmology *cosmo, int n_a, double *a, double *odelta,
+			    int n_m, double *halomass, double *dndlogm, double *bias, int *status);
+
 /*
  * Convert smoothing halo mass in units of Msun to smoothing halo radius in units of Mpc.
  * @param cosmo Cosmological parameters
@@ -48,6 +48,22 @@ ccl_p2d_t *ccl_p2d_t_new(int na,double *a_arr,
 double ccl_p2d_t_eval(ccl_p2d_t *psp,double lk,double a,ccl_cosmology *cosmo,
 		      int *status);
 
+/**
+ * Evaluate power spectrum defined by ccl_p2d_t structure on a grid of wavenumbers and scale factors.
+ * This is faster than calling ccl_p2d_t_eval for each pair, since the spline lookups are
+ * accelerated and the extrapolation in a is only computed once per scale factor.
+ * @param psp ccl_p2d_t structure defining P(k,a).
+ * @param nk number of wavenumbers.
+ * @param lk array of natural logarithms of the wavenumbers.
+ * @param na number of scale factors.
+ * @param a array of scale factors.
+ * @param cosmo ccl_cosmology structure, only needed if evaluating P(k,a) at small scale factors outside the interpolation range, and if psp was initialized with extrap_linear_growth = ccl_p2d_cclgrowth.
+ * @param pk output array of size na * nk, with pk[ia*nk+ik] = P(k=exp(lk[ik]),a=a[ia]).
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ */
+void ccl_p2d_t_eval_array(ccl_p2d_t *psp,int nk,double *lk,int na,double *a,
+			  ccl_cosmology *cosmo,double *pk,int *status);
+
 /**
  * P2D structure destructor.
  * Frees up all memory associated with a p2d structure.
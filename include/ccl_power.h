@@ -30,6 +30,41 @@ double ccl_linear_matter_power(ccl_cosmology * cosmo, double k, double a,int * s
 
 double ccl_nonlin_matter_power(ccl_cosmology * cosmo, double k, double a,int * status);
 
+/**
+ * Non-linear matter power spectrum on a grid of scale factors and wavenumbers.
+ * Equivalent to calling ccl_nonlin_matter_power for every pair, but faster.
+ * @param cosmo Cosmology parameters and configurations
+ * @param n_a number of scale factors
+ * @param a scale factors, normalized to 1 for today
+ * @param n_k number of wavenumbers
+ * @param k Fourier modes, in [1/Mpc] units
+ * @param pk output array of size n_a*n_k, with pk[ia*n_k+ik] = P_NL(k[ik],a[ia]). Should be pre-allocated.
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.c
+ */
+void ccl_nonlin_matter_power_array(ccl_cosmology * cosmo, int n_a, double *a,
+				   int n_k, double *k, double *pk, int * status);
+
+/**
+ * Number of ln(k) nodes used to integrate over the range of the power spectrum splines
+ * with Simpson's rule. This is the number of spline nodes, made odd if needed.
+ * @param cosmo Cosmology parameters and configurations
+ * @return number of nodes
+ */
+int ccl_get_pk_simpson_nk(ccl_cosmology *cosmo);
+
+/**
+ * Simpson nodes in ln(k) spanning the range of the power spectrum splines, and their
+ * integration weights, so that sum_i w[i]*f(lk[i]) approximates the integral of f over ln(k).
+ * @param cosmo Cosmology parameters and configurations
+ * @param nk number of nodes. Must be equal to ccl_get_pk_simpson_nk(cosmo).
+ * @param lk output array of nk ln(k) nodes, with k in [1/Mpc]. Should be pre-allocated.
+ * @param w output array of nk weights. Should be pre-allocated.
+ * @param status Status flag. 0 if there are no errors, nonzero otherwise.
+ * For specific cases see documentation for ccl_error.c
+ */
+void ccl_get_pk_simpson_lk_array(ccl_cosmology *cosmo, int nk, double *lk, double *w, int *status);
+
 /**
  * Compute the power spectrum and create a 2d spline P(k,z) to be stored
  * in the cosmology structure.
@@ -42,7 +77,8 @@ void ccl_cosmology_compute_power(ccl_cosmology * cosmo, int* status);
 
 /**
  * Variance of the matter density field with (top-hat) smoothing scale R [Mpc].
- * Returns sigma(R) for specified cosmology at a = 1.
+ * Computed at a = 1 and scaled by the growth factor, or from P_lin(k,a) directly
+ * in cosmologies with massive neutrinos.
  * @param cosmo Cosmology parameters and configurations
  * @param R Smoothing scale, in [Mpc] units
  * @param a scale factor
@@ -54,7 +90,8 @@ double ccl_sigmaR(ccl_cosmology *cosmo, double R, double a, int * status);
 
 /**
  * Variance of the displacement field with (top-hat) smoothing scale R [Mpc]
- * Returns sigma(V(R)) for specified cosmology at a = 1.
+ * Computed at a = 1 and scaled by the growth factor, or from P_lin(k,a) directly
+ * in cosmologies with massive neutrinos.
  * @param cosmo Cosmology parameters and configurations
  * @param R smoothing scale, in [Mpc] units
  * @param a scale factor
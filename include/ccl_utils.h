@@ -55,6 +55,11 @@ typedef struct {
 
 SplPar *ccl_spline_init(int n,double *x,double *y,double y0,double yf);
 
+//Re-initializes an existing spline with new values without reallocating it.
+//n must match the number of points the spline was created with.
+//Returns 0 on success.
+int ccl_spline_reinit(SplPar *spl,int n,double *x,double *y,double y0,double yf);
+
 double ccl_spline_eval(double x,SplPar *spl);
 
 void ccl_spline_free(SplPar *spl);
@@ -49,6 +49,21 @@ void fftlog_ComputeXiLM(double l, double m, int N, const double k[],  const doub
  *   th[0] = 1/l[N-1], ..., th[N-1] = 1/l[0]. */
 void fftlog_ComputeXi2D(double bessel_order,int N,const double l[],const double cl[],
 			double th[], double xi[]);
+
+/* Batched version of fftlog_ComputeXiLM for M power spectra sampled at the
+ * same k-values.  pk and xi have size M*N, with pk[j*N+i] the j-th spectrum
+ * at k[i]. */
+void fftlog_ComputeXiLM_many(double l, double m, int M, int N, const double k[], const double pk[],
+                             double r[], double xi[]);
+
+/* Batched version of fftlog_ComputeXi2D for M power spectra sampled at the
+ * same l-values and n_orders Bessel orders (e.g. 0 and 4 for xi+ and xi-).
+ * The forward FFTs are shared by all orders.  cl has size M*N, with cl[j*N+i]
+ * the j-th spectrum at l[i].  th has size n_orders*N and contains the dual
+ * angles of each order.  xi has size n_orders*M*N, with xi[(io*M+j)*N+i] the
+ * transform of the j-th spectrum for order io at th[io*N+i]. */
+void fftlog_ComputeXi2D_many(int n_orders, const double bessel_order[], int M, int N,
+                             const double l[], const double cl[], double th[], double xi[]);
 #include <complex.h>
 
 /* Compute the discrete Hankel transform of the function a(r).  See the FFTLog
@@ -61,6 +76,20 @@ void fht(int N,  const double r[],  const double complex a[], double k[], double
          double q, double kcrc, int noring, double complex* u);
 //         double q = 0, double kcrc = 1, bool noring = true, double complex* u = NULL);
 
+/* Same as fht() for a real input a(r), in which case b(k) is also real.
+ * This uses real-to-complex and complex-to-real FFTs, which halve the
+ * cost and memory of the complex transform. */
+void fht_real(int N, const double r[], const double a[], double k[], double b[], double mu,
+              double q, double kcrc, int noring);
+
+/* Real transforms of M functions sampled at the same points r, for n_mu
+ * orders mu[].  a has size M*N, with a[j*N+i] the j-th function at r[i].
+ * k has size n_mu*N and b has size n_mu*M*N, with b[(i_mu*M+j)*N+i] the
+ * transform of the j-th function for order mu[i_mu] at k[i_mu*N+i].
+ * All functions are transformed with a single batched FFT. */
+void fht_real_many(int n_mu, const double mu[], int M, int N, const double r[], const double a[],
+                   double k[], double b[], double q, double kcrc, int noring);
+
 /* Pre-compute the coefficients that appear in the FFTLog implementation of
  * the discrete Hankel transform.  The parameters N, mu, and q here are the
  * same as for the function fht().  The parameter L is defined (for whatever
@@ -68,6 +97,24 @@ void fht(int N,  const double r[],  const double complex a[], double k[], double
  *   L = N * log(r[N-1]/r[0])/(N-1) */
 void compute_u_coefficients(int N, double mu, double q, double L, double kcrc, double complex u[]);
 
+/* FFTW plans (keyed by N) and u coefficients (keyed by N, mu, q, L and kcrc)
+ * are cached across calls to fht() and the functions above, so repeated
+ * transforms of the same size and order only pay for the FFTs.  The caches
+ * are thread-safe. */
+
+/* Use FFTW_MEASURE (measure != 0) instead of FFTW_ESTIMATE for plans created
+ * from now on.  Measuring is slower the first time a size is used, but may
+ * produce faster plans.  Call fftlog_clear_cache() to re-plan existing sizes. */
+void fftlog_set_measure(int measure);
+
+/* Import/export FFTW wisdom from/to a file, so that measured plans can be
+ * reused across runs.  These return non-zero on success. */
+int fftlog_import_wisdom(const char* fname);
+int fftlog_export_wisdom(const char* fname);
+
+/* Release all cached plans and coefficients. */
+void fftlog_clear_cache(void);
+
 
 #endif // FFTLOG_H
 
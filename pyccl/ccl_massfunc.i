@@ -20,9 +20,7 @@
 %inline %{
 void massfunc_vec(ccl_cosmology * cosmo, double a, double odelta,
                   double* halo_mass, int nm, int nout, double* output, int* status) {
-    for(int i=0; i < nm; i++) {
-        output[i] = ccl_massfunc(cosmo, halo_mass[i], a, odelta, status);
-    }
+    ccl_massfunc_array(cosmo, nm, halo_mass, a, odelta, output, status);
 }
 
 void massfunc_m2r_vec(ccl_cosmology * cosmo, double* halo_mass, int nm,
@@ -42,9 +40,7 @@ void sigmaM_vec(ccl_cosmology * cosmo, double a, double* halo_mass, int nm,
 void halo_bias_vec(ccl_cosmology * cosmo, double a, double odelta,
                    double* halo_mass, int nm, int nout, double* output,
                    int* status) {
-    for(int i=0; i < nm; i++) {
-        output[i] = ccl_halo_bias(cosmo, halo_mass[i], a, odelta, status);
-    }
+    ccl_halo_bias_array(cosmo, nm, halo_mass, a, odelta, output, status);
 }
 
 %}
@@ -87,8 +87,14 @@ parameters.
     splines used in the computation of the halo mass function.
   - LOGM_SPLINE_MAX: the base-10 logarithm of the maximum halo mass for
     splines used in the computation of the halo mass function.
-  - LOGM_SPLINE_DELTA: the step in base-10 logarithmic units for computing
-    finite difference derivatives in the computation of the mass function.
+  - LOGM_SPLINE_DELTA: unused. The logarithmic derivative of sigma(M) entering
+    the mass function is now computed exactly rather than by finite differences.
+  - N_M_HM: the number of samples per decade in mass of the grid used for
+    the halo model mass integrals when building the power spectrum splines.
+  - SIGMA_SPLINE_2D: if non-zero, tabulate sigma(M) as a function of both
+    mass and scale factor on the power spectrum nodes, instead of rescaling
+    its value at z=0 by the growth factor. This is always done for
+    cosmologies with massive neutrinos.
   - A_SPLINE_NLOG_PK: the number of logarithmically spaced bins between
     A_SPLINE_MINLOG_PK and A_SPLINE_MIN_PK.
   - A_SPLINE_NA_PK: the number of linearly spaced bins between
@@ -7,6 +7,7 @@
 #include <gsl/gsl_integration.h>
 
 #include "ccl.h"
+#include "fftlog.h"
 
 #ifdef HAVE_ANGPOW
 #include "Angpow/angpow_ccl.h"
@@ -58,6 +59,15 @@ static double speval_bis(double x,void *params)
 
 void ccl_cl_workspace_free(CCL_ClWorkspace *w)
 {
+  if(w->spl_nodes!=NULL)
+    ccl_spline_free(w->spl_nodes);
+  if(w->w_qag!=NULL)
+    gsl_integration_workspace_free(w->w_qag);
+  if(w->w_cquad!=NULL)
+    gsl_integration_cquad_workspace_free(w->w_cquad);
+  free(w->l_nodes);
+  free(w->cl_nodes);
+  free(w->buf_nonlimber);
   free(w->l_arr);
   free(w);
 }
@@ -71,11 +81,23 @@ CCL_ClWorkspace *ccl_cl_workspace_new(int lmax,int l_limber,
     *status=CCL_ERROR_MEMORY;
 
   if(*status==0) {
+    //Buffers are allocated below or on first use
+    w->l_arr=NULL;
+    w->l_nodes=NULL;
+    w->cl_nodes=NULL;
+    w->spl_nodes=NULL;
+    w->n_iteration=0;
+    w->w_qag=NULL;
+    w->w_cquad=NULL;
+    w->buf_nonlimber=NULL;
+    w->n_chi_nonlimber=0;
+
     //Set params
     w->lmax=lmax;
     w->l_limber=l_limber;
     w->l_logstep=l_logstep;
     w->l_linstep=l_linstep;
+    w->nonlimber_method=ccl_nonlimber_native;
 
     //Compute number of multipoles
     i_l=0; l0=0;
@@ -117,6 +139,19 @@ CCL_ClWorkspace *ccl_cl_workspace_new(int lmax,int l_limber,
     //Don't go further than lmaw
     w->l_arr[w->n_ls-1]=w->lmax;
   }
+
+  if(*status==0) {
+    //Allocate persistent buffers for the power spectrum at the interpolation nodes
+    w->l_nodes=(double *)malloc(w->n_ls*sizeof(double));
+    w->cl_nodes=(double *)calloc(w->n_ls,sizeof(double));
+    if((w->l_nodes==NULL) || (w->cl_nodes==NULL))
+      *status=CCL_ERROR_MEMORY;
+  }
+
+  if(*status==0) {
+    for(i_l=0;i_l<w->n_ls;i_l++)
+      w->l_nodes[i_l]=(double)(w->l_arr[i_l]);
+  }
   
   return w;
 }
@@ -258,82 +293,224 @@ static int window_magnification(double chi,ccl_cosmology *cosmo,SplPar *spl_pz,S
   return 0;
 }
 
-static void clt_init_nz(CCL_ClTracer *clt,ccl_cosmology *cosmo,
-			int nz_n,double *z_n,double *n,int *status)
+//Sets an error status during tracer construction.
+//Tracer specs can be created without a cosmology, in which case
+//the message can't be stored and is raised as a warning instead.
+static void clt_set_error(ccl_cosmology *cosmo,int *status,int err,const char *msg)
+{
+  *status=err;
+  if(cosmo!=NULL)
+    ccl_cosmology_set_status_message(cosmo,msg);
+  else
+    ccl_raise_warning(err,"%s",msg);
+}
+
+static void spec_init_nz(CCL_ClTracerSpec *spec,ccl_cosmology *cosmo,const ccl_gsl_params *gslp,
+			 int nz_n,double *z_n,double *n,int *status)
 {
   int gslstatus;
   gsl_function F;
   double nz_norm,nz_enorm;
-  double *nz_normalized;
+  double *nz_normalized=NULL;
   
   //Find redshift range where the N(z) has support
-  get_support_interval(nz_n,z_n,n,CCL_FRAC_RELEVANT,&(clt->zmin),&(clt->zmax));
-  clt->chimax=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmax),status);
-  clt->chimin=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmin),status);
-  clt->spl_nz=ccl_spline_init(nz_n,z_n,n,0,0);
-  if(clt->spl_nz==NULL) {
-    *status=CCL_ERROR_SPLINE;
-    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_init_nz(): error initializing spline for N(z)\n");
-  }
+  get_support_interval(nz_n,z_n,n,CCL_FRAC_RELEVANT,&(spec->zmin),&(spec->zmax));
+  spec->spl_nz=ccl_spline_init(nz_n,z_n,n,0,0);
+  if(spec->spl_nz==NULL)
+    clt_set_error(cosmo,status,CCL_ERROR_SPLINE,"ccl_cls.c: spec_init_nz(): error initializing spline for N(z)\n");
 
   if(*status==0) {
     //Normalize n(z)
     nz_normalized=(double *)malloc(nz_n*sizeof(double));
     if(nz_normalized==NULL) {
-      *status=CCL_ERROR_MEMORY;
-      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_init_nz(): memory allocation\n");
+      clt_set_error(cosmo,status,CCL_ERROR_MEMORY,"ccl_cls.c: spec_init_nz(): memory allocation\n");
       return;
     }
   }
   
   if(*status==0) {
-    gsl_integration_workspace *w=gsl_integration_workspace_alloc(cosmo->gsl_params.N_ITERATION);
+    gsl_integration_workspace *w=gsl_integration_workspace_alloc(gslp->N_ITERATION);
     F.function=&speval_bis;
-    F.params=clt->spl_nz;
+    F.params=spec->spl_nz;
     //Here we're just integrating the N(z) to normalize it to unit probability.
     gslstatus=gsl_integration_qag(&F, z_n[0], z_n[nz_n-1], 0,
-				  cosmo->gsl_params.INTEGRATION_EPSREL, cosmo->gsl_params.N_ITERATION,
-				  cosmo->gsl_params.INTEGRATION_GAUSS_KRONROD_POINTS,
+				  gslp->INTEGRATION_EPSREL, gslp->N_ITERATION,
+				  gslp->INTEGRATION_GAUSS_KRONROD_POINTS,
 				  w, &nz_norm, &nz_enorm);
     gsl_integration_workspace_free(w);
     if(gslstatus!=GSL_SUCCESS) {
-      ccl_raise_gsl_warning(gslstatus, "ccl_cls.c: clt_init_nz():");
-      *status=CCL_ERROR_INTEG;
-      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_init_nz(): integration error when normalizing N(z)\n");
+      ccl_raise_gsl_warning(gslstatus, "ccl_cls.c: spec_init_nz():");
+      clt_set_error(cosmo,status,CCL_ERROR_INTEG,
+		    "ccl_cls.c: spec_init_nz(): integration error when normalizing N(z)\n");
     }
   }
   
   if(*status==0) {
     for(int ii=0;ii<nz_n;ii++)
       nz_normalized[ii]=n[ii]/nz_norm;
-    ccl_spline_free(clt->spl_nz);
-    clt->spl_nz=ccl_spline_init(nz_n,z_n,nz_normalized,0,0);
-    if(clt->spl_nz==NULL) {
-      *status=CCL_ERROR_SPLINE;
-      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_init_nz(): error initializing normalized spline for N(z)\n");
+    ccl_spline_free(spec->spl_nz);
+    spec->spl_nz=ccl_spline_init(nz_n,z_n,nz_normalized,0,0);
+    if(spec->spl_nz==NULL)
+      clt_set_error(cosmo,status,CCL_ERROR_SPLINE,
+		    "ccl_cls.c: spec_init_nz(): error initializing normalized spline for N(z)\n");
+  }
+
+  if(*status==0) {
+    //Keep the normalized nodes so that shifts and stretches of N(z) can be applied later
+    spec->z_n=(double *)malloc(nz_n*sizeof(double));
+    if(spec->z_n==NULL)
+      clt_set_error(cosmo,status,CCL_ERROR_MEMORY,"ccl_cls.c: spec_init_nz(): memory allocation\n");
+  }
+
+  if(*status==0) {
+    double sum_zn=0,sum_n=0;
+    memcpy(spec->z_n,z_n,nz_n*sizeof(double));
+    spec->nz_n=nz_n;
+    spec->n_norm=nz_normalized;
+    nz_normalized=NULL;
+
+    //Mean redshift, used as the pivot for stretches of N(z)
+    for(int ii=0;ii<nz_n-1;ii++) {
+      double dz=z_n[ii+1]-z_n[ii];
+      sum_n+=0.5*dz*(spec->n_norm[ii]+spec->n_norm[ii+1]);
+      sum_zn+=0.5*dz*(z_n[ii]*spec->n_norm[ii]+z_n[ii+1]*spec->n_norm[ii+1]);
     }
+    spec->z_mean=(sum_n>0) ? sum_zn/sum_n : 0.5*(spec->zmin+spec->zmax);
   }
   
   free(nz_normalized);
 }
 
-static void clt_init_bz(CCL_ClTracer *clt,ccl_cosmology *cosmo,
-			int nz_b,double *z_b,double *b,int *status)
+//Initializes a spline for one of the redshift-dependent tracer functions
+//(clustering bias, magnification bias, aligned fraction or alignment bias),
+//assumed constant outside the range covered by z_f.
+static SplPar *spec_init_fz(ccl_cosmology *cosmo,int nz_f,double *z_f,double *f,
+			    const char *msg,int *status)
 {
-  //Initialize bias spline
-  clt->spl_bz=ccl_spline_init(nz_b,z_b,b,b[0],b[nz_b-1]);
-  if(clt->spl_bz==NULL) {
-    *status=CCL_ERROR_SPLINE;
-    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_init_bz(): error initializing spline for b(z)\n");
+  SplPar *spl;
+
+  if(*status)
+    return NULL;
+
+  spl=ccl_spline_init(nz_f,z_f,f,f[0],f[nz_f-1]);
+  if(spl==NULL)
+    clt_set_error(cosmo,status,CCL_ERROR_SPLINE,msg);
+  return spl;
+}
+
+//CCL_ClTracerSpec creator
+//cosmo -> ccl_cosmology object used only to report errors (may be NULL)
+//gslp  -> integration parameters used to normalize N(z)
+//Other arguments as in ccl_cl_tracer below.
+static CCL_ClTracerSpec *cl_tracer_spec(ccl_cosmology *cosmo,const ccl_gsl_params *gslp,
+					int tracer_type,
+					int has_rsd,int has_magnification,int has_intrinsic_alignment,
+					int nz_n,double *z_n,double *n,
+					int nz_b,double *z_b,double *b,
+					int nz_s,double *z_s,double *s,
+					int nz_ba,double *z_ba,double *ba,
+					int nz_rf,double *z_rf,double *rf,
+					double z_source,int *status)
+{
+  CCL_ClTracerSpec *spec;
+
+  if((tracer_type!=ccl_number_counts_tracer) && (tracer_type!=ccl_weak_lensing_tracer) &&
+     (tracer_type!=ccl_cmb_lensing_tracer)) {
+    clt_set_error(cosmo,status,CCL_ERROR_INCONSISTENT,"ccl_cls.c: ccl_cl_tracer(): unknown tracer type\n");
+    return NULL;
+  }
+
+  spec=(CCL_ClTracerSpec *)malloc(sizeof(CCL_ClTracerSpec));
+  if(spec==NULL) {
+    clt_set_error(cosmo,status,CCL_ERROR_MEMORY,"ccl_cls.c: ccl_cl_tracer(): memory allocation\n");
+    return NULL;
+  }
+
+  spec->tracer_type=tracer_type;
+  spec->has_rsd=0;
+  spec->has_magnification=0;
+  spec->has_intrinsic_alignment=0;
+  spec->zmin=0;
+  spec->zmax=z_source;
+  spec->z_source=z_source;
+  spec->spl_nz=NULL;
+  spec->spl_bz=NULL;
+  spec->spl_sz=NULL;
+  spec->spl_rf=NULL;
+  spec->spl_ba=NULL;
+  spec->nz_n=0;
+  spec->z_n=NULL;
+  spec->n_norm=NULL;
+  spec->z_mean=0;
+
+  if(tracer_type==ccl_number_counts_tracer) {
+    spec->has_rsd=has_rsd;
+    spec->has_magnification=has_magnification;
+    spec_init_nz(spec,cosmo,gslp,nz_n,z_n,n,status);
+    spec->spl_bz=spec_init_fz(cosmo,nz_b,z_b,b,
+			      "ccl_cls.c: ccl_cl_tracer(): error initializing spline for b(z)\n",status);
+    if(spec->has_magnification)
+      spec->spl_sz=spec_init_fz(cosmo,nz_s,z_s,s,
+				"ccl_cls.c: ccl_cl_tracer(): error initializing spline for s(z)\n",status);
+  }
+  else if(tracer_type==ccl_weak_lensing_tracer) {
+    spec->has_intrinsic_alignment=has_intrinsic_alignment;
+    spec_init_nz(spec,cosmo,gslp,nz_n,z_n,n,status);
+    if(spec->has_intrinsic_alignment) {
+      spec->spl_rf=spec_init_fz(cosmo,nz_rf,z_rf,rf,
+				"ccl_cls.c: ccl_cl_tracer(): error initializing spline for rf(z)\n",status);
+      spec->spl_ba=spec_init_fz(cosmo,nz_ba,z_ba,ba,
+				"ccl_cls.c: ccl_cl_tracer(): error initializing spline for ba(z)\n",status);
+    }
+  }
+
+  if(*status) {
+    ccl_cl_tracer_spec_free(spec);
+    spec=NULL;
   }
+
+  return spec;
+}
+
+//CCL_ClTracerSpec constructor with error checking
+//Arguments as in ccl_cl_tracer, but no cosmology is needed.
+CCL_ClTracerSpec *ccl_cl_tracer_spec_new(int tracer_type,
+					 int has_rsd,int has_magnification,int has_intrinsic_alignment,
+					 int nz_n,double *z_n,double *n,
+					 int nz_b,double *z_b,double *b,
+					 int nz_s,double *z_s,double *s,
+					 int nz_ba,double *z_ba,double *ba,
+					 int nz_rf,double *z_rf,double *rf,
+					 double z_source,int *status)
+{
+  CCL_ClTracerSpec *spec=cl_tracer_spec(NULL,&default_gsl_params,tracer_type,
+					has_rsd,has_magnification,has_intrinsic_alignment,
+					nz_n,z_n,n,nz_b,z_b,b,nz_s,z_s,s,
+					nz_ba,z_ba,ba,nz_rf,z_rf,rf,z_source,status);
+  ccl_check_status_nocosmo(status);
+  return spec;
 }
 
-static void clt_init_wM(CCL_ClTracer *clt,ccl_cosmology *cosmo,
-			int nz_s,double *z_s,double *s,int *status)
+//CCL_ClTracerSpec destructor
+void ccl_cl_tracer_spec_free(CCL_ClTracerSpec *spec)
+{
+  if(spec==NULL)
+    return;
+  if(spec->spl_nz!=NULL) ccl_spline_free(spec->spl_nz);
+  if(spec->spl_bz!=NULL) ccl_spline_free(spec->spl_bz);
+  if(spec->spl_sz!=NULL) ccl_spline_free(spec->spl_sz);
+  if(spec->spl_rf!=NULL) ccl_spline_free(spec->spl_rf);
+  if(spec->spl_ba!=NULL) ccl_spline_free(spec->spl_ba);
+  free(spec->z_n);
+  free(spec->n_norm);
+  free(spec);
+}
+
+static void clt_init_wM(CCL_ClTracer *clt,ccl_cosmology *cosmo,int *status)
 {
   //Compute magnification kernel
   int nchi;
-  double *x,*y;
+  double *x,*y=NULL;
   double dchi_here=5.;
   double zmax=clt->spl_nz->xf;
   double chimax=ccl_comoving_radial_distance(cosmo,1./(1+zmax),status);
@@ -342,22 +519,13 @@ static void clt_init_wM(CCL_ClTracer *clt,ccl_cosmology *cosmo,
   //In this case we need to integrate all the way to z=0. Reset zmin and chimin
   clt->zmin=0;
   clt->chimin=0;
-  clt->spl_sz=ccl_spline_init(nz_s,z_s,s,s[0],s[nz_s-1]);
-  if(clt->spl_sz==NULL) {
-    *status=CCL_ERROR_SPLINE;
+  nchi=(int)(chimax/dchi_here)+1;
+  x=ccl_linear_spacing(0.,chimax,nchi);
+  dchi_here=chimax/nchi;
+  if(x==NULL || (fabs(x[0]-0)>1E-5) || (fabs(x[nchi-1]-chimax)>1e-5)) {
+    *status=CCL_ERROR_LINSPACE;
     ccl_cosmology_set_status_message(cosmo,
-				     "ccl_cls.c: clt_init_wM(): error initializing spline for s(z)\n");
-  }
-
-  if(*status==0) {
-    nchi=(int)(chimax/dchi_here)+1;
-    x=ccl_linear_spacing(0.,chimax,nchi);
-    dchi_here=chimax/nchi;
-    if(x==NULL || (fabs(x[0]-0)>1E-5) || (fabs(x[nchi-1]-chimax)>1e-5)) {
-      *status=CCL_ERROR_LINSPACE;
-      ccl_cosmology_set_status_message(cosmo,
-				       "ccl_cls.c: clt_init_wM(): Error creating linear spacing in chi\n");
-    }
+				     "ccl_cls.c: clt_init_wM(): Error creating linear spacing in chi\n");
   }
 
   if(*status==0) {
@@ -389,34 +557,12 @@ static void clt_init_wM(CCL_ClTracer *clt,ccl_cosmology *cosmo,
   free(x); free(y);
 }
 
-//CCL_ClTracer initializer for number counts
-static void clt_nc_init(CCL_ClTracer *clt,ccl_cosmology *cosmo,
-			int has_rsd,int has_magnification,
-			int nz_n,double *z_n,double *n,
-			int nz_b,double *z_b,double *b,
-			int nz_s,double *z_s,double *s,int *status)
-{
-  clt->has_rsd=has_rsd;
-  clt->has_magnification=has_magnification;
-
-  if ( ((cosmo->params.N_nu_mass)>0) && clt->has_rsd){
-    *status=CCL_ERROR_NOT_IMPLEMENTED;
-    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_new(): Number counts tracers with RSD not yet implemented in cosmologies with massive neutrinos.");
-    return;
-  }
-
-  clt_init_nz(clt,cosmo,nz_n,z_n,n,status);
-  clt_init_bz(clt,cosmo,nz_b,z_b,b,status);
-  if(clt->has_magnification)
-    clt_init_wM(clt,cosmo,nz_s,z_s,s,status);
-}
-
 static void clt_init_wL(CCL_ClTracer *clt,ccl_cosmology *cosmo,
 			int *status)
 {
   //Compute weak lensing kernel
   int nchi;
-  double *x,*y;
+  double *x,*y=NULL;
   double dchi_here=5.;
   double zmax=clt->spl_nz->xf;
   double chimax=ccl_comoving_radial_distance(cosmo,1./(1+zmax),status);
@@ -463,42 +609,80 @@ static void clt_init_wL(CCL_ClTracer *clt,ccl_cosmology *cosmo,
   free(x); free(y);
 }
 
-static void clt_init_rf(CCL_ClTracer *clt,ccl_cosmology *cosmo,
-			int nz_rf,double *z_rf,double *rf,int *status)
+//Binds a tracer spec to a cosmology.
+//Only the distance-dependent quantities (support in chi, lensing prefactor
+//and lensing/magnification kernels) are computed here.
+static CCL_ClTracer *cl_tracer_bind(ccl_cosmology *cosmo,CCL_ClTracerSpec *spec,int *status)
 {
-  //Initialize bias spline
-  clt->spl_rf=ccl_spline_init(nz_rf,z_rf,rf,rf[0],rf[nz_rf-1]);
-  if(clt->spl_rf==NULL) {
-    *status=CCL_ERROR_SPLINE;
-    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_init_rf(): error initializing spline for b(z)\n");
+  CCL_ClTracer *clt=(CCL_ClTracer *)malloc(sizeof(CCL_ClTracer));
+  if(clt==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_bind(): memory allocation\n");
+    return NULL;
   }
-}
 
-static void clt_init_ba(CCL_ClTracer *clt,ccl_cosmology *cosmo,
-			int nz_ba,double *z_ba,double *ba,int *status)
-{
-  //Initialize bias spline
-  clt->spl_ba=ccl_spline_init(nz_ba,z_ba,ba,ba[0],ba[nz_ba-1]);
-  if(clt->spl_ba==NULL) {
-    *status=CCL_ERROR_SPLINE;
-    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_init_ba(): error initializing spline for b(z)\n");
+  clt->spec=spec;
+  clt->owns_spec=0;
+  clt->tracer_type=spec->tracer_type;
+  clt->has_rsd=spec->has_rsd;
+  clt->has_magnification=spec->has_magnification;
+  clt->has_intrinsic_alignment=spec->has_intrinsic_alignment;
+  clt->zmin=spec->zmin;
+  clt->zmax=spec->zmax;
+  clt->chi_source=0;
+  clt->spl_nz=spec->spl_nz;
+  clt->spl_bz=spec->spl_bz;
+  clt->spl_sz=spec->spl_sz;
+  clt->spl_rf=spec->spl_rf;
+  clt->spl_ba=spec->spl_ba;
+  clt->spl_wL=NULL;
+  clt->spl_wM=NULL;
+  clt->spl_nz_own=NULL;
+  clt->nz_shift=0;
+  clt->nz_stretch=1;
+
+  double hub=cosmo->params.h*ccl_h_over_h0(cosmo,1.,status)/ccl_constants.CLIGHT_HMPC;
+  clt->prefac_lensing=1.5*hub*hub*cosmo->params.Omega_m;
+
+  if(clt->tracer_type==ccl_number_counts_tracer) {
+    if(((cosmo->params.N_nu_mass)>0) && clt->has_rsd) {
+      *status=CCL_ERROR_NOT_IMPLEMENTED;
+      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_new(): Number counts tracers with RSD not yet implemented in cosmologies with massive neutrinos.");
+    }
+    if(*status==0) {
+      clt->chimax=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmax),status);
+      clt->chimin=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmin),status);
+    }
+    if((*status==0) && clt->has_magnification)
+      clt_init_wM(clt,cosmo,status);
   }
+  else if(clt->tracer_type==ccl_weak_lensing_tracer) {
+    clt->chimax=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmax),status);
+    clt->chimin=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmin),status);
+    if(*status==0)
+      clt_init_wL(clt,cosmo,status);
+  }
+  else if(clt->tracer_type==ccl_cmb_lensing_tracer) {
+    clt->chi_source=ccl_comoving_radial_distance(cosmo,1./(1+spec->z_source),status);
+    clt->chimax=clt->chi_source;
+    clt->chimin=0;
+  }
+
+  if(*status) {
+    ccl_cl_tracer_free(clt);
+    clt=NULL;
+  }
+
+  return clt;
 }
 
-static void clt_wl_init(CCL_ClTracer *clt,ccl_cosmology *cosmo,
-			int has_intrinsic_alignment,
-			int nz_n,double *z_n,double *n,
-			int nz_ba,double *z_ba,double *ba,
-			int nz_rf,double *z_rf,double *rf,int *status)
+//Binds a CCL_ClTracerSpec to a cosmology, with error checking.
+//The spec is not copied and must outlive the returned tracer.
+CCL_ClTracer *ccl_cl_tracer_bind(ccl_cosmology *cosmo,CCL_ClTracerSpec *spec,int *status)
 {
-  clt->has_intrinsic_alignment=has_intrinsic_alignment;
-
-  clt_init_nz(clt,cosmo,nz_n,z_n,n,status);
-  clt_init_wL(clt,cosmo,status);
-  if(clt->has_intrinsic_alignment) {
-    clt_init_rf(clt,cosmo,nz_rf,z_rf,rf,status);
-    clt_init_ba(clt,cosmo,nz_ba,z_ba,ba,status);
-  }
+  CCL_ClTracer *clt=cl_tracer_bind(cosmo,spec,status);
+  ccl_check_status(cosmo,status);
+  return clt;
 }
 
 //CCL_ClTracer creator
@@ -521,41 +705,18 @@ static CCL_ClTracer *cl_tracer(ccl_cosmology *cosmo,int tracer_type,
 			       int nz_rf,double *z_rf,double *rf,
 			       double z_source, int * status)
 {
-  int clstatus=0;
-  CCL_ClTracer *clt=(CCL_ClTracer *)malloc(sizeof(CCL_ClTracer));
-  if(clt==NULL) {
-    *status=CCL_ERROR_MEMORY;
-    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer(): memory allocation\n");
-  }
+  CCL_ClTracer *clt=NULL;
+  CCL_ClTracerSpec *spec=cl_tracer_spec(cosmo,&(cosmo->gsl_params),tracer_type,
+					has_rsd,has_magnification,has_intrinsic_alignment,
+					nz_n,z_n,n,nz_b,z_b,b,nz_s,z_s,s,
+					nz_ba,z_ba,ba,nz_rf,z_rf,rf,z_source,status);
 
   if(*status==0) {
-    clt->tracer_type=tracer_type;
-    
-    double hub=cosmo->params.h*ccl_h_over_h0(cosmo,1.,status)/ccl_constants.CLIGHT_HMPC;
-    clt->prefac_lensing=1.5*hub*hub*cosmo->params.Omega_m;
-
-    if(tracer_type==ccl_number_counts_tracer)
-      clt_nc_init(clt,cosmo,has_rsd,has_magnification,
-		  nz_n,z_n,n,nz_b,z_b,b,nz_s,z_s,s,status);
-    else if(tracer_type==ccl_weak_lensing_tracer)
-      clt_wl_init(clt,cosmo,has_intrinsic_alignment,
-		  nz_n,z_n,n,nz_ba,z_ba,ba,nz_rf,z_rf,rf,status);
-    else if(tracer_type==ccl_cmb_lensing_tracer) {
-      clt->chi_source=ccl_comoving_radial_distance(cosmo,1./(1+z_source),status);
-      clt->chimax=clt->chi_source;
-      clt->chimin=0;
-    }
-    else {
-      free(clt);
-      *status=CCL_ERROR_INCONSISTENT;
-      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer(): unknown tracer type\n");
-      return NULL;
-    }
-  }
-
-  if(*status) {
-    free(clt);
-    clt=NULL;
+    clt=cl_tracer_bind(cosmo,spec,status);
+    if(clt==NULL)
+      ccl_cl_tracer_spec_free(spec);
+    else
+      clt->owns_spec=1;
   }
     
   return clt;
@@ -588,26 +749,184 @@ CCL_ClTracer *ccl_cl_tracer(ccl_cosmology *cosmo,int tracer_type,
   return clt;
 }
 
-//CCL_ClTracer destructor
-void ccl_cl_tracer_free(CCL_ClTracer *clt)
+//Number of sub-intervals between consecutive nodes of a lensing kernel
+//used to compute the cumulative integrals in clt_update_kernel
+#define CCL_KERNEL_SUBSAMPLE 4
+
+//Cosine-like counterpart of ccl_sinn: cos(x), 1 or cosh(x) for k>0, k=0 or k<0
+static double clt_cosn(ccl_cosmology *cosmo,double chi)
 {
-  if((clt->tracer_type==ccl_number_counts_tracer) || (clt->tracer_type==ccl_weak_lensing_tracer))
-    ccl_spline_free(clt->spl_nz);
+  if(cosmo->params.k_sign==1)
+    return cos(cosmo->params.sqrtk*chi);
+  else if(cosmo->params.k_sign==-1)
+    return cosh(cosmo->params.sqrtk*chi);
+  else
+    return 1;
+}
 
-  if(clt->tracer_type==ccl_number_counts_tracer) {
-    ccl_spline_free(clt->spl_bz);
-    if(clt->has_magnification) {
-      ccl_spline_free(clt->spl_sz);
-      ccl_spline_free(clt->spl_wM);
+//Recomputes the lensing (use_sz=0) or magnification (use_sz=1) kernel of a tracer in place.
+//Writing the kernel as
+//  w(chi) = Integral[ dN/dchi(chi') * (1-5/2*s(chi')) * f(chi'-chi)/f(chi') , chi < chi' < chi_max ],
+//with f=sinn, and using f(chi'-chi)/f(chi') = cosn(chi) - f(chi)*cosn(chi')/f(chi'), the kernel
+//at all nodes follows from two cumulative integrals computed in a single pass from chi_max to 0.
+//The number of nodes in spl_w is kept fixed.
+static void clt_update_kernel(CCL_ClTracer *clt,ccl_cosmology *cosmo,SplPar *spl_w,
+			      int use_sz,int *status)
+{
+  int j,nchi=(int)(spl_w->spline->size);
+  int nfine=CCL_KERNEL_SUBSAMPLE*(nchi-1)+1;
+  double zmax=clt->spl_nz->xf;
+  double chimax,dchi,*x,*y;
+  double int0=0,int1=0,p_prev=0,q_prev=0;
+
+  if(zmax<=0) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_update_kernel(): N(z) has no support at z>0\n");
+    return;
+  }
+
+  x=(double *)malloc(2*nchi*sizeof(double));
+  if(x==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_update_kernel(): memory allocation\n");
+    return;
+  }
+  y=&(x[nchi]);
+
+  chimax=ccl_comoving_radial_distance(cosmo,1./(1+zmax),status);
+  dchi=chimax/(nfine-1);
+  for(j=nfine-1;j>=0;j--) {
+    double chi=j*dchi;
+    double a=ccl_scale_factor_of_chi(cosmo,chi,status);
+    double z=1./a-1;
+    double h=cosmo->params.h*ccl_h_over_h0(cosmo,a,status)/ccl_constants.CLIGHT_HMPC;
+    double p=h*ccl_spline_eval(z,clt->spl_nz);
+    double q=0;
+    if(use_sz)
+      p*=1-2.5*ccl_spline_eval(z,clt->spl_sz);
+    if(chi>0)
+      q=p*clt_cosn(cosmo,chi)/ccl_sinn(cosmo,chi,status);
+
+    //Trapezoidal rule
+    if(j<nfine-1) {
+      int0+=0.5*dchi*(p+p_prev);
+      int1+=0.5*dchi*(q+q_prev);
+    }
+    p_prev=p;
+    q_prev=q;
+
+    if(j%CCL_KERNEL_SUBSAMPLE==0) {
+      int i=j/CCL_KERNEL_SUBSAMPLE;
+      x[i]=chi;
+      y[i]=clt_cosn(cosmo,chi)*int0-ccl_sinn(cosmo,chi,status)*int1;
     }
   }
-  else if(clt->tracer_type==ccl_weak_lensing_tracer) {
-    ccl_spline_free(clt->spl_wL);
-    if(clt->has_intrinsic_alignment) {
-      ccl_spline_free(clt->spl_ba);
-      ccl_spline_free(clt->spl_rf);
+  x[nchi-1]=chimax;
+  y[nchi-1]=0;
+
+  if(*status==0) {
+    if(ccl_spline_reinit(spl_w,nchi,x,y,y[0],0)) {
+      *status=CCL_ERROR_SPLINE;
+      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: clt_update_kernel(): error updating spline for lensing window\n");
+    }
+  }
+  free(x);
+}
+
+void ccl_cl_tracer_nz_transform(ccl_cosmology *cosmo,CCL_ClTracer *clt,
+				double dz,double stretch,int *status)
+{
+  int ii;
+  double *z_t,*n_t;
+  CCL_ClTracerSpec *spec=clt->spec;
+  double zm=spec->z_mean;
+
+  if((clt->tracer_type!=ccl_number_counts_tracer) && (clt->tracer_type!=ccl_weak_lensing_tracer)) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_nz_transform(): tracer has no N(z)\n");
+    return;
+  }
+  if(stretch<=0) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_nz_transform(): stretch must be positive\n");
+    return;
+  }
+  //The N(z) nodes are sorted, so only the first one can end up below z=0
+  if(zm+stretch*(spec->z_n[0]-zm)+dz<0) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_nz_transform(): "
+				     "transformed N(z) extends below z=0\n");
+    return;
+  }
+
+  //The spec's N(z) can't be modified if other tracers may be using it
+  if((!clt->owns_spec) && (clt->spl_nz_own==NULL)) {
+    clt->spl_nz_own=ccl_spline_init(spec->nz_n,spec->z_n,spec->n_norm,0,0);
+    if(clt->spl_nz_own==NULL) {
+      *status=CCL_ERROR_SPLINE;
+      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_nz_transform(): error initializing spline for N(z)\n");
+      return;
+    }
+    clt->spl_nz=clt->spl_nz_own;
+  }
+
+  z_t=(double *)malloc(2*spec->nz_n*sizeof(double));
+  if(z_t==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_nz_transform(): memory allocation\n");
+    return;
+  }
+  n_t=&(z_t[spec->nz_n]);
+
+  //Remap nodes. Dividing by the stretch preserves the normalization
+  for(ii=0;ii<spec->nz_n;ii++) {
+    z_t[ii]=zm+stretch*(spec->z_n[ii]-zm)+dz;
+    n_t[ii]=spec->n_norm[ii]/stretch;
+  }
+  if(ccl_spline_reinit(clt->spl_nz,spec->nz_n,z_t,n_t,0,0)) {
+    *status=CCL_ERROR_SPLINE;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_tracer_nz_transform(): error updating spline for N(z)\n");
+  }
+  free(z_t);
+
+  if(*status==0) {
+    clt->nz_shift=dz;
+    clt->nz_stretch=stretch;
+    clt->zmin=CCL_MAX(zm+stretch*(spec->zmin-zm)+dz,0.);
+    clt->zmax=CCL_MAX(zm+stretch*(spec->zmax-zm)+dz,clt->zmin);
+    clt->chimax=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmax),status);
+    clt->chimin=ccl_comoving_radial_distance(cosmo,1./(1+clt->zmin),status);
+
+    if(clt->tracer_type==ccl_number_counts_tracer) {
+      if(clt->has_magnification) {
+	clt->zmin=0;
+	clt->chimin=0;
+	clt_update_kernel(clt,cosmo,clt->spl_wM,1,status);
+      }
+    }
+    else {
+      clt->zmin=0;
+      clt->chimin=0;
+      clt_update_kernel(clt,cosmo,clt->spl_wL,0,status);
     }
   }
+
+  ccl_check_status(cosmo,status);
+}
+
+//CCL_ClTracer destructor
+//The redshift-dependent splines belong to the tracer spec,
+//which is only released if the tracer created it.
+void ccl_cl_tracer_free(CCL_ClTracer *clt)
+{
+  if(clt->spl_wL!=NULL)
+    ccl_spline_free(clt->spl_wL);
+  if(clt->spl_wM!=NULL)
+    ccl_spline_free(clt->spl_wM);
+  if(clt->spl_nz_own!=NULL)
+    ccl_spline_free(clt->spl_nz_own);
+  if(clt->owns_spec)
+    ccl_cl_tracer_spec_free(clt->spec);
   free(clt);
 }
 
@@ -694,16 +1013,19 @@ static double f_mag(double a,double chi,ccl_cosmology *cosmo,CCL_ClTracer *clt,
 //cosmo -> ccl_cosmology object
 //w -> CCL_ClWorskpace object
 //clt -> CCL_ClTracer object (must be of the ccl_number_counts_tracer type)
-static double transfer_nc(int l,double k,
-			  ccl_cosmology *cosmo,CCL_ClWorkspace *w,CCL_ClTracer *clt, int * status)
+//mask -> bit mask of the kernel components to include (see CCL_CLC_MASK)
+static double transfer_nc(double l,double k,
+			  ccl_cosmology *cosmo,CCL_ClWorkspace *w,CCL_ClTracer *clt,int mask,int * status)
 {
   double ret=0;
   double x0=(l+0.5);
   double chi0=x0/k;
   if(chi0<=clt->chimax) {
     double a0=ccl_scale_factor_of_chi(cosmo,chi0,status);
-    double f_all=f_dens(a0,cosmo,clt,status);
-    if(clt->has_rsd) {
+    double f_all=0;
+    if(mask & CCL_CLC_MASK(ccl_clc_density))
+      f_all+=f_dens(a0,cosmo,clt,status);
+    if(clt->has_rsd && (mask & CCL_CLC_MASK(ccl_clc_rsd))) {
       double x1=(l+1.5);
       double chi1=x1/k;
       if(chi1<=clt->chimax) {
@@ -715,7 +1037,7 @@ static double transfer_nc(int l,double k,
 	f_all+=fg0*(1.-l*(l-1.)/(x0*x0))-fg1*2.*sqrt((l+0.5)*pk1/((l+1.5)*pk0))/x1;
       }
     }
-    if(clt->has_magnification)
+    if(clt->has_magnification && (mask & CCL_CLC_MASK(ccl_clc_magnification)))
       f_all+=-2*clt->prefac_lensing*l*(l+1)*f_mag(a0,chi0,cosmo,clt,status)/(k*k);
     ret=f_all;
   }
@@ -755,29 +1077,34 @@ static double f_IA_NLA(double a,double chi,ccl_cosmology *cosmo,CCL_ClTracer *cl
 //cosmo -> ccl_cosmology object
 //w -> CCL_ClWorskpace object
 //clt -> CCL_ClTracer object (must be of the ccl_weak_lensing_tracer type)
-static double transfer_wl(int l,double k,
-			  ccl_cosmology *cosmo,CCL_ClWorkspace *w,CCL_ClTracer *clt, int * status)
+//mask -> bit mask of the kernel components to include (see CCL_CLC_MASK)
+static double transfer_wl(double l,double k,
+			  ccl_cosmology *cosmo,CCL_ClWorkspace *w,CCL_ClTracer *clt,int mask,int * status)
 {
   double ret=0;
   double chi=(l+0.5)/k;
   if(chi<=clt->chimax) {
     double a=ccl_scale_factor_of_chi(cosmo,chi,status);
-    double f_all=f_lensing(a,chi,cosmo,clt,status);
-    if(clt->has_intrinsic_alignment)
+    double f_all=0;
+    if(mask & CCL_CLC_MASK(ccl_clc_lensing))
+      f_all+=f_lensing(a,chi,cosmo,clt,status);
+    if(clt->has_intrinsic_alignment && (mask & CCL_CLC_MASK(ccl_clc_ia)))
       f_all+=f_IA_NLA(a,chi,cosmo,clt,status);
     
     ret=f_all;
   }
 
-  return sqrt((l+2.)*(l+1.)*l*(l-1.))*ret/(k*k);
+  return sqrt(fmax((l+2.)*(l+1.)*l*(l-1.),0))*ret/(k*k);
   //return (l+1.)*l*ret/(k*k);
 }
 
-static double transfer_cmblens(int l,double k,ccl_cosmology *cosmo,CCL_ClTracer *clt,int *status)
+static double transfer_cmblens(double l,double k,ccl_cosmology *cosmo,CCL_ClTracer *clt,int mask,int *status)
 {
   double chi=(l+0.5)/k;
   if(chi>=clt->chi_source)
     return 0;
+  if(!(mask & CCL_CLC_MASK(ccl_clc_lensing)))
+    return 0;
 
   if(chi<=clt->chimax) {
     double a=ccl_scale_factor_of_chi(cosmo,chi,status);
@@ -792,17 +1119,18 @@ static double transfer_cmblens(int l,double k,ccl_cosmology *cosmo,CCL_ClTracer
 //k -> wavenumber modulus
 //cosmo -> ccl_cosmology object
 //clt -> CCL_ClTracer object
-static double transfer_wrap(int il,double k,ccl_cosmology *cosmo,
-			    CCL_ClWorkspace *w,CCL_ClTracer *clt, int * status)
+//mask -> bit mask of the kernel components to include
+static double transfer_wrap(double l,double k,ccl_cosmology *cosmo,
+			    CCL_ClWorkspace *w,CCL_ClTracer *clt,int mask,int * status)
 {
   double transfer_out=0;
 
   if(clt->tracer_type==ccl_number_counts_tracer)
-    transfer_out=transfer_nc(w->l_arr[il],k,cosmo,w,clt,status);
+    transfer_out=transfer_nc(l,k,cosmo,w,clt,mask,status);
   else if(clt->tracer_type==ccl_weak_lensing_tracer)
-    transfer_out=transfer_wl(w->l_arr[il],k,cosmo,w,clt,status);
+    transfer_out=transfer_wl(l,k,cosmo,w,clt,mask,status);
   else if(clt->tracer_type==ccl_cmb_lensing_tracer)
-    transfer_out=transfer_cmblens(w->l_arr[il],k,cosmo,clt,status);
+    transfer_out=transfer_cmblens(l,k,cosmo,clt,mask,status);
   else
     transfer_out=-1;
   return transfer_out;
@@ -810,11 +1138,13 @@ static double transfer_wrap(int il,double k,ccl_cosmology *cosmo,
 
 //Params for power spectrum integrand
 typedef struct {
-  int il;
+  double l;
   ccl_cosmology *cosmo;
   CCL_ClWorkspace *w;
   CCL_ClTracer *clt1;
   CCL_ClTracer *clt2;
+  int mask1; //Kernel components included for each tracer
+  int mask2;
   ccl_p2d_t *psp;
   int *status;
 } IntClPar;
@@ -825,14 +1155,14 @@ static double cl_integrand(double lk,void *params)
   double d1,d2;
   IntClPar *p=(IntClPar *)params;
   double k=exp(lk);
-  d1=transfer_wrap(p->il,k,p->cosmo,p->w,p->clt1,p->status);
+  d1=transfer_wrap(p->l,k,p->cosmo,p->w,p->clt1,p->mask1,p->status);
   if(d1==0)
     return 0;
-  d2=transfer_wrap(p->il,k,p->cosmo,p->w,p->clt2,p->status);
+  d2=transfer_wrap(p->l,k,p->cosmo,p->w,p->clt2,p->mask2,p->status);
   if(d2==0)
     return 0;
 
-  double chi=(p->w->l_arr[p->il]+0.5)/k;
+  double chi=(p->l+0.5)/k;
   double a=ccl_scale_factor_of_chi(p->cosmo,chi,p->status);
   double pk=ccl_p2d_t_eval(p->psp,lk,a,p->cosmo,p->status);
   
@@ -845,7 +1175,7 @@ static double cl_integrand(double lk,void *params)
 //l    -> angular multipole
 //lkmin, lkmax -> log of the range of scales where the transfer functions have support
 static void get_k_interval(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
-			   CCL_ClTracer *clt1,CCL_ClTracer *clt2,int l,
+			   CCL_ClTracer *clt1,CCL_ClTracer *clt2,double l,
 			   double *lkmin,double *lkmax)
 {
   double chimin,chimax;
@@ -881,13 +1211,36 @@ static void get_k_interval(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
   *lkmin=log(fmax( cosmo->spline_params.K_MIN  ,0.5*(l+0.5)/chimax));
 }
 
+//Makes sure the integration workspaces held by a CCL_ClWorkspace match
+//the current GSL parameters. They are only reallocated if N_ITERATION changes.
+static int cl_workspace_setup_integration(CCL_ClWorkspace *cw,ccl_cosmology *cosmo,int *status)
+{
+  if((cw->w_qag!=NULL) && (cw->n_iteration==cosmo->gsl_params.N_ITERATION))
+    return 0;
+
+  if(cw->w_qag!=NULL)
+    gsl_integration_workspace_free(cw->w_qag);
+  if(cw->w_cquad!=NULL)
+    gsl_integration_cquad_workspace_free(cw->w_cquad);
+  cw->w_cquad=NULL; //Only allocated if needed
+  cw->n_iteration=cosmo->gsl_params.N_ITERATION;
+  cw->w_qag=gsl_integration_workspace_alloc(cw->n_iteration);
+  if(cw->w_qag==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_angular_cl_native(): memory allocation\n");
+    return 1;
+  }
+  return 0;
+}
+
 //Compute angular power spectrum between two bins
 //cosmo -> ccl_cosmology object
-//il -> index in angular multipole array
+//l -> angular multipole
 //clt1 -> tracer #1
 //clt2 -> tracer #2
-static double ccl_angular_cl_native(ccl_cosmology *cosmo,CCL_ClWorkspace *cw,int il,
-				    CCL_ClTracer *clt1,CCL_ClTracer *clt2,
+//mask1, mask2 -> kernel components included for each tracer
+static double ccl_angular_cl_native(ccl_cosmology *cosmo,CCL_ClWorkspace *cw,double l,
+				    CCL_ClTracer *clt1,CCL_ClTracer *clt2,int mask1,int mask2,
 				    ccl_p2d_t *psp,int * status)
 {
   int clastatus=0, gslstatus;
@@ -896,7 +1249,9 @@ static double ccl_angular_cl_native(ccl_cosmology *cosmo,CCL_ClWorkspace *cw,int
   double lkmin,lkmax;
   ccl_p2d_t *psp_use;
   gsl_function F;
-  gsl_integration_workspace *w=gsl_integration_workspace_alloc(cosmo->gsl_params.N_ITERATION);
+
+  if(cl_workspace_setup_integration(cw,cosmo,status))
+    return -1;
 
   if(psp==NULL) {
     if (!cosmo->computed_power) ccl_cosmology_compute_power(cosmo, status);
@@ -907,16 +1262,18 @@ static double ccl_angular_cl_native(ccl_cosmology *cosmo,CCL_ClWorkspace *cw,int
   else
     psp_use=psp;
   
-  ipar.il=il;
+  ipar.l=l;
   ipar.cosmo=cosmo;
   ipar.w=cw;
   ipar.clt1=clt1;
   ipar.clt2=clt2;
+  ipar.mask1=mask1;
+  ipar.mask2=mask2;
   ipar.psp=psp_use;
   ipar.status = &clastatus;
   F.function=&cl_integrand;
   F.params=&ipar;
-  get_k_interval(cosmo,cw,clt1,clt2,cw->l_arr[il],&lkmin,&lkmax);
+  get_k_interval(cosmo,cw,clt1,clt2,l,&lkmin,&lkmax);
   // This computes the angular power spectra in the Limber approximation between two quantities a and b:
   //  C_ell^ab = 2/(2*ell+1) * Integral[ Delta^a_ell(k) Delta^b_ell(k) * P(k) , k_min < k < k_max ]
   // Note that we use log(k) as an integration variable, and the ell-dependent prefactor is included
@@ -924,19 +1281,21 @@ static double ccl_angular_cl_native(ccl_cosmology *cosmo,CCL_ClWorkspace *cw,int
   gslstatus=gsl_integration_qag(&F, lkmin, lkmax, 0,
                                 cosmo->gsl_params.INTEGRATION_LIMBER_EPSREL, cosmo->gsl_params.N_ITERATION,
                                 cosmo->gsl_params.INTEGRATION_LIMBER_GAUSS_KRONROD_POINTS,
-                                w, &result, &eresult);
-  gsl_integration_workspace_free(w);
+                                cw->w_qag, &result, &eresult);
 
   // Test if a round-off error occured in the evaluation of the integral
   // If so, try another integration function, more robust but potentially slower
   if(gslstatus == GSL_EROUND) {
     ccl_raise_gsl_warning(gslstatus, "ccl_cls.c: ccl_angular_cl_native(): Default GSL integration failure, attempting backup method.");
-    gsl_integration_cquad_workspace *w_cquad= gsl_integration_cquad_workspace_alloc (cosmo->gsl_params.N_ITERATION);
     size_t nevals=0;
-    gslstatus=gsl_integration_cquad(&F, lkmin, lkmax, 0,
-				    cosmo->gsl_params.INTEGRATION_LIMBER_EPSREL,
-				    w_cquad, &result, &eresult, &nevals);
-    gsl_integration_cquad_workspace_free(w_cquad);
+    if(cw->w_cquad==NULL)
+      cw->w_cquad=gsl_integration_cquad_workspace_alloc(cw->n_iteration);
+    if(cw->w_cquad==NULL)
+      gslstatus=GSL_ENOMEM;
+    else
+      gslstatus=gsl_integration_cquad(&F, lkmin, lkmax, 0,
+				      cosmo->gsl_params.INTEGRATION_LIMBER_EPSREL,
+				      cw->w_cquad, &result, &eresult, &nevals);
   }
   if(gslstatus!=GSL_SUCCESS || *ipar.status) {
     ccl_raise_gsl_warning(gslstatus, "ccl_cls.c: ccl_angular_cl_native():");
@@ -949,67 +1308,309 @@ static double ccl_angular_cl_native(ccl_cosmology *cosmo,CCL_ClWorkspace *cw,int
   }
   ccl_check_status(cosmo,status);
 
-  return result/(cw->l_arr[il]+0.5);
+  return result/(l+0.5);
 }
 
-void ccl_angular_cls(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
-		     CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
-		     int nl_out,int *l_out,double *cl_out,int *status)
+//Parameters of the native non-Limber calculation
+#define CCL_NONLIMBER_CHI_RATIO 1E4 //Ratio between the largest and smallest comoving distances sampled
+#define CCL_NONLIMBER_CHI_PAD 2. //Kernels are zero-padded up to this factor times their maximum distance
+#define CCL_NONLIMBER_NCHI_MIN 1024 //Minimum and maximum number of samples in comoving distance
+#define CCL_NONLIMBER_NCHI_MAX 16384
+#define CCL_NONLIMBER_NPERKERNEL 64 //Minimum number of samples across the N(z) of number counts tracers
+#define CCL_NONLIMBER_TAPER 0.05 //Fraction of the grid over which kernels are tapered at low distances
+
+//Radial kernels of a tracer sampled on the grid of comoving distances used in
+//the non-Limber calculation. The growth factor is included in all of them.
+//The transfer function of the tracer is then
+//  Delta_l(k) = Integral[ dchi (f_0(chi) j_l(k*chi) - f_rsd(chi) j_l''(k*chi)) ]
+//             + g_2(l)/k^2 * Integral[ dchi f_2(chi) j_l(k*chi) ]
+typedef struct {
+  double *f_0; //Clustering
+  double *f_rsd; //Redshift-space distortions
+  double *f_2; //Lensing-like contributions (shear, IA, magnification, CMB lensing)
+  int has_0,has_rsd,has_2;
+} NonLimberKernels;
+
+//Redshift range where the N(z) of a tracer has support, taking into account
+//any shift or stretch applied to it
+static void clt_nz_support(CCL_ClTracer *clt,double *zmin,double *zmax)
 {
-  int ii,do_angpow;
-  double *l_nodes,*cl_nodes;
-  SplPar *spcl_nodes;
-  
-  //First check if ell range is within workspace
-  for(ii=0;ii<nl_out;ii++) {
-    if(l_out[ii]>w->lmax) {
-      *status=CCL_ERROR_SPLINE_EV;
-      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_angular_cls(); "
-	     "requested l beyond range allowed by workspace\n");
-      return;
+  double zm=clt->spec->z_mean;
+  *zmin=CCL_MAX(zm+clt->nz_stretch*(clt->spec->zmin-zm)+clt->nz_shift,0.);
+  *zmax=CCL_MAX(zm+clt->nz_stretch*(clt->spec->zmax-zm)+clt->nz_shift,*zmin);
+}
+
+//Largest comoving distance at which the kernels of a tracer are non-zero
+static double clt_nonlimber_chimax(CCL_ClTracer *clt)
+{
+  double chimax=clt->chimax;
+  if((clt->tracer_type==ccl_number_counts_tracer) && clt->has_magnification)
+    chimax=fmax(chimax,clt->spl_wM->xf);
+  else if(clt->tracer_type==ccl_weak_lensing_tracer)
+    chimax=fmax(chimax,clt->spl_wL->xf);
+  return chimax;
+}
+
+//Prefactor g_2(l) of the lensing-like contributions
+static double clt_nonlimber_g2(CCL_ClTracer *clt,int l)
+{
+  if(clt->tracer_type==ccl_weak_lensing_tracer)
+    return (l<2) ? 0 : sqrt((l+2.)*(l+1.)*l*(l-1.));
+  else
+    return l*(l+1.);
+}
+
+//Samples the radial kernels of a tracer
+static void nonlimber_kernels(ccl_cosmology *cosmo,CCL_ClTracer *clt,int mask,
+			      int nchi,double *chi,NonLimberKernels *nk,int *status)
+{
+  int ii;
+  double chimax=clt_nonlimber_chimax(clt);
+
+  nk->has_0=0;
+  nk->has_rsd=0;
+  nk->has_2=0;
+  if(clt->tracer_type==ccl_number_counts_tracer) {
+    nk->has_0=mask & CCL_CLC_MASK(ccl_clc_density);
+    nk->has_rsd=clt->has_rsd && (mask & CCL_CLC_MASK(ccl_clc_rsd));
+    nk->has_2=clt->has_magnification && (mask & CCL_CLC_MASK(ccl_clc_magnification));
+  }
+  else if(clt->tracer_type==ccl_weak_lensing_tracer) {
+    nk->has_2=(mask & CCL_CLC_MASK(ccl_clc_lensing)) ||
+      (clt->has_intrinsic_alignment && (mask & CCL_CLC_MASK(ccl_clc_ia)));
+  }
+  else if(clt->tracer_type==ccl_cmb_lensing_tracer)
+    nk->has_2=mask & CCL_CLC_MASK(ccl_clc_lensing);
+
+  for(ii=0;ii<nchi;ii++) {
+    double x=chi[ii];
+    nk->f_0[ii]=0;
+    nk->f_rsd[ii]=0;
+    nk->f_2[ii]=0;
+    if(x>chimax)
+      continue;
+
+    double a=ccl_scale_factor_of_chi(cosmo,x,status);
+    double gf=ccl_growth_factor(cosmo,a,status);
+    if(clt->tracer_type==ccl_number_counts_tracer) {
+      if(nk->has_0)
+	nk->f_0[ii]=gf*f_dens(a,cosmo,clt,status);
+      if(nk->has_rsd)
+	nk->f_rsd[ii]=gf*f_rsd(a,cosmo,clt,status);
+      if(nk->has_2)
+	nk->f_2[ii]=-2*clt->prefac_lensing*gf*f_mag(a,x,cosmo,clt,status);
+    }
+    else if(clt->tracer_type==ccl_weak_lensing_tracer) {
+      double f=0;
+      if(mask & CCL_CLC_MASK(ccl_clc_lensing))
+	f+=f_lensing(a,x,cosmo,clt,status);
+      if(clt->has_intrinsic_alignment && (mask & CCL_CLC_MASK(ccl_clc_ia)))
+	f+=f_IA_NLA(a,x,cosmo,clt,status);
+      nk->f_2[ii]=gf*f;
     }
+    else if((clt->tracer_type==ccl_cmb_lensing_tracer) && nk->has_2 && (x<clt->chi_source))
+      nk->f_2[ii]=gf*clt->prefac_lensing*(1-x/clt->chi_source)/(a*x);
   }
+}
 
-  if(*status==0) {
-    //Allocate array for power spectrum at interpolation nodes
-    l_nodes=(double *)malloc(w->n_ls*sizeof(double));
-    if(l_nodes==NULL) {
+//Adds coef * k^kpow * Integral[ dchi f(chi) j_l(k*chi) ] to delta, with l=mu-1/2.
+//This uses the biased FFTLog transform
+//  b(k) = Integral[ a(chi) (k*chi)^q J_mu(k*chi) k dchi ],
+//with a=f*chi^(-1/2-q), so that Integral[ dchi f j_l(k*chi) ] = sqrt(pi/2) * k^(-3/2-q) * b(k).
+//q=-2 is used for lensing-like kernels, which behave like 1/chi at low distances.
+static void nonlimber_add_transform(int nchi,double *chi,double *f,double mu,double q,
+				    double coef,double kpow,double *taper,
+				    double *a,double *b,double *k,double *delta)
+{
+  int ii;
+
+  for(ii=0;ii<nchi;ii++)
+    a[ii]=taper[ii]*f[ii]*pow(chi[ii],-0.5-q);
+  fht_real(nchi,chi,a,k,b,mu,q,1.,0);
+  for(ii=0;ii<nchi;ii++)
+    delta[ii]+=coef*sqrt(M_PI/2)*pow(k[ii],kpow-1.5-q)*b[ii];
+}
+
+//Computes the non-Limber transfer function Delta_l(k) of a tracer
+static void nonlimber_delta(CCL_ClTracer *clt,NonLimberKernels *nk,int l,
+			    int nchi,double *chi,double *taper,double *f_tmp,
+			    double *a,double *b,double *k,double *delta)
+{
+  int ii;
+  double mu=l+0.5;
+
+  for(ii=0;ii<nchi;ii++)
+    delta[ii]=0;
+
+  //j_l'' = c_m*j_{l-2} - c_0*j_l + c_p*j_{l+2}
+  double c_m=l*(l-1.)/((2*l-1.)*(2*l+1.));
+  double c_0=(2.*l*l+2.*l-1)/((2*l-1.)*(2*l+3.));
+  double c_p=(l+1.)*(l+2.)/((2*l+1.)*(2*l+3.));
+
+  if(nk->has_0 || nk->has_rsd) {
+    for(ii=0;ii<nchi;ii++)
+      f_tmp[ii]=nk->f_0[ii]+c_0*nk->f_rsd[ii];
+    nonlimber_add_transform(nchi,chi,f_tmp,mu,0,1.,0,taper,a,b,k,delta);
+  }
+  if(nk->has_rsd) {
+    if(l>=2)
+      nonlimber_add_transform(nchi,chi,nk->f_rsd,mu-2,0,-c_m,0,taper,a,b,k,delta);
+    nonlimber_add_transform(nchi,chi,nk->f_rsd,mu+2,0,-c_p,0,taper,a,b,k,delta);
+  }
+  if(nk->has_2) {
+    double g2=clt_nonlimber_g2(clt,l);
+    if(g2>0)
+      nonlimber_add_transform(nchi,chi,nk->f_2,mu,-2,g2,-2,taper,a,b,k,delta);
+  }
+}
+
+//Adds non-Limber corrections to the C_ells at the nodes of a workspace with l<=l_limber.
+//Assuming a growth-separable power spectrum P(k,chi,chi')=P_lin(k)*D(chi)*D(chi') on large scales,
+//the exact C_ell is
+//  C_l = 2/pi * Integral[ dk k^2 P_lin(k) Delta^1_l(k) Delta^2_l(k) ],
+//with the Delta_l computed with FFTLog. Non-linear corrections are kept at the Limber level:
+//  C_l = C_l^Limber[P] + C_l^exact[P_lin] - C_l^Limber[P_lin]
+//cl_nodes must contain C_l^Limber[P] on input.
+static void angular_cls_nonlimber(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+				  CCL_ClTracer *clt1,CCL_ClTracer *clt2,int mask1,int mask2,
+				  double *cl_nodes,int *status)
+{
+  int ii,il,nchi,same=(clt1==clt2) && (mask1==mask2);
+  double chi_hi,dlnchi,lchi_range=log(CCL_NONLIMBER_CHI_RATIO);
+  double *chi,*taper,*k,*delta1,*delta2,*d2,*f_tmp;
+  double *a,*b;
+  NonLimberKernels nk1,nk2;
+
+  if (!cosmo->computed_power) ccl_cosmology_compute_power(cosmo, status);
+  if (!cosmo->computed_power) return;
+
+  //Choose the number of samples so that number counts kernels are well resolved
+  dlnchi=lchi_range/CCL_NONLIMBER_NCHI_MIN;
+  for(ii=0;ii<2;ii++) {
+    CCL_ClTracer *clt=(ii==0) ? clt1 : clt2;
+    if(clt->tracer_type==ccl_number_counts_tracer) {
+      double zmin,zmax;
+      clt_nz_support(clt,&zmin,&zmax);
+      double chimin_d=ccl_comoving_radial_distance(cosmo,1./(1+zmin),status);
+      double chimax_d=ccl_comoving_radial_distance(cosmo,1./(1+zmax),status);
+      if(chimin_d>0)
+	dlnchi=fmin(dlnchi,log(chimax_d/chimin_d)/CCL_NONLIMBER_NPERKERNEL);
+    }
+  }
+  nchi=CCL_NONLIMBER_NCHI_MIN;
+  while((nchi<CCL_NONLIMBER_NCHI_MAX) && (lchi_range/nchi>dlnchi))
+    nchi*=2;
+
+  //Buffers are kept in the workspace
+  if(w->n_chi_nonlimber<nchi) {
+    free(w->buf_nonlimber);
+    //chi, taper, k, delta1, delta2, f_tmp, 3 kernels per tracer and FFTLog input/output
+    w->buf_nonlimber=(double *)malloc(14*nchi*sizeof(double));
+    if(w->buf_nonlimber==NULL) {
+      w->n_chi_nonlimber=0;
       *status=CCL_ERROR_MEMORY;
       ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_angular_cls(); memory allocation\n");
+      return;
     }
+    w->n_chi_nonlimber=nchi;
+  }
+  chi=w->buf_nonlimber;
+  taper=&(chi[nchi]);
+  k=&(chi[2*nchi]);
+  delta1=&(chi[3*nchi]);
+  delta2=&(chi[4*nchi]);
+  f_tmp=&(chi[5*nchi]);
+  nk1.f_0=&(chi[6*nchi]); nk1.f_rsd=&(chi[7*nchi]); nk1.f_2=&(chi[8*nchi]);
+  nk2.f_0=&(chi[9*nchi]); nk2.f_rsd=&(chi[10*nchi]); nk2.f_2=&(chi[11*nchi]);
+  a=&(chi[12*nchi]);
+  b=&(chi[13*nchi]);
+
+  //Logarithmic grid in comoving distance
+  chi_hi=CCL_NONLIMBER_CHI_PAD*fmax(clt_nonlimber_chimax(clt1),clt_nonlimber_chimax(clt2));
+  int ntaper=(int)(CCL_NONLIMBER_TAPER*nchi);
+  for(ii=0;ii<nchi;ii++) {
+    chi[ii]=chi_hi*exp(lchi_range*(ii-nchi+1.)/(nchi-1.));
+    taper[ii]=(ii<ntaper) ? 0.5*(1-cos(M_PI*ii/ntaper)) : 1;
   }
 
-  if(*status==0) {
-    cl_nodes=(double *)malloc(w->n_ls*sizeof(double));
-    if(cl_nodes==NULL) {
-      *status=CCL_ERROR_MEMORY;
-      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_angular_cls(); memory allocation\n");
+  nonlimber_kernels(cosmo,clt1,mask1,nchi,chi,&nk1,status);
+  if(!same)
+    nonlimber_kernels(cosmo,clt2,mask2,nchi,chi,&nk2,status);
+
+  for(il=0;il<w->n_ls;il++) {
+    int l=w->l_arr[il];
+    double cl_exact=0,cl_limber_lin;
+
+    if((l>w->l_limber) || (*status))
+      continue;
+
+    nonlimber_delta(clt1,&nk1,l,nchi,chi,taper,f_tmp,a,b,k,delta1);
+    if(!same)
+      nonlimber_delta(clt2,&nk2,l,nchi,chi,taper,f_tmp,a,b,k,delta2);
+    d2=same ? delta1 : delta2;
+
+    //All transforms share the same k grid, which is logarithmically spaced
+    double dlnk=log(k[1]/k[0]);
+    for(ii=0;ii<nchi;ii++) {
+      if((k[ii]<cosmo->spline_params.K_MIN) || (k[ii]>cosmo->spline_params.K_MAX))
+	continue;
+      double pk=ccl_linear_matter_power(cosmo,k[ii],1.,status);
+      cl_exact+=k[ii]*k[ii]*k[ii]*pk*delta1[ii]*d2[ii];
     }
+    cl_exact*=2*dlnk/M_PI;
+
+    cl_limber_lin=ccl_angular_cl_native(cosmo,w,l,clt1,clt2,mask1,mask2,cosmo->data.p_lin,status);
+    cl_nodes[il]+=cl_exact-cl_limber_lin;
   }
+}
 
-  if(*status==0) {
-    for(ii=0;ii<w->n_ls;ii++)
-      l_nodes[ii]=(double)(w->l_arr[ii]);
+//Computes the angular power spectrum between two tracers including only
+//the kernel components selected by mask1 and mask2.
+//Multipoles l<=l_limber are computed with the native non-Limber calculation,
+//unless Angpow has been selected in the workspace and can be used.
+static void angular_cls_masked(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+			       CCL_ClTracer *clt1,CCL_ClTracer *clt2,int mask1,int mask2,
+			       ccl_p2d_t *psp,int nl_out,int *l_out,double *cl_out,int *status)
+{
+  int ii,do_nonlimber,do_angpow;
+  double *cl_nodes=w->cl_nodes;
+  
+  //First check if ell range is within workspace
+  for(ii=0;ii<nl_out;ii++) {
+    if(l_out[ii]>w->lmax) {
+      *status=CCL_ERROR_SPLINE_EV;
+      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_angular_cls(); "
+	     "requested l beyond range allowed by workspace\n");
+      return;
+    }
+  }
 
-    do_angpow=0;
-    //Now check if angpow is needed at all
+  if(*status==0) {
+    do_nonlimber=0;
+    //Now check if non-limber is needed at all
     if(w->l_limber>0) {
       for(ii=0;ii<w->n_ls;ii++) {
 	if(w->l_arr[ii]<=w->l_limber)
-	  do_angpow=1;
+	  do_nonlimber=1;
       }
     }
+
+    do_angpow=do_nonlimber && (w->nonlimber_method==ccl_nonlimber_angpow);
 #ifndef HAVE_ANGPOW
     do_angpow=0;
 #endif //HAVE_ANGPOW
   
-    //Resort to Limber if we have lensing (this will hopefully only be temporary)
+    //Angpow doesn't support lensing
     if(clt1->tracer_type==ccl_weak_lensing_tracer || clt2->tracer_type==ccl_weak_lensing_tracer ||
        clt1->has_magnification || clt2->has_magnification) {
       do_angpow=0;
     }
 
-    //Use angpow if non-limber is needed
+    //Angpow can't separate kernel components
+    if((mask1!=CCL_CLC_ALL) || (mask2!=CCL_CLC_ALL))
+      do_angpow=0;
+
+    //Use angpow if requested and possible
     if(do_angpow)
       ccl_angular_cls_angpow(cosmo,w,clt1,clt2,cl_nodes,status);
     ccl_check_status(cosmo,status);
@@ -1019,28 +1620,176 @@ void ccl_angular_cls(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
     //Compute limber nodes
     for(ii=0;ii<w->n_ls;ii++) {
       if(((!do_angpow) || (w->l_arr[ii]>w->l_limber)) && (*status==0))
-	cl_nodes[ii]=ccl_angular_cl_native(cosmo,w,ii,clt1,clt2,psp,status);
+	cl_nodes[ii]=ccl_angular_cl_native(cosmo,w,w->l_arr[ii],clt1,clt2,mask1,mask2,psp,status);
     }
   }
 
+  if((*status==0) && do_nonlimber && (!do_angpow)) {
+    //Correct low multipoles for non-Limber effects
+    angular_cls_nonlimber(cosmo,w,clt1,clt2,mask1,mask2,cl_nodes,status);
+    ccl_check_status(cosmo,status);
+  }
+
   if(*status==0) {
-    //Interpolate into ells requested by user
-    spcl_nodes=ccl_spline_init(w->n_ls,l_nodes,cl_nodes,0,0);
-    if(spcl_nodes==NULL) {
-      *status=CCL_ERROR_MEMORY;
-      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_angular_cls(); memory allocation\n");
+    //Interpolate into ells requested by user.
+    //The node spline is created on first use and updated in place afterwards.
+    if(w->spl_nodes==NULL) {
+      w->spl_nodes=ccl_spline_init(w->n_ls,w->l_nodes,cl_nodes,0,0);
+      if(w->spl_nodes==NULL) {
+	*status=CCL_ERROR_MEMORY;
+	ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_angular_cls(); memory allocation\n");
+      }
+    }
+    else if(ccl_spline_reinit(w->spl_nodes,w->n_ls,w->l_nodes,cl_nodes,0,0)) {
+      *status=CCL_ERROR_SPLINE;
+      ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_cl_angular_cls(); error initializing spline\n");
     }
   }
   
   if(*status==0) {
     for(ii=0;ii<nl_out;ii++)
-      cl_out[ii]=ccl_spline_eval((double)(l_out[ii]),spcl_nodes);
+      cl_out[ii]=ccl_spline_eval((double)(l_out[ii]),w->spl_nodes);
+  }
+}
+
+void ccl_angular_cls(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+		     CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
+		     int nl_out,int *l_out,double *cl_out,int *status)
+{
+  angular_cls_masked(cosmo,w,clt1,clt2,CCL_CLC_ALL,CCL_CLC_ALL,psp,nl_out,l_out,cl_out,status);
+}
+
+void ccl_angular_cls_limber(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+			    CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
+			    int nl,double *l,double *cl,int *status)
+{
+  int ii;
+  CCL_ClWorkspace *w_use=w;
+
+  //Only the integration workspaces are needed, so any sampling will do
+  if(w_use==NULL)
+    w_use=ccl_cl_workspace_new_limber(2,1.05,1,status);
+  if(w_use==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_angular_cls_limber(); memory allocation\n");
+    return;
+  }
+
+  for(ii=0;ii<nl;ii++) {
+    if(*status)
+      break;
+    cl[ii]=ccl_angular_cl_native(cosmo,w_use,l[ii],clt1,clt2,CCL_CLC_ALL,CCL_CLC_ALL,psp,status);
+  }
+
+  if(w==NULL)
+    ccl_cl_workspace_free(w_use);
+  ccl_check_status(cosmo,status);
+}
+
+//Returns the bit mask of kernel components present in a tracer
+static int clt_component_mask(CCL_ClTracer *clt)
+{
+  int mask=0;
+
+  if(clt->tracer_type==ccl_number_counts_tracer) {
+    mask|=CCL_CLC_MASK(ccl_clc_density);
+    if(clt->has_rsd)
+      mask|=CCL_CLC_MASK(ccl_clc_rsd);
+    if(clt->has_magnification)
+      mask|=CCL_CLC_MASK(ccl_clc_magnification);
+  }
+  else if(clt->tracer_type==ccl_weak_lensing_tracer) {
+    mask|=CCL_CLC_MASK(ccl_clc_lensing);
+    if(clt->has_intrinsic_alignment)
+      mask|=CCL_CLC_MASK(ccl_clc_ia);
+  }
+  else if(clt->tracer_type==ccl_cmb_lensing_tracer)
+    mask|=CCL_CLC_MASK(ccl_clc_lensing);
+
+  return mask;
+}
+
+void ccl_cl_components_free(CCL_ClComponents *clc)
+{
+  if(clc==NULL)
+    return;
+  free(clc->l);
+  free(clc->cl_comp);
+  free(clc);
+}
+
+CCL_ClComponents *ccl_angular_cls_components(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+					     CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
+					     int nl_out,int *l_out,int *status)
+{
+  int c1,c2;
+  CCL_ClComponents *clc=(CCL_ClComponents *)malloc(sizeof(CCL_ClComponents));
+  if(clc==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_angular_cls_components(); memory allocation\n");
+    return NULL;
+  }
+
+  clc->nl=nl_out;
+  clc->mask1=clt_component_mask(clt1);
+  clc->mask2=clt_component_mask(clt2);
+  clc->l=(int *)malloc(nl_out*sizeof(int));
+  clc->cl_comp=(double *)calloc(CCL_CL_NCOMP*CCL_CL_NCOMP*nl_out,sizeof(double));
+  if((clc->l==NULL) || (clc->cl_comp==NULL)) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cls.c: ccl_angular_cls_components(); memory allocation\n");
+  }
+
+  if(*status==0) {
+    memcpy(clc->l,l_out,nl_out*sizeof(int));
+    for(c1=0;c1<CCL_CL_NCOMP;c1++) {
+      if(!(clc->mask1 & CCL_CLC_MASK(c1)))
+	continue;
+      for(c2=0;c2<CCL_CL_NCOMP;c2++) {
+	if(!(clc->mask2 & CCL_CLC_MASK(c2)))
+	  continue;
+	if(*status)
+	  break;
+
+	double *cl_here=&(clc->cl_comp[(c1*CCL_CL_NCOMP+c2)*nl_out]);
+	if((clt1==clt2) && (c2<c1)) //Auto-correlation: this combination was already computed
+	  memcpy(cl_here,&(clc->cl_comp[(c2*CCL_CL_NCOMP+c1)*nl_out]),nl_out*sizeof(double));
+	else
+	  angular_cls_masked(cosmo,w,clt1,clt2,CCL_CLC_MASK(c1),CCL_CLC_MASK(c2),
+			     psp,nl_out,l_out,cl_here,status);
+      }
+    }
+  }
+
+  if(*status) {
+    ccl_cl_components_free(clc);
+    clc=NULL;
+  }
+  ccl_check_status(cosmo,status);
+
+  return clc;
+}
+
+void ccl_angular_cls_combine(CCL_ClComponents *clc,double *amp1,double *amp2,double *cl_out)
+{
+  int c1,c2,ii;
+
+  for(ii=0;ii<clc->nl;ii++)
+    cl_out[ii]=0;
+
+  for(c1=0;c1<CCL_CL_NCOMP;c1++) {
+    if(!(clc->mask1 & CCL_CLC_MASK(c1)))
+      continue;
+    double a1=(amp1==NULL) ? 1 : amp1[c1];
+    for(c2=0;c2<CCL_CL_NCOMP;c2++) {
+      if(!(clc->mask2 & CCL_CLC_MASK(c2)))
+	continue;
+      double a12=a1*((amp2==NULL) ? 1 : amp2[c2]);
+      double *cl_here=&(clc->cl_comp[(c1*CCL_CL_NCOMP+c2)*clc->nl]);
+      for(ii=0;ii<clc->nl;ii++)
+	cl_out[ii]+=a12*cl_here[ii];
+    }
   }
-  
-  //Cleanup
-  ccl_spline_free(spcl_nodes);
-  free(cl_nodes);
-  free(l_nodes);
 }
 
 static int check_clt_fa_inconsistency(CCL_ClTracer *clt,int func_code)
@@ -1151,3 +1900,15 @@ int ccl_get_tracer_fas(ccl_cosmology *cosmo,CCL_ClTracer *clt,int na,double *a,d
 
   return 0;
 }
+
+void ccl_get_tracer_limber_kernel(ccl_cosmology *cosmo,CCL_ClTracer *clt,double l,
+				  int n_chi,double *chi,double *kernel,int *status)
+{
+  int ii;
+  for(ii=0;ii<n_chi;ii++) {
+    if(chi[ii]<=0)
+      kernel[ii]=0;
+    else //The Limber wavenumber at this distance is k=(l+1/2)/chi
+      kernel[ii]=transfer_wrap(l,(l+0.5)/chi[ii],cosmo,NULL,clt,CCL_CLC_ALL,status);
+  }
+}
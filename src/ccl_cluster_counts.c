@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include "ccl.h"
+
+// Number of Simpson intervals in each redshift bin
+#define CLUSTER_NZ_BIN 16
+
+// Simpson weight of node j out of n intervals of width h
+static double simpson_weight(int j, int n, double h)
+{
+  if((j==0) || (j==n))
+    return h/3;
+  return (j%2 ? 4 : 2)*h/3;
+}
+
+void ccl_cluster_counts(ccl_cosmology *cosmo, int n_z_bins, double *z_edges,
+			int n_m_bins, double *m_edges, double odelta, double f_sky,
+			ccl_cluster_selection selection, void *sel_params,
+			double *counts, int *status)
+{
+  int i,n_mn,n_zn;
+  int *n_int_m,*m_off;
+  double *m_nodes,*z_nodes,*integ;
+
+  for(i=0;i<n_z_bins;i++) {
+    if((z_edges[i]<0) || (z_edges[i+1]<=z_edges[i]))
+      *status=CCL_ERROR_INCONSISTENT;
+  }
+  for(i=0;i<n_m_bins;i++) {
+    if((m_edges[i]<=0) || (m_edges[i+1]<=m_edges[i]))
+      *status=CCL_ERROR_INCONSISTENT;
+  }
+  if(*status) {
+    ccl_cosmology_set_status_message(cosmo, "ccl_cluster_counts.c: ccl_cluster_counts(): "
+				     "bin edges must be positive and increasing\n");
+    return;
+  }
+
+  //Mass grid: an even number of intervals in log10(M) in each bin,
+  //with the nodes at the bin edges shared by neighbouring bins
+  n_int_m=malloc(2*n_m_bins*sizeof(int));
+  if(n_int_m==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cluster_counts.c: ccl_cluster_counts(): memory allocation\n");
+    return;
+  }
+  m_off=&(n_int_m[n_m_bins]);
+  n_mn=1;
+  for(i=0;i<n_m_bins;i++) {
+    int n=(int)ceil(log10(m_edges[i+1]/m_edges[i])*cosmo->spline_params.N_M_HM);
+    if(n<2) n=2;
+    if(n%2) n++;
+    n_int_m[i]=n;
+    m_off[i]=n_mn-1;
+    n_mn+=n;
+  }
+  n_zn=n_z_bins*CLUSTER_NZ_BIN+1;
+
+  m_nodes=malloc((n_mn+n_zn+(size_t)n_zn*n_m_bins)*sizeof(double));
+  if(m_nodes==NULL) {
+    free(n_int_m);
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_cluster_counts.c: ccl_cluster_counts(): memory allocation\n");
+    return;
+  }
+  z_nodes=&(m_nodes[n_mn]);
+  integ=&(m_nodes[n_mn+n_zn]);
+
+  for(i=0;i<n_m_bins;i++) {
+    double lm0=log10(m_edges[i]),lm1=log10(m_edges[i+1]);
+    for(int j=0;j<=n_int_m[i];j++)
+      m_nodes[m_off[i]+j]=pow(10.,lm0+(lm1-lm0)*j/n_int_m[i]);
+  }
+  for(i=0;i<n_z_bins;i++) {
+    for(int j=0;j<=CLUSTER_NZ_BIN;j++)
+      z_nodes[i*CLUSTER_NZ_BIN+j]=z_edges[i]+(z_edges[i+1]-z_edges[i])*j/CLUSTER_NZ_BIN;
+  }
+
+  //Everything the threads need (distances, growth, sigma(M) and the mass function
+  //parameters) is computed here with the original cosmology
+  {
+    double a0=1./(1.+z_nodes[0]),dn0;
+    double od0=(odelta>0) ? odelta : Dv_BryanNorman(cosmo,a0,status);
+    ccl_massfunc_array(cosmo,1,m_nodes,a0,od0,&dn0,status);
+    ccl_comoving_angular_distance(cosmo,a0,status);
+    ccl_h_over_h0(cosmo,a0,status);
+  }
+
+  //Inner mass integrals for every redshift node. Each thread works on its own
+  //copy of the cosmology, so that the spline accelerators are not shared.
+  if(*status==0) {
+    #pragma omp parallel default(none) \
+      shared(cosmo,n_int_m,m_off,m_nodes,z_nodes,integ,n_mn,n_zn,n_m_bins,odelta, \
+	     selection,sel_params,status)
+    {
+      int iz,local_status=0;
+      ccl_cosmology *cosmo_t=ccl_cosmology_thread_copy(cosmo);
+      double *dn=malloc(2*n_mn*sizeof(double));
+      double *sel=(dn==NULL) ? NULL : &(dn[n_mn]);
+      if((cosmo_t==NULL) || (dn==NULL))
+	local_status=CCL_ERROR_MEMORY;
+
+      #pragma omp for schedule(dynamic)
+      for(iz=0;iz<n_zn;iz++) {
+	double a,od,dm,dvdz;
+	if(local_status)
+	  continue;
+
+	a=1./(1.+z_nodes[iz]);
+	od=(odelta>0) ? odelta : Dv_BryanNorman(cosmo_t,a,&local_status);
+	ccl_massfunc_array(cosmo_t,n_mn,m_nodes,a,od,dn,&local_status);
+	if(selection!=NULL) {
+	  selection(n_mn,m_nodes,z_nodes[iz],sel,sel_params);
+	  for(int j=0;j<n_mn;j++)
+	    dn[j]*=sel[j];
+	}
+
+	//Comoving volume element per unit redshift and solid angle
+	dm=ccl_comoving_angular_distance(cosmo_t,a,&local_status);
+	dvdz=dm*dm*ccl_constants.CLIGHT_HMPC/(cosmo_t->params.h*ccl_h_over_h0(cosmo_t,a,&local_status));
+
+	for(int im=0;im<n_m_bins;im++) {
+	  int n=n_int_m[im];
+	  double h=log10(m_nodes[m_off[im]+n]/m_nodes[m_off[im]])/n,sum=0;
+	  for(int j=0;j<=n;j++)
+	    sum+=simpson_weight(j,n,h)*dn[m_off[im]+j];
+	  integ[(size_t)iz*n_m_bins+im]=dvdz*sum;
+	}
+      } //end omp for
+
+      if(local_status) {
+	#pragma omp critical
+	{
+	  *status=local_status;
+	  if(cosmo_t!=NULL)
+	    memcpy(cosmo->status_message,cosmo_t->status_message,sizeof(cosmo->status_message));
+	}
+      }
+      ccl_cosmology_thread_copy_free(cosmo_t);
+      free(dn);
+    } //end omp parallel
+
+    if(*status==CCL_ERROR_MEMORY)
+      ccl_cosmology_set_status_message(cosmo, "ccl_cluster_counts.c: ccl_cluster_counts(): memory allocation\n");
+  }
+
+  //Outer redshift integrals
+  if(*status==0) {
+    for(int iz=0;iz<n_z_bins;iz++) {
+      double h=(z_edges[iz+1]-z_edges[iz])/CLUSTER_NZ_BIN;
+      for(int im=0;im<n_m_bins;im++) {
+	double sum=0;
+	for(int j=0;j<=CLUSTER_NZ_BIN;j++)
+	  sum+=simpson_weight(j,CLUSTER_NZ_BIN,h)*integ[(size_t)(iz*CLUSTER_NZ_BIN+j)*n_m_bins+im];
+	counts[iz*n_m_bins+im]=4*M_PI*f_sky*sum;
+      }
+    }
+  }
+
+  free(m_nodes);
+  free(n_int_m);
+}
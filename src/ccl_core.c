@@ -107,6 +107,8 @@ const ccl_spline_params default_spline_params = {
   440,  // LOGM_SPLINE_NM
   6,  // LOGM_SPLINE_MIN
   17,  // LOGM_SPLINE_MAX
+  40,  // N_M_HM
+  0,  // SIGMA_SPLINE_2D
 
   // PS a and k spline
   40,  // A_SPLINE_NA_PK
@@ -271,6 +273,8 @@ ccl_cosmology * ccl_cosmology_create(ccl_parameters params, ccl_configuration co
 
   cosmo->data.logsigma = NULL;
   cosmo->data.dlnsigma_dlogm = NULL;
+  cosmo->data.logsigma_2d = NULL;
+  cosmo->data.dlnsigma_dlogm_2d = NULL;
 
   // hmf parameter for interpolation
   cosmo->data.alphahmf = NULL;
@@ -279,9 +283,10 @@ ccl_cosmology * ccl_cosmology_create(ccl_parameters params, ccl_configuration co
   cosmo->data.phihmf = NULL;
   cosmo->data.etahmf = NULL;
 
-  cosmo->data.rsd_splines[0] = NULL;
-  cosmo->data.rsd_splines[1] = NULL;
-  cosmo->data.rsd_splines[2] = NULL;
+  cosmo->data.n_xi_cache = 0;
+  cosmo->data.n_xi_cache_alloc = 0;
+  cosmo->data.xi_cache_a = NULL;
+  cosmo->data.xi_cache_splines = NULL;
 
   cosmo->data.p_lin = NULL;
   cosmo->data.p_nl = NULL;
@@ -847,6 +852,19 @@ ccl_parameters ccl_parameters_read_yaml(const char * filename, int *status)
 
 
 
+//Frees the cache of correlation function multipoles and leaves it empty
+static void xi_cache_free(ccl_data *data)
+{
+  for(int i=0;i<CCL_XI_CACHE_NL*data->n_xi_cache;i++)
+    ccl_spline_free(data->xi_cache_splines[i]);
+  free(data->xi_cache_a);
+  free(data->xi_cache_splines);
+  data->n_xi_cache=0;
+  data->n_xi_cache_alloc=0;
+  data->xi_cache_a=NULL;
+  data->xi_cache_splines=NULL;
+}
+
 /* ------- ROUTINE: ccl_data_free --------
 INPUT: ccl_data
 TASK: free the input data
@@ -866,6 +884,8 @@ void ccl_data_free(ccl_data * data)
   gsl_spline_free(data->achi);
   gsl_spline_free(data->logsigma);
   gsl_spline_free(data->dlnsigma_dlogm);
+  gsl_spline2d_free(data->logsigma_2d);
+  gsl_spline2d_free(data->dlnsigma_dlogm_2d);
   ccl_p2d_t_free(data->p_lin);
   ccl_p2d_t_free(data->p_nl);
   gsl_spline_free(data->alphahmf);
@@ -876,9 +896,7 @@ void ccl_data_free(ccl_data * data)
   gsl_interp_accel_free(data->accelerator_d);
   gsl_interp_accel_free(data->accelerator_m);
   gsl_interp_accel_free(data->accelerator_k);
-  ccl_spline_free(data->rsd_splines[0]);
-  ccl_spline_free(data->rsd_splines[1]);
-  ccl_spline_free(data->rsd_splines[2]);
+  xi_cache_free(data);
 }
 
 /* ------- ROUTINE: ccl_cosmology_set_status_message --------
@@ -928,6 +946,64 @@ void ccl_cosmology_free(ccl_cosmology * cosmo)
   free(cosmo);
 }
 
+/* ------- ROUTINE: ccl_cosmology_clear_xi_cache --------
+INPUT: ccl_cosmology struct
+TASK: free the cached multipoles of the 3D correlation function at all scale factors
+*/
+void ccl_cosmology_clear_xi_cache(ccl_cosmology * cosmo)
+{
+  xi_cache_free(&cosmo->data);
+}
+
+/* ------- ROUTINE: ccl_cosmology_thread_copy --------
+INPUT: ccl_cosmology struct
+TASK: create a copy of the cosmology that shares all its splines, but has its
+      own interpolation accelerators, so that copies can be used concurrently
+      once everything they need has been computed
+*/
+ccl_cosmology *ccl_cosmology_thread_copy(ccl_cosmology *cosmo)
+{
+  ccl_cosmology *c = malloc(sizeof(ccl_cosmology));
+  if (c == NULL)
+    return NULL;
+
+  *c = *cosmo;
+  c->data.accelerator = gsl_interp_accel_alloc();
+  c->data.accelerator_achi = gsl_interp_accel_alloc();
+  c->data.accelerator_m = gsl_interp_accel_alloc();
+  c->data.accelerator_d = gsl_interp_accel_alloc();
+  c->data.accelerator_k = gsl_interp_accel_alloc();
+  if ((c->data.accelerator == NULL) || (c->data.accelerator_achi == NULL) ||
+      (c->data.accelerator_m == NULL) || (c->data.accelerator_d == NULL) ||
+      (c->data.accelerator_k == NULL)) {
+    if (c->data.accelerator != NULL) gsl_interp_accel_free(c->data.accelerator);
+    if (c->data.accelerator_achi != NULL) gsl_interp_accel_free(c->data.accelerator_achi);
+    if (c->data.accelerator_m != NULL) gsl_interp_accel_free(c->data.accelerator_m);
+    if (c->data.accelerator_d != NULL) gsl_interp_accel_free(c->data.accelerator_d);
+    if (c->data.accelerator_k != NULL) gsl_interp_accel_free(c->data.accelerator_k);
+    free(c);
+    return NULL;
+  }
+
+  return c;
+}
+
+/* ------- ROUTINE: ccl_cosmology_thread_copy_free --------
+INPUT: ccl_cosmology struct created with ccl_cosmology_thread_copy
+TASK: free the accelerators of the copy and the copy itself, but not the shared splines
+*/
+void ccl_cosmology_thread_copy_free(ccl_cosmology *c)
+{
+  if (c != NULL) {
+    gsl_interp_accel_free(c->data.accelerator);
+    gsl_interp_accel_free(c->data.accelerator_achi);
+    gsl_interp_accel_free(c->data.accelerator_m);
+    gsl_interp_accel_free(c->data.accelerator_d);
+    gsl_interp_accel_free(c->data.accelerator_k);
+    free(c);
+  }
+}
+
 int ccl_get_pk_spline_na(ccl_cosmology *cosmo)
 {
   return cosmo->spline_params.A_SPLINE_NA_PK + cosmo->spline_params.A_SPLINE_NLOG_PK - 1;
@@ -9,6 +9,7 @@
 #include <gsl/gsl_spline.h>
 #include <gsl/gsl_sf_bessel.h>
 #include <gsl/gsl_sf_legendre.h>
+#include <gsl/gsl_cblas.h>
 
 #include "fftlog.h"
 
@@ -40,6 +41,68 @@ static int taper_cl(int n_ell,double *ell,double *cl, double *ell_limits)
   return 0;
 }
 
+//Order of the Bessel function associated with each correlation type (-1 if unknown)
+static int corr_bessel_order(int corr_type)
+{
+  switch(corr_type) {
+  case CCL_CORR_GG :
+    return 0;
+  case CCL_CORR_GL :
+    return 2;
+  case CCL_CORR_LP :
+    return 0;
+  case CCL_CORR_LM :
+    return 4;
+  default :
+    return -1;
+  }
+}
+
+//Interpolates a correlation function computed by FFTLog at the dual angles th_arr (in radians)
+//to the output angles theta (in degrees). If theta_hi is not NULL, the correlation function is
+//instead averaged over the bins [theta[i],theta_hi[i]] with weight theta, by integrating the
+//spline of theta*w(theta) exactly. Returns non-zero if it runs out of memory.
+static int corr_fftlog_output(int n_th,double *th_arr,double *wth_arr,
+			      int n_theta,double *theta,double *theta_hi,double *wtheta)
+{
+  int i;
+  SplPar *wth_spl;
+
+  if(theta_hi==NULL) {
+    wth_spl=ccl_spline_init(n_th,th_arr,wth_arr,wth_arr[0],0);
+    if(wth_spl==NULL)
+      return 1;
+    for(i=0;i<n_theta;i++)
+      wtheta[i]=ccl_spline_eval(theta[i]*M_PI/180.,wth_spl);
+    ccl_spline_free(wth_spl);
+    return 0;
+  }
+
+  double *y_arr=malloc(n_th*sizeof(double));
+  if(y_arr==NULL)
+    return 1;
+  for(i=0;i<n_th;i++)
+    y_arr[i]=th_arr[i]*wth_arr[i];
+  wth_spl=ccl_spline_init(n_th,th_arr,y_arr,0,0);
+  free(y_arr);
+  if(wth_spl==NULL)
+    return 1;
+
+  for(i=0;i<n_theta;i++) {
+    double th_lo=fmax(theta[i]*M_PI/180.,wth_spl->x0);
+    double th_hi=fmin(theta_hi[i]*M_PI/180.,wth_spl->xf);
+    if(th_hi<=th_lo) {
+      wtheta[i]=0;
+      continue;
+    }
+    wtheta[i]=2*gsl_spline_eval_integ(wth_spl->spline,th_lo,th_hi,wth_spl->intacc)/
+      (th_hi*th_hi-th_lo*th_lo);
+  }
+  ccl_spline_free(wth_spl);
+
+  return 0;
+}
+
 /*--------ROUTINE: ccl_tracer_corr_fftlog ------
 TASK: For a given tracer, get the correlation function
       Following function takes a function to calculate angular cl as well.
@@ -48,7 +111,7 @@ INPUT: type of tracer, number of theta values to evaluate = NL, theta vector
  */
 static void ccl_tracer_corr_fftlog(ccl_cosmology *cosmo,
 				   int n_ell,double *ell,double *cls,
-				   int n_theta,double *theta,double *wtheta,
+				   int n_theta,double *theta,double *theta_hi,double *wtheta,
 				   int corr_type,int do_taper_cl,double *taper_cl_limits,
 				   int *status)
 {
@@ -122,27 +185,15 @@ static void ccl_tracer_corr_fftlog(ccl_cosmology *cosmo,
     th_arr[i]=0;
   //Although set here to 0, theta is modified by FFTlog to obtain the correlation at ~1/l
 
-  int i_bessel=0;
-  if(corr_type==CCL_CORR_GG) i_bessel=0;
-  if(corr_type==CCL_CORR_GL) i_bessel=2;
-  if(corr_type==CCL_CORR_LP) i_bessel=0;
-  if(corr_type==CCL_CORR_LM) i_bessel=4;
+  int i_bessel=CCL_MAX(corr_bessel_order(corr_type),0);
   fftlog_ComputeXi2D(i_bessel,cosmo->spline_params.N_ELL_CORR,l_arr,cl_arr,th_arr,wth_arr);
 
-  // Interpolate to output values of theta
-  SplPar *wth_spl=ccl_spline_init(cosmo->spline_params.N_ELL_CORR,th_arr,wth_arr,wth_arr[0],0);
-  if (wth_spl == NULL) {
-    free(l_arr);
-    free(cl_arr);
-    free(th_arr);
-    free(wth_arr);
+  // Interpolate or average to output values of theta
+  if(corr_fftlog_output(cosmo->spline_params.N_ELL_CORR,th_arr,wth_arr,
+			n_theta,theta,theta_hi,wtheta)) {
     *status = CCL_ERROR_MEMORY;
     ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_tracer_corr_fftlog ran out of memory\n");
-    return;
   }
-  for(i=0;i<n_theta;i++)
-    wtheta[i]=ccl_spline_eval(theta[i]*M_PI/180.,wth_spl);
-  ccl_spline_free(wth_spl);
 
   free(l_arr);
   free(cl_arr);
@@ -152,6 +203,9 @@ static void ccl_tracer_corr_fftlog(ccl_cosmology *cosmo,
   return;
 }
 
+#define CCL_CORR_BESSEL_NGL 16 //Gauss-Legendre points per integration interval
+#define CCL_CORR_BESSEL_NLOG 20 //Minimum number of integration intervals per decade in ell
+
 typedef struct {
   int nell;
   double ell0;
@@ -163,48 +217,141 @@ typedef struct {
   double tilt0;
   double tiltf;
   SplPar *cl_spl;
-  int i_bessel;
-  double th;
 } corr_int_par;
 
-static double corr_bessel_integrand(double l,void *params)
+//Evaluates the power spectrum, extrapolating it as a power law beyond the input range.
+//A separate accelerator is used so that this can be called from several threads.
+static double corr_cl_eval(corr_int_par *p,double l,gsl_interp_accel *acc)
 {
-  double cl,jbes;
-  corr_int_par *p=(corr_int_par *)params;
-  double x=l*p->th;
-
   if(l<p->ell0) {
     if(p->extrapol_0)
-      cl=p->cl0*pow(l/p->ell0,p->tilt0);
+      return p->cl0*pow(l/p->ell0,p->tilt0);
     else
-      cl=0;
+      return 0;
   }
   else if(l>p->ellf) {
     if(p->extrapol_f)
-      cl=p->clf*pow(l/p->ellf,p->tiltf);
+      return p->clf*pow(l/p->ellf,p->tiltf);
     else
-      cl=0;
+      return 0;
   }
+  else if(l>=p->cl_spl->xf)
+    return p->cl_spl->yf;
   else
-    cl=ccl_spline_eval(l,p->cl_spl);
+    return gsl_spline_eval(p->cl_spl->spline,l,acc);
+}
+
+//Kernel K(l) of an integral of the form Integral[ l K(l) C_l dl ]
+typedef double (*corr_kernel_func)(double l,void *params);
 
-  jbes=gsl_sf_bessel_Jn(p->i_bessel,x);
+typedef struct {
+  int i_bessel;
+  double th;
+} corr_bessel_kernel_par;
 
-  return l*jbes*cl;
+static double corr_kernel_bessel(double l,void *params)
+{
+  corr_bessel_kernel_par *p=(corr_bessel_kernel_par *)params;
+  return gsl_sf_bessel_Jn(p->i_bessel,l*p->th);
 }
 
-static void ccl_tracer_corr_bessel(ccl_cosmology *cosmo,
-				   int n_ell,double *ell,double *cls,
-				   int n_theta,double *theta,double *wtheta,
-				   int corr_type,int *status)
+//Integral[ t J_n(t) dt , 0<t<x ] for n = 0, 2 or 4.
+//The closed forms cancel catastrophically at small x, where the power series is used instead.
+static double bessel_xjn_integral(int n,double x)
 {
-  corr_int_par *cp=malloc(sizeof(corr_int_par));
-  if(cp==NULL) {
-    *status=CCL_ERROR_MEMORY;
-    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_tracer_corr_bessel ran out of memory\n");
-    return;
+  if(x<4) {
+    int k;
+    double x2=0.25*x*x;
+    double term=x*x*pow(0.5*x,n); //Terms without the 1/(2k+n+2) factor
+    for(k=2;k<=n;k++)
+      term/=k;
+    double sum=term/(n+2);
+    for(k=1;k<30;k++) {
+      term*=-x2/(k*(n+k));
+      sum+=term/(2*k+n+2);
+      if(fabs(term)<1E-17*fabs(sum))
+	break;
+    }
+    return sum;
+  }
+
+  switch(n) {
+  case 0 :
+    return x*gsl_sf_bessel_J1(x);
+  case 2 :
+    return 2-2*gsl_sf_bessel_J0(x)-x*gsl_sf_bessel_J1(x);
+  default :
+    return 4-4*gsl_sf_bessel_J0(x)-12*gsl_sf_bessel_Jn(2,x)+x*gsl_sf_bessel_J1(x);
+  }
+}
+
+typedef struct {
+  int i_bessel;
+  double th_lo;
+  double th_hi;
+} corr_bessel_bin_kernel_par;
+
+//Average of J_n(l*th) over the bin [th_lo,th_hi] with weight th
+static double corr_kernel_bessel_bin(double l,void *params)
+{
+  corr_bessel_bin_kernel_par *p=(corr_bessel_bin_kernel_par *)params;
+  double g_hi=bessel_xjn_integral(p->i_bessel,l*p->th_hi);
+  double g_lo=bessel_xjn_integral(p->i_bessel,l*p->th_lo);
+  return 2*(g_hi-g_lo)/(l*l*(p->th_hi*p->th_hi-p->th_lo*p->th_lo));
+}
+
+//McMahon's asymptotic expansion for the k-th zero of J_n.
+//Only used to split integrals, so its accuracy at low k is not important.
+static double bessel_zero_approx(int n,int k)
+{
+  double beta=(k+0.5*n-0.25)*M_PI;
+  return beta-(4.*n*n-1)/(8*beta);
+}
+
+//Computes Integral[ l K(l) C_l dl , 0<l<l_max ].
+//The range is split at the zeros of J_n(l*th_osc), where th_osc sets the frequency of the
+//oscillations of the kernel, and on a logarithmic grid in l starting at l_min, so that C_l
+//varies smoothly within each interval. Each interval is integrated with a fixed Gauss-Legendre
+//rule with nodes x_gl and weights w_gl in [-1,1].
+static double corr_hankel_integral(corr_int_par *cp,gsl_interp_accel *acc,
+				   corr_kernel_func kernel,void *kpar,int n,double th_osc,
+				   double l_min,double l_max,double *x_gl,double *w_gl)
+{
+  int i,k=1,i_log=0;
+  double result=0,l_lo=0;
+  double z_next=(th_osc>0) ? bessel_zero_approx(n,k)/th_osc : HUGE_VAL;
+  double lg_next=l_min;
+
+  while(l_lo<l_max) {
+    double l_hi=fmin(fmin(z_next,lg_next),l_max);
+    double lm=0.5*(l_hi+l_lo),dl=0.5*(l_hi-l_lo);
+
+    for(i=0;i<CCL_CORR_BESSEL_NGL;i++) {
+      double l=lm+dl*x_gl[i];
+      result+=w_gl[i]*dl*l*kernel(l,kpar)*corr_cl_eval(cp,l,acc);
+    }
+
+    while(z_next<=l_hi) {
+      k++;
+      z_next=bessel_zero_approx(n,k)/th_osc;
+    }
+    while(lg_next<=l_hi) {
+      i_log++;
+      lg_next=l_min*pow(10.,((double)i_log)/CCL_CORR_BESSEL_NLOG);
+    }
+    l_lo=l_hi;
   }
 
+  return result;
+}
+
+//Sets up the power spectrum interpolation and extrapolation used by the Bessel integrals
+static corr_int_par *corr_int_par_new(int n_ell,double *ell,double *cls)
+{
+  corr_int_par *cp=malloc(sizeof(corr_int_par));
+  if(cp==NULL)
+    return NULL;
+
   cp->nell=n_ell;
   cp->ell0=ell[0];
   cp->ellf=ell[n_ell-1];
@@ -213,23 +360,7 @@ static void ccl_tracer_corr_bessel(ccl_cosmology *cosmo,
   cp->cl_spl=ccl_spline_init(n_ell,ell,cls,cls[0],0);
   if(cp->cl_spl==NULL) {
     free(cp);
-    *status=CCL_ERROR_MEMORY;
-    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_tracer_corr_bessel ran out of memory\n");
-    return;
-  }
-  switch(corr_type) {
-  case CCL_CORR_GG :
-    cp->i_bessel=0;
-    break;
-  case CCL_CORR_GL :
-    cp->i_bessel=2;
-    break;
-  case CCL_CORR_LP :
-    cp->i_bessel=0;
-    break;
-  case CCL_CORR_LM :
-    cp->i_bessel=4;
-    break;
+    return NULL;
   }
 
   if(cls[0]*cls[1]<=0)
@@ -246,57 +377,353 @@ static void ccl_tracer_corr_bessel(ccl_cosmology *cosmo,
     cp->tiltf=log10(cls[n_ell-1]/cls[n_ell-2])/log10(ell[n_ell-1]/ell[n_ell-2]);
   }
 
-  int ith, gslstatus;
-  double result,eresult;
-  gsl_function F;
-  gsl_integration_workspace *w=gsl_integration_workspace_alloc(cosmo->gsl_params.N_ITERATION);
-  for(ith=0;ith<n_theta;ith++) {
-    cp->th=theta[ith]*M_PI/180;
-    F.function=&corr_bessel_integrand;
-    F.params=cp;
-    //TODO: Split into intervals between first bessel zeros before integrating
-    //This will help both speed and accuracy of the integral.
-    gslstatus = gsl_integration_qag(&F, 0, cosmo->spline_params.ELL_MAX_CORR, 0,
-                                    cosmo->gsl_params.INTEGRATION_EPSREL, cosmo->gsl_params.N_ITERATION,
-                                    cosmo->gsl_params.INTEGRATION_GAUSS_KRONROD_POINTS,
-                                    w, &result, &eresult);
-    if(gslstatus != GSL_SUCCESS) {
-      ccl_raise_gsl_warning(gslstatus, "ccl_correlation.c: ccl_tracer_corr_bessel():");
-      *status |= gslstatus;
-    }
-    wtheta[ith]=result/(2*M_PI);
-  }
-  gsl_integration_workspace_free(w);
+  return cp;
+}
+
+static void corr_int_par_free(corr_int_par *cp)
+{
   ccl_spline_free(cp->cl_spl);
   free(cp);
 }
 
+//Gauss-Legendre nodes and weights in [-1,1] for the Bessel integrals
+static int corr_gl_nodes(double *x_gl,double *w_gl)
+{
+  int i;
+  gsl_integration_glfixed_table *t=gsl_integration_glfixed_table_alloc(CCL_CORR_BESSEL_NGL);
+  if(t==NULL)
+    return 1;
+  for(i=0;i<CCL_CORR_BESSEL_NGL;i++)
+    gsl_integration_glfixed_point(-1,1,i,&(x_gl[i]),&(w_gl[i]),t);
+  gsl_integration_glfixed_table_free(t);
+  return 0;
+}
 
-/*--------ROUTINE: ccl_compute_legendre_polynomial ------
-TASK: Compute input factor for ccl_tracer_corr_legendre
-INPUT: tracer 1, tracer 2, i_bessel, theta array, n_theta, L_max, output Pl_theta
- */
-static void ccl_compute_legendre_polynomial(int corr_type,double theta,int ell_max,double *Pl_theta)
+static void ccl_tracer_corr_bessel(ccl_cosmology *cosmo,
+				   int n_ell,double *ell,double *cls,
+				   int n_theta,double *theta,double *theta_hi,double *wtheta,
+				   int corr_type,int *status)
+{
+  int i_bessel=corr_bessel_order(corr_type);
+  double x_gl[CCL_CORR_BESSEL_NGL],w_gl[CCL_CORR_BESSEL_NGL];
+  double l_min=cosmo->spline_params.ELL_MIN_CORR;
+  double l_max=cosmo->spline_params.ELL_MAX_CORR;
+  corr_int_par *cp=corr_int_par_new(n_ell,ell,cls);
+  if((cp==NULL) || corr_gl_nodes(x_gl,w_gl)) {
+    if(cp!=NULL)
+      corr_int_par_free(cp);
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_tracer_corr_bessel ran out of memory\n");
+    return;
+  }
+
+  //All angles are independent, so they are computed in parallel,
+  //each thread with its own spline accelerator.
+  #pragma omp parallel default(none) \
+    shared(cp,n_theta,theta,theta_hi,wtheta,i_bessel,x_gl,w_gl,l_min,l_max,status)
+  {
+    int ith;
+    corr_bessel_kernel_par kp;
+    corr_bessel_bin_kernel_par kbp;
+    gsl_interp_accel *acc=gsl_interp_accel_alloc();
+    if(acc==NULL) {
+      #pragma omp atomic write
+      *status=CCL_ERROR_MEMORY;
+    }
+
+    kp.i_bessel=i_bessel;
+    kbp.i_bessel=i_bessel;
+    #pragma omp for
+    for(ith=0;ith<n_theta;ith++) {
+      if(acc==NULL)
+	continue;
+      if(theta_hi==NULL) {
+	kp.th=theta[ith]*M_PI/180;
+	wtheta[ith]=corr_hankel_integral(cp,acc,corr_kernel_bessel,&kp,i_bessel,kp.th,
+					 l_min,l_max,x_gl,w_gl)/(2*M_PI);
+      }
+      else {
+	//The kernel oscillates fastest at the upper edge of the bin
+	kbp.th_lo=theta[ith]*M_PI/180;
+	kbp.th_hi=theta_hi[ith]*M_PI/180;
+	wtheta[ith]=corr_hankel_integral(cp,acc,corr_kernel_bessel_bin,&kbp,i_bessel,kbp.th_hi,
+					 l_min,l_max,x_gl,w_gl)/(2*M_PI);
+      }
+    } //end omp for
+    if(acc!=NULL)
+      gsl_interp_accel_free(acc);
+  } //end omp parallel
+
+  if(*status)
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_tracer_corr_bessel ran out of memory\n");
+  corr_int_par_free(cp);
+}
+
+
+//Legendre polynomials P_l(x) for 0<=l<=ell_max, from the upward recurrence
+//(l+1) P_{l+1} = (2l+1) x P_l - l P_{l-1}
+static void legendre_pl_array(int ell_max,double x,double *pl)
+{
+  int l;
+
+  pl[0]=1;
+  if(ell_max>0)
+    pl[1]=x;
+  for(l=1;l<ell_max;l++)
+    pl[l+1]=((2*l+1)*x*pl[l]-l*pl[l-1])/(l+1);
+}
+
+//Associated Legendre functions P_l^2(x) for 0<=l<=ell_max (zero for l<2), from
+//(l-1) P_{l+1}^2 = (2l+1) x P_l^2 - (l+2) P_{l-1}^2
+static void legendre_pl2_array(int ell_max,double x,double *pl2)
+{
+  int l;
+
+  for(l=0;(l<2) && (l<=ell_max);l++)
+    pl2[l]=0;
+  if(ell_max>=2)
+    pl2[2]=3*(1-x*x);
+  for(l=2;l<ell_max;l++)
+    pl2[l+1]=((2*l+1)*x*pl2[l]-(l+2)*pl2[l-1])/(l-1);
+}
+
+//Averages of P_l(x) over [x_lo,x_hi] for 0<=l<ell_max, using
+//Integral[ P_l dx ] = (P_{l+1}-P_{l-1})/(2l+1).
+//pl_lo and pl_hi hold P_l at the edges for 0<=l<=ell_max.
+static void legendre_pl_bin_array(int ell_max,double x_lo,double x_hi,
+				  double *pl_lo,double *pl_hi,double *pl_bin)
+{
+  int l;
+
+  pl_bin[0]=1;
+  for(l=1;l<ell_max;l++)
+    pl_bin[l]=((pl_hi[l+1]-pl_hi[l-1])-(pl_lo[l+1]-pl_lo[l-1]))/((2*l+1)*(x_hi-x_lo));
+}
+
+//Averages of P_l^2(x) over [x_lo,x_hi] for 0<=l<ell_max, using
+//Integral[ P_l^2 dx ] = (l+2/(2l+1)) P_{l-1} + (2-l) x P_l - 2/(2l+1) P_{l+1}
+//(e.g. Friedrich et al. 2020, arXiv:2012.08568).
+//pl_lo and pl_hi hold P_l at the edges for 0<=l<=ell_max.
+static void legendre_pl2_bin_array(int ell_max,double x_lo,double x_hi,
+				   double *pl_lo,double *pl_hi,double *pl2_bin)
+{
+  int l;
+
+  for(l=0;(l<2) && (l<ell_max);l++)
+    pl2_bin[l]=0;
+  for(l=2;l<ell_max;l++) {
+    double c=2./(2*l+1);
+    double i_hi=(l+c)*pl_hi[l-1]+(2-l)*x_hi*pl_hi[l]-c*pl_hi[l+1];
+    double i_lo=(l+c)*pl_lo[l-1]+(2-l)*x_lo*pl_lo[l]-c*pl_lo[l+1];
+    pl2_bin[l]=(i_hi-i_lo)/(x_hi-x_lo);
+  }
+}
+
+//Weights w[l], 0<=l<ell_max, such that the correlation function of type CCL_CORR_GG or
+//CCL_CORR_GL at theta (or averaged over [theta,theta_hi] if theta_hi>0) is Sum_l C_l w[l].
+//p_a and p_b are scratch arrays of size ell_max+1.
+static void corr_legendre_weights(int corr_type,int ell_max,double theta,double theta_hi,
+				  double *p_a,double *p_b,double *w)
+{
+  int l;
+
+  if(theta_hi<=0) {
+    double x=cos(theta*M_PI/180);
+    if(corr_type==CCL_CORR_GG)
+      legendre_pl_array(ell_max,x,p_a);
+    else
+      legendre_pl2_array(ell_max,x,p_a);
+    memcpy(w,p_a,ell_max*sizeof(double));
+  }
+  else {
+    //Larger angles correspond to smaller x=cos(theta)
+    double x_lo=cos(theta_hi*M_PI/180);
+    double x_hi=cos(theta*M_PI/180);
+    legendre_pl_array(ell_max,x_lo,p_a);
+    legendre_pl_array(ell_max,x_hi,p_b);
+    if(corr_type==CCL_CORR_GG)
+      legendre_pl_bin_array(ell_max,x_lo,x_hi,p_a,p_b,w);
+    else
+      legendre_pl2_bin_array(ell_max,x_lo,x_hi,p_a,p_b,w);
+  }
+
+  //The monopole is not included
+  w[0]=0;
+  for(l=1;l<ell_max;l++) {
+    if(corr_type==CCL_CORR_GG)
+      w[l]*=(2*l+1.)/(4*M_PI);
+    else //https://arxiv.org/pdf/1007.4809.pdf
+      w[l]*=(2*l+1.)/((l+0.)*(l+1.)*4*M_PI);
+  }
+}
+
+void ccl_corr_matrix_free(CCL_CorrMatrix *cm)
+{
+  if(cm==NULL)
+    return;
+  free(cm->w);
+  free(cm);
+}
+
+CCL_CorrMatrix *ccl_corr_matrix_new(int corr_type,int ell_max,int n_theta,
+				    double *theta_lo,double *theta_hi,int *status)
+{
+  int i;
+  double *p_a=NULL,*p_b=NULL;
+  CCL_CorrMatrix *cm=NULL;
+
+  if((corr_type!=CCL_CORR_GG) && (corr_type!=CCL_CORR_GL)) {
+    *status=CCL_ERROR_NOT_IMPLEMENTED;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_new(): "
+		      "only CCL_CORR_GG and CCL_CORR_GL are supported in full-sky\n");
+    return NULL;
+  }
+
+  cm=malloc(sizeof(CCL_CorrMatrix));
+  if(cm!=NULL) {
+    cm->corr_type=corr_type;
+    cm->n_theta=n_theta;
+    cm->n_ell=ell_max;
+    cm->w=malloc(n_theta*ell_max*sizeof(double));
+  }
+  p_a=malloc((ell_max+1)*sizeof(double));
+  p_b=malloc((ell_max+1)*sizeof(double));
+  if((cm==NULL) || (cm->w==NULL) || (p_a==NULL) || (p_b==NULL)) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_new(): memory allocation\n");
+    ccl_corr_matrix_free(cm);
+    free(p_a);
+    free(p_b);
+    return NULL;
+  }
+
+  for(i=0;i<n_theta;i++)
+    corr_legendre_weights(corr_type,ell_max,theta_lo[i],(theta_hi==NULL) ? -1 : theta_hi[i],
+			  p_a,p_b,&(cm->w[i*ell_max]));
+
+  free(p_a);
+  free(p_b);
+  return cm;
+}
+
+void ccl_corr_matrix_apply(CCL_CorrMatrix *cm,int n_cls,double *cls,double *wtheta)
+{
+  //wtheta[j,i] = Sum_l cls[j,l] * w[i,l]
+  cblas_dgemm(CblasRowMajor,CblasNoTrans,CblasTrans,n_cls,cm->n_theta,cm->n_ell,
+	      1.,cls,cm->n_ell,cm->w,cm->n_ell,0.,wtheta,cm->n_theta);
+}
+
+CCL_CorrMatrix *ccl_corr_matrix_bessel_new(int corr_type,int n_ell,double *ell,double *delta_ell,
+					   int n_theta,double *theta_lo,double *theta_hi,
+					   int *status)
 {
-  int i,j;
-  double k=0;
-  double cth=cos(theta*M_PI/180);
+  int i_bessel=corr_bessel_order(corr_type);
+  CCL_CorrMatrix *cm=NULL;
 
-  //Initialize Pl_theta
-  for (j=0;j<=ell_max;j++)
-      Pl_theta[j]=0.;
+  if(i_bessel<0) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_bessel_new(): "
+		      "unknown correlation type\n");
+    return NULL;
+  }
 
-  if(corr_type==CCL_CORR_GG) {
-    gsl_sf_legendre_Pl_array(ell_max,cth,Pl_theta);
-    for (j=0;j<=ell_max;j++)
-      Pl_theta[j]*=(2*j+1);
+  cm=malloc(sizeof(CCL_CorrMatrix));
+  if(cm!=NULL) {
+    cm->corr_type=corr_type;
+    cm->n_theta=n_theta;
+    cm->n_ell=n_ell;
+    cm->w=malloc(n_theta*n_ell*sizeof(double));
+  }
+  if((cm==NULL) || (cm->w==NULL)) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_bessel_new(): memory allocation\n");
+    ccl_corr_matrix_free(cm);
+    return NULL;
   }
-  else if(corr_type==CCL_CORR_GL) {
-    for (j=2;j<=ell_max;j++) {//https://arxiv.org/pdf/1007.4809.pdf
-      Pl_theta[j]=gsl_sf_legendre_Plm(j,2,cth);
-      Pl_theta[j]*=(2*j+1.)/((j+0.)*(j+1.));
+
+  //Integral[ l dl J_n(l*theta) C_l ]/(2 pi), discretized at the input multipoles
+  #pragma omp parallel for default(none) \
+    shared(cm,i_bessel,n_ell,ell,delta_ell,n_theta,theta_lo,theta_hi)
+  for(int i=0;i<n_theta;i++) {
+    corr_bessel_kernel_par kp;
+    corr_bessel_bin_kernel_par kbp;
+    double *w=&(cm->w[i*n_ell]);
+
+    kp.i_bessel=i_bessel;
+    kp.th=theta_lo[i]*M_PI/180;
+    kbp.i_bessel=i_bessel;
+    kbp.th_lo=theta_lo[i]*M_PI/180;
+    kbp.th_hi=(theta_hi==NULL) ? 0 : theta_hi[i]*M_PI/180;
+    for(int b=0;b<n_ell;b++) {
+      double l=(ell==NULL) ? b : ell[b];
+      double dl=(delta_ell==NULL) ? 1 : delta_ell[b];
+      if(l<=0)
+	w[b]=0;
+      else if(theta_hi==NULL)
+	w[b]=dl*l*corr_kernel_bessel(l,&kp)/(2*M_PI);
+      else
+	w[b]=dl*l*corr_kernel_bessel_bin(l,&kbp)/(2*M_PI);
     }
+  } //end omp parallel for
+
+  return cm;
+}
+
+void ccl_corr_matrix_project_cov(CCL_CorrMatrix *cm1,CCL_CorrMatrix *cm2,
+				 double *cov_cl,double *cov_xi,int *status)
+{
+  //tmp = cov_cl * w2^T, then cov_xi = w1 * tmp
+  double *tmp;
+  if(cm1->n_ell!=cm2->n_ell) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_project_cov(): "
+		      "the two matrices must have the same number of multipoles\n");
+    return;
+  }
+
+  tmp=malloc(cm1->n_ell*cm2->n_theta*sizeof(double));
+  if(tmp==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_project_cov(): memory allocation\n");
+    return;
+  }
+
+  cblas_dgemm(CblasRowMajor,CblasNoTrans,CblasTrans,cm1->n_ell,cm2->n_theta,cm2->n_ell,
+	      1.,cov_cl,cm2->n_ell,cm2->w,cm2->n_ell,0.,tmp,cm2->n_theta);
+  cblas_dgemm(CblasRowMajor,CblasNoTrans,CblasNoTrans,cm1->n_theta,cm2->n_theta,cm1->n_ell,
+	      1.,cm1->w,cm1->n_ell,tmp,cm2->n_theta,0.,cov_xi,cm2->n_theta);
+
+  free(tmp);
+}
+
+void ccl_corr_matrix_project_cov_diag(CCL_CorrMatrix *cm1,CCL_CorrMatrix *cm2,
+				      double *var_cl,double *cov_xi,int *status)
+{
+  //cov_xi = (w1 * diag(var_cl)) * w2^T
+  int i,l;
+  double *w1v;
+  if(cm1->n_ell!=cm2->n_ell) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_project_cov_diag(): "
+		      "the two matrices must have the same number of multipoles\n");
+    return;
+  }
+
+  w1v=malloc(cm1->n_theta*cm1->n_ell*sizeof(double));
+  if(w1v==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_raise_warning(*status,"ccl_correlation.c: ccl_corr_matrix_project_cov_diag(): memory allocation\n");
+    return;
+  }
+
+  for(i=0;i<cm1->n_theta;i++) {
+    for(l=0;l<cm1->n_ell;l++)
+      w1v[i*cm1->n_ell+l]=cm1->w[i*cm1->n_ell+l]*var_cl[l];
   }
+  cblas_dgemm(CblasRowMajor,CblasNoTrans,CblasTrans,cm1->n_theta,cm2->n_theta,cm1->n_ell,
+	      1.,w1v,cm1->n_ell,cm2->w,cm2->n_ell,0.,cov_xi,cm2->n_theta);
+
+  free(w1v);
 }
 
 /*--------ROUTINE: ccl_tracer_corr_legendre ------
@@ -306,12 +733,13 @@ INPUT: cosmology, number of theta bins, theta array, tracer 1, tracer 2, i_besse
  */
 static void ccl_tracer_corr_legendre(ccl_cosmology *cosmo,
 				     int n_ell,double *ell,double *cls,
-				     int n_theta,double *theta,double *wtheta,
+				     int n_theta,double *theta,double *theta_hi,double *wtheta,
 				     int corr_type,int do_taper_cl,double *taper_cl_limits,
 				     int *status)
 {
   int i;
-  double *l_arr = NULL, *cl_arr = NULL, *Pl_theta = NULL;
+  double *l_arr = NULL, *cl_arr = NULL;
+  double *w = NULL;
   SplPar *cl_spl;
 
   if(corr_type==CCL_CORR_LM || corr_type==CCL_CORR_LP){
@@ -369,29 +797,60 @@ static void ccl_tracer_corr_legendre(ccl_cosmology *cosmo,
       *status=taper_cl((int)(cosmo->spline_params.ELL_MAX_CORR)+1,l_arr,cl_arr,taper_cl_limits);
   }
 
+  //The weights are only used once, so they are computed one angle at a time rather than
+  //stored in a CCL_CorrMatrix (see ccl_corr_matrix_new for repeated use)
   if(*status==0) {
-    Pl_theta=malloc(sizeof(double)*((int)(cosmo->spline_params.ELL_MAX_CORR)+1));
-    if(Pl_theta==NULL) {
+    int l,ell_max=(int)(cosmo->spline_params.ELL_MAX_CORR);
+    w=malloc(3*(ell_max+1)*sizeof(double));
+    if(w==NULL) {
       *status=CCL_ERROR_MEMORY;
       ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_tracer_corr_legendre ran out of memory\n");
     }
-  }
-
-  if(*status==0) {
-    for (int i=0;i<n_theta;i++) {
-      wtheta[i]=0;
-      ccl_compute_legendre_polynomial(corr_type,theta[i],(int)(cosmo->spline_params.ELL_MAX_CORR),Pl_theta);
-      for(int i_L=1;i_L<(int)(cosmo->spline_params.ELL_MAX_CORR);i_L+=1)
-	wtheta[i]+=cl_arr[i_L]*Pl_theta[i_L];
-      wtheta[i]/=(M_PI*4);
+    else {
+      double *p_a=&(w[ell_max+1]),*p_b=&(w[2*(ell_max+1)]);
+      for(i=0;i<n_theta;i++) {
+	corr_legendre_weights(corr_type,ell_max,theta[i],(theta_hi==NULL) ? -1 : theta_hi[i],
+			      p_a,p_b,w);
+	wtheta[i]=0;
+	for(l=0;l<ell_max;l++)
+	  wtheta[i]+=cl_arr[l]*w[l];
+      }
     }
   }
 
-  free(Pl_theta);
+  free(w);
   free(l_arr);
   free(cl_arr);
 }
 
+//Computes the correlation function at the angles theta, or averaged over the bins
+//[theta[i],theta_hi[i]] if theta_hi is not NULL, with the chosen method.
+static void ccl_correlation_any(ccl_cosmology *cosmo,
+				int n_ell,double *ell,double *cls,
+				int n_theta,double *theta,double *theta_hi,double *wtheta,
+				int corr_type,int do_taper_cl,double *taper_cl_limits,int flag_method,
+				int *status)
+{
+  switch(flag_method) {
+  case CCL_CORR_FFTLOG :
+    ccl_tracer_corr_fftlog(cosmo,n_ell,ell,cls,n_theta,theta,theta_hi,wtheta,corr_type,
+			   do_taper_cl,taper_cl_limits,status);
+    break;
+  case CCL_CORR_LGNDRE :
+    ccl_tracer_corr_legendre(cosmo,n_ell,ell,cls,n_theta,theta,theta_hi,wtheta,corr_type,
+			     do_taper_cl,taper_cl_limits,status);
+    break;
+  case CCL_CORR_BESSEL :
+    ccl_tracer_corr_bessel(cosmo,n_ell,ell,cls,n_theta,theta,theta_hi,wtheta,corr_type,status);
+    break;
+  default :
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_correlation. Unknown algorithm\n");
+  }
+
+  ccl_check_status(cosmo,status);
+}
+
 /*--------ROUTINE: ccl_tracer_corr ------
 TASK: For a given tracer, get the correlation function. Do so by running
       ccl_angular_cls. If you already have Cls calculated, go to the next
@@ -406,28 +865,266 @@ void ccl_correlation(ccl_cosmology *cosmo,
 		     int corr_type,int do_taper_cl,double *taper_cl_limits,int flag_method,
 		     int *status)
 {
-  switch(flag_method) {
-  case CCL_CORR_FFTLOG :
-    ccl_tracer_corr_fftlog(cosmo,n_ell,ell,cls,n_theta,theta,wtheta,corr_type,
-			   do_taper_cl,taper_cl_limits,status);
-    break;
-  case CCL_CORR_LGNDRE :
-    ccl_tracer_corr_legendre(cosmo,n_ell,ell,cls,n_theta,theta,wtheta,corr_type,
-			     do_taper_cl,taper_cl_limits,status);
-    break;
-  case CCL_CORR_BESSEL :
-    ccl_tracer_corr_bessel(cosmo,n_ell,ell,cls,n_theta,theta,wtheta,corr_type,status);
-    break;
-  default :
-    *status=CCL_ERROR_INCONSISTENT;
-    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_correlation. Unknown algorithm\n");
+  ccl_correlation_any(cosmo,n_ell,ell,cls,n_theta,theta,NULL,wtheta,corr_type,
+		      do_taper_cl,taper_cl_limits,flag_method,status);
+}
+
+/*--------ROUTINE: ccl_correlation_binned ------
+TASK: Same as ccl_correlation, but averaging the correlation function over
+      angular bins instead of evaluating it at single angles.
+INPUT: as ccl_correlation, with the lower and upper edges of each bin
+       instead of the angles.
+ */
+void ccl_correlation_binned(ccl_cosmology *cosmo,
+			    int n_ell,double *ell,double *cls,
+			    int n_bins,double *theta_lo,double *theta_hi,double *wtheta,
+			    int corr_type,int do_taper_cl,double *taper_cl_limits,int flag_method,
+			    int *status)
+{
+  ccl_correlation_any(cosmo,n_ell,ell,cls,n_bins,theta_lo,theta_hi,wtheta,corr_type,
+		      do_taper_cl,taper_cl_limits,flag_method,status);
+}
+
+/*--------ROUTINE: ccl_correlation_tracers ------
+TASK: Compute the correlation functions of two tracers for several correlation
+      types at once. The Limber power spectrum is evaluated directly at the
+      log-spaced multipoles used by FFTLog, and transformed for all Bessel
+      orders with a single batched FFTLog call.
+INPUT: cosmology, tracer 1, tracer 2, 3D power spectrum, number of theta values,
+       theta vector, number of correlation types, correlation types, key for
+       tapering, limits of tapering.
+Correlation function for the ic-th type at theta[ith] will be in wtheta[ic*n_theta+ith]
+ */
+void ccl_correlation_tracers(ccl_cosmology *cosmo,
+			     CCL_ClTracer *clt1,CCL_ClTracer *clt2,ccl_p2d_t *psp,
+			     int n_theta,double *theta,
+			     int n_corr,int *corr_type,double *wtheta,
+			     int do_taper_cl,double *taper_cl_limits,
+			     int *status)
+{
+  int i,ic,n_ell=cosmo->spline_params.N_ELL_CORR;
+  double *l_arr=NULL,*cl_arr=NULL,*th_arr=NULL,*wth_arr=NULL,*orders=NULL;
+
+  l_arr=ccl_log_spacing(cosmo->spline_params.ELL_MIN_CORR,cosmo->spline_params.ELL_MAX_CORR,n_ell);
+  cl_arr=malloc(n_ell*sizeof(double));
+  th_arr=malloc(n_corr*n_ell*sizeof(double));
+  wth_arr=malloc(n_corr*n_ell*sizeof(double));
+  orders=malloc(n_corr*sizeof(double));
+  if((l_arr==NULL) || (cl_arr==NULL) || (th_arr==NULL) || (wth_arr==NULL) || (orders==NULL)) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_correlation_tracers ran out of memory\n");
+  }
+
+  if(*status==0) {
+    for(ic=0;ic<n_corr;ic++) {
+      orders[ic]=corr_bessel_order(corr_type[ic]);
+      if(orders[ic]<0) {
+	*status=CCL_ERROR_INCONSISTENT;
+	ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_correlation_tracers. Unknown correlation type\n");
+      }
+    }
+  }
+
+  //Limber power spectrum at the FFTLog multipoles
+  if(*status==0)
+    ccl_angular_cls_limber(cosmo,NULL,clt1,clt2,psp,n_ell,l_arr,cl_arr,status);
+
+  if(*status==0) {
+    if(do_taper_cl)
+      taper_cl(n_ell,l_arr,cl_arr,taper_cl_limits);
+    fftlog_ComputeXi2D_many(n_corr,orders,1,n_ell,l_arr,cl_arr,th_arr,wth_arr);
   }
 
+  // Interpolate to output values of theta
+  for(ic=0;ic<n_corr;ic++) {
+    if(*status)
+      break;
+    if(corr_fftlog_output(n_ell,&(th_arr[ic*n_ell]),&(wth_arr[ic*n_ell]),
+			  n_theta,theta,NULL,&(wtheta[ic*n_theta]))) {
+      *status=CCL_ERROR_MEMORY;
+      ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_correlation_tracers ran out of memory\n");
+    }
+  }
+
+  free(l_arr);
+  free(cl_arr);
+  free(th_arr);
+  free(wth_arr);
+  free(orders);
   ccl_check_status(cosmo,status);
 }
 
+// Relative tolerance within which two scale factors share a cache entry, so that
+// values differing only by rounding don't add new entries
+#define CCL_XI_CACHE_RTOL 1E-10
+
+static int xi_cache_same_a(double a1, double a2) {
+  return fabs(a1 - a2) <= CCL_XI_CACHE_RTOL * a2;
+}
+
+/*--------ROUTINE: xi_cache_find ------
+TASK: Find the entry of the correlation multipole cache for scale factor a.
+      Returns -1 if a is not in the cache.
+ */
+
+static int xi_cache_find(ccl_cosmology *cosmo, double a) {
+  int i;
+
+  for (i = 0; i < cosmo->data.n_xi_cache; i++) {
+    if (xi_cache_same_a(cosmo->data.xi_cache_a[i], a))
+      return i;
+  }
+
+  return -1;
+}
+
+/*--------ROUTINE: xi_cache_fill ------
+TASK: Add the multipoles xi_l^2(r) (l = 0, 2, 4) of the correlation function
+      at all scale factors in a[] that are not in the cache yet. The power
+      spectra of all new scale factors are transformed together with a single
+      batched FFTLog call per multipole.
+
+INPUT:  cosmology, number of scale factors, scale factors
+ */
+
+static void xi_cache_fill(ccl_cosmology *cosmo, int n_a, double *a,
+                          int *status) {
+  int i, j, il, ia, n_new, n_old, N_ARR;
+  double *a_new, *k_arr, *pk_arr, *r_arr, *xi_arr;
+
+  a_new = malloc(sizeof(double) * n_a);
+  if (a_new == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: xi_cache_fill ran out of memory\n");
+    return;
+  }
+
+  // Collect the scale factors that still need to be computed
+  n_new = 0;
+  for (i = 0; i < n_a; i++) {
+    int is_new = (xi_cache_find(cosmo, a[i]) < 0);
+    for (j = 0; j < n_new; j++) {
+      if (xi_cache_same_a(a_new[j], a[i]))
+        is_new = 0;
+    }
+    if (is_new) {
+      a_new[n_new] = a[i];
+      n_new++;
+    }
+  }
+  if (n_new == 0) {
+    free(a_new);
+    return;
+  }
+
+  // Make room for the new entries
+  n_old = cosmo->data.n_xi_cache;
+  if (n_old + n_new > cosmo->data.n_xi_cache_alloc) {
+    int n_alloc = 2 * (n_old + n_new);
+    double *a_c = realloc(cosmo->data.xi_cache_a, sizeof(double) * n_alloc);
+    if (a_c != NULL)
+      cosmo->data.xi_cache_a = a_c;
+    SplPar **spl_c = realloc(cosmo->data.xi_cache_splines,
+                             sizeof(SplPar *) * CCL_XI_CACHE_NL * n_alloc);
+    if (spl_c != NULL)
+      cosmo->data.xi_cache_splines = spl_c;
+    if ((a_c == NULL) || (spl_c == NULL)) {
+      free(a_new);
+      *status = CCL_ERROR_MEMORY;
+      ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: xi_cache_fill ran out of memory\n");
+      return;
+    }
+    cosmo->data.n_xi_cache_alloc = n_alloc;
+  }
+  for (i = CCL_XI_CACHE_NL * n_old; i < CCL_XI_CACHE_NL * (n_old + n_new); i++)
+    cosmo->data.xi_cache_splines[i] = NULL;
+
+  N_ARR = (int)(cosmo->spline_params.N_K_3DCOR * log10(cosmo->spline_params.K_MAX / cosmo->spline_params.K_MIN));
+
+  k_arr = ccl_log_spacing(cosmo->spline_params.K_MIN, cosmo->spline_params.K_MAX, N_ARR);
+  pk_arr = malloc(sizeof(double) * N_ARR * n_new);
+  r_arr = malloc(sizeof(double) * N_ARR);
+  xi_arr = malloc(sizeof(double) * N_ARR * n_new);
+  if ((k_arr == NULL) || (pk_arr == NULL) || (r_arr == NULL) || (xi_arr == NULL)) {
+    free(a_new);
+    free(k_arr);
+    free(pk_arr);
+    free(r_arr);
+    free(xi_arr);
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: xi_cache_fill ran out of memory\n");
+    return;
+  }
+
+  ccl_nonlin_matter_power_array(cosmo, n_new, a_new, N_ARR, k_arr, pk_arr, status);
+
+  // Calculate multipoles
+  for (il = 0; (il < CCL_XI_CACHE_NL) && (*status == 0); il++) {
+    for (i = 0; i < N_ARR; i++) r_arr[i] = 0;
+
+    fftlog_ComputeXiLM_many(2 * il, 2, n_new, N_ARR, k_arr, pk_arr, r_arr, xi_arr);
+
+    for (ia = 0; ia < n_new; ia++) {
+      double *xi_a = &(xi_arr[ia * N_ARR]);
+      SplPar *spl = ccl_spline_init(N_ARR, r_arr, xi_a, xi_a[0], 0);
+      if (spl == NULL) {
+        *status = CCL_ERROR_MEMORY;
+        ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: xi_cache_fill ran out of memory\n");
+        break;
+      }
+      cosmo->data.xi_cache_splines[CCL_XI_CACHE_NL * (n_old + ia) + il] = spl;
+    }
+  }
+
+  if (*status == 0) {
+    for (ia = 0; ia < n_new; ia++)
+      cosmo->data.xi_cache_a[n_old + ia] = a_new[ia];
+    cosmo->data.n_xi_cache = n_old + n_new;
+  } else {
+    for (i = CCL_XI_CACHE_NL * n_old; i < CCL_XI_CACHE_NL * (n_old + n_new); i++) {
+      ccl_spline_free(cosmo->data.xi_cache_splines[i]);
+      cosmo->data.xi_cache_splines[i] = NULL;
+    }
+  }
+
+  free(a_new);
+  free(k_arr);
+  free(pk_arr);
+  free(r_arr);
+  free(xi_arr);
+}
+
+/*--------ROUTINE: xi_cache_get ------
+TASK: Return the cached spline of xi_l^2(r) at scale factor a, computing it
+      first if needed. Returns NULL on error.
+
+INPUT:  cosmology, scale factor a, multipole order l = 0, 2, or 4
+ */
+
+static SplPar *xi_cache_get(ccl_cosmology *cosmo, double a, int l, int *status) {
+  int i;
+
+  if ((l != 0) && (l != 2) && (l != 4)) {
+    *status = CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: unavailable value of l\n");
+    return NULL;
+  }
+
+  i = xi_cache_find(cosmo, a);
+  if (i < 0) {
+    xi_cache_fill(cosmo, 1, &a, status);
+    if (*status)
+      return NULL;
+    i = xi_cache_find(cosmo, a);
+  }
+
+  return cosmo->data.xi_cache_splines[CCL_XI_CACHE_NL * i + l / 2];
+}
+
 /*--------ROUTINE: ccl_correlation_3d ------
 TASK: Calculate the 3d-correlation function. Do so by using FFTLog.
+      Without tapering, the result is taken from the cache of multipoles,
+      which is filled at a if needed (see ccl_cosmology_clear_xi_cache).
 
 INPUT: cosmology, scale factor a,
        number of r values, r values,
@@ -444,6 +1141,16 @@ void ccl_correlation_3d(ccl_cosmology *cosmo, double a,
   int i,N_ARR;
   double *k_arr,*pk_arr,*r_arr,*xi_arr;
 
+  if(!do_taper_pk) {
+    SplPar *spl=xi_cache_get(cosmo,a,0,status);
+    if(spl!=NULL) {
+      for(i=0;i<n_r;i++)
+	xi[i]=ccl_spline_eval(r[i],spl);
+    }
+    ccl_check_status(cosmo,status);
+    return;
+  }
+
   //number of data points for k and pk array
   N_ARR=(int)(cosmo->spline_params.N_K_3DCOR*log10(cosmo->spline_params.K_MAX/cosmo->spline_params.K_MIN));
 
@@ -516,8 +1223,25 @@ void ccl_correlation_3d(ccl_cosmology *cosmo, double a,
   return;
 }
 
+/*--------ROUTINE: kaiser_factor ------
+TASK: Ratio between the multipole P_l(k) of the redshift-space power spectrum
+      and the real-space power spectrum P(k) in the Kaiser approximation.
+
+INPUT:  multipole order l = 0, 2, or 4, beta (= growth rate / bias)
+ */
+
+static double kaiser_factor(int l, double beta) {
+  if (l == 0)
+    return 1. + 2. / 3 * beta + 1. / 5 * beta * beta;
+  else if (l == 2)
+    return 4. / 3 * beta + 4. / 7 * beta * beta;
+  else
+    return 8. / 35 * beta * beta;
+}
+
 /*--------ROUTINE: ccl_correlation_multipole ------
 TASK: Calculate multipole of the redshift space correlation function. Do so using FFTLog.
+      The multipoles are cached for each scale factor.
 
 INPUT:  cosmology, scale factor a, beta (= growth rate / bias),
         multipole order l = 0, 2, or 4, number of s values, s values
@@ -528,287 +1252,150 @@ Multipole function result will be in array xi
 void ccl_correlation_multipole(ccl_cosmology *cosmo, double a, double beta,
                                int l, int n_s, double *s, double *xi,
                                int *status) {
-  int i, N_ARR;
-  double *k_arr, *pk_arr, *s_arr, *xi_arr, *xi_arr0;
-
-  N_ARR = (int)(cosmo->spline_params.N_K_3DCOR * log10(cosmo->spline_params.K_MAX / cosmo->spline_params.K_MIN));
+  int i;
+  double fac;
+  SplPar *spl;
 
-  k_arr = ccl_log_spacing(cosmo->spline_params.K_MIN, cosmo->spline_params.K_MAX, N_ARR);
-  if (k_arr == NULL) {
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole ran out of memory\n");
+  spl = xi_cache_get(cosmo, a, l, status);
+  if (spl == NULL) {
+    ccl_check_status(cosmo, status);
     return;
   }
 
-  pk_arr = malloc(N_ARR * sizeof(double));
-  if (pk_arr == NULL) {
-    free(k_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole ran out of memory\n");
-    return;
-  }
+  // The factor i^l of the Hankel transform flips the sign of the quadrupole
+  fac = kaiser_factor(l, beta);
+  if (l == 2)
+    fac = -fac;
 
-  for (i = 0; i < N_ARR; i++)
-    pk_arr[i] = ccl_nonlin_matter_power(cosmo, k_arr[i], a, status);
+  for (i = 0; i < n_s; i++) xi[i] = fac * ccl_spline_eval(s[i], spl);
 
-  s_arr = malloc(sizeof(double) * N_ARR);
-  if (s_arr == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole ran out of memory\n");
-    return;
-  }
-  xi_arr = malloc(sizeof(double) * N_ARR);
-  if (xi_arr == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole ran out of memory\n");
-    return;
-  }
-  xi_arr0 = malloc(sizeof(double) * N_ARR);
-  if (xi_arr0 == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole ran out of memory\n");
-    return;
-  }
+  ccl_check_status(cosmo, status);
 
-  for (i = 0; i < N_ARR; i++) s_arr[i] = 0;
+  return;
+}
 
-  // Calculate multipoles
+/*--------ROUTINE: ccl_correlation_multipole_spline ------
+TASK: Store multipoles of the redshift-space correlation in the cache of
+      multipoles, if they are not there yet.
 
-  if (l == 0) {
-    fftlog_ComputeXiLM(0, 2, N_ARR, k_arr, pk_arr, s_arr, xi_arr0);
-    for (i = 0; i < N_ARR; i++)
-      xi_arr[i] = (1. + 2. / 3 * beta + 1. / 5 * beta * beta) * xi_arr0[i];
-  } else if (l == 2) {
-    fftlog_ComputeXiLM(2, 2, N_ARR, k_arr, pk_arr, s_arr, xi_arr0);
-    for (i = 0; i < N_ARR; i++)
-      xi_arr[i] = -(4. / 3 * beta + 4. / 7 * beta * beta) * xi_arr0[i];
-  } else if (l == 4) {
-    fftlog_ComputeXiLM(4, 2, N_ARR, k_arr, pk_arr, s_arr, xi_arr0);
-    for (i = 0; i < N_ARR; i++) xi_arr[i] = 8. / 35 * beta * beta * xi_arr0[i];
-  } else {
-    strcpy(cosmo->status_message, "unavailable value of l\n");
-    return;
-  }
+INPUT:  cosmology, scale factor a
+ */
 
-  // Interpolate to output values of s
-  SplPar *xi_spl = ccl_spline_init(N_ARR, s_arr, xi_arr, xi_arr[0], 0);
-  if (xi_spl == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    free(xi_arr0);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole ran out of memory\n");
-  }
-  for (i = 0; i < n_s; i++) xi[i] = ccl_spline_eval(s[i], xi_spl);
-  ccl_spline_free(xi_spl);
+void ccl_correlation_multipole_spline(ccl_cosmology *cosmo, double a,
+                                      int *status) {
+  xi_cache_fill(cosmo, 1, &a, status);
 
-  free(k_arr);
-  free(pk_arr);
-  free(s_arr);
-  free(xi_arr);
-  free(xi_arr0);
+  ccl_check_status(cosmo, status);
+
+  return;
+}
+
+/*--------ROUTINE: ccl_correlation_multipole_cache ------
+TASK: Store multipoles of the redshift-space correlation in the cache of
+      multipoles for a list of scale factors. All missing scale factors are
+      computed in a single batched pass.
+
+INPUT:  cosmology, number of scale factors, scale factors
+ */
+
+void ccl_correlation_multipole_cache(ccl_cosmology *cosmo, int n_a, double *a,
+                                     int *status) {
+  xi_cache_fill(cosmo, n_a, a, status);
 
   ccl_check_status(cosmo, status);
 
   return;
 }
 
-/*--------ROUTINE: ccl_correlation_multipole_spline ------
-TASK: Store multipoles of the redshift-space correlation in global splines
+/*--------ROUTINE: ccl_correlation_multipole_table ------
+TASK: Tabulate the multipole xi_l^2(r) of the correlation function (without
+      any redshift-space distortion factors) on a grid of r and a.
+      l = 0 gives the real-space correlation function.
 
-INPUT:  cosmology, scale factor a
+INPUT:  cosmology, multipole order l = 0, 2, or 4,
+        number of scale factors, scale factors, number of r values, r values
 
-Result is stored in cosmo->data.rsd_splines[]
+Result will be in array xi, with xi[ia*n_r+ir] corresponding to a[ia] and r[ir]
  */
 
-void ccl_correlation_multipole_spline(ccl_cosmology *cosmo, double a,
-                                      int *status) {
-  int i, N_ARR;
-  double *k_arr, *pk_arr, *s_arr, *xi_arr, *xi_arr0, *xi_arr2, *xi_arr4;
-
-  N_ARR = (int)(cosmo->spline_params.N_K_3DCOR * log10(cosmo->spline_params.K_MAX / cosmo->spline_params.K_MIN));
+void ccl_correlation_multipole_table(ccl_cosmology *cosmo, int l,
+                                     int n_a, double *a, int n_r, double *r,
+                                     double *xi, int *status) {
+  int ia, ir;
 
-  k_arr = ccl_log_spacing(cosmo->spline_params.K_MIN, cosmo->spline_params.K_MAX, N_ARR);
-  if (k_arr == NULL) {
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
+  xi_cache_fill(cosmo, n_a, a, status);
 
-  pk_arr = malloc(N_ARR * sizeof(double));
-  if (pk_arr == NULL) {
-    free(k_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
+  for (ia = 0; (ia < n_a) && (*status == 0); ia++) {
+    SplPar *spl = xi_cache_get(cosmo, a[ia], l, status);
+    if (spl == NULL)
+      break;
+    for (ir = 0; ir < n_r; ir++)
+      xi[ia * n_r + ir] = ccl_spline_eval(r[ir], spl);
   }
 
-  for (i = 0; i < N_ARR; i++)
-    pk_arr[i] = ccl_nonlin_matter_power(cosmo, k_arr[i], a, status);
+  ccl_check_status(cosmo, status);
 
-  s_arr = malloc(sizeof(double) * N_ARR);
-  if (s_arr == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
-  xi_arr = malloc(sizeof(double) * N_ARR);
-  if (xi_arr == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
-  xi_arr0 = malloc(sizeof(double) * N_ARR);
-  if (xi_arr0 == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
-  xi_arr2 = malloc(sizeof(double) * N_ARR);
-  if (xi_arr2 == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    free(xi_arr0);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
-  xi_arr4 = malloc(sizeof(double) * N_ARR);
-  if (xi_arr4 == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    free(xi_arr0);
-    free(xi_arr2);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
+  return;
+}
 
-  for (i = 0; i < N_ARR; i++) s_arr[i] = 0;
+/*--------ROUTINE: ccl_rsd_multipoles ------
+TASK: Calculate the multipoles l = 0, 2, 4 of the redshift-space power
+      spectrum in the Kaiser approximation, P_l(k,a) = K_l(beta) P(k,a), for
+      a set of scale factors, and optionally the corresponding multipoles of
+      the correlation function, transformed from the same sampling of P(k,a).
 
-  // Calculate multipoles
+INPUT:  cosmology, number of scale factors, scale factors,
+        beta (= growth rate / bias) for each scale factor,
+        number of k values, k values, number of r values, r values
 
-  fftlog_ComputeXiLM(0, 2, N_ARR, k_arr, pk_arr, s_arr, xi_arr0);
-  fftlog_ComputeXiLM(2, 2, N_ARR, k_arr, pk_arr, s_arr, xi_arr2);
-  fftlog_ComputeXiLM(4, 2, N_ARR, k_arr, pk_arr, s_arr, xi_arr4);
-
-  // free any memory that may have been allocated
-  ccl_spline_free(cosmo->data.rsd_splines[0]);
-  ccl_spline_free(cosmo->data.rsd_splines[1]);
-  ccl_spline_free(cosmo->data.rsd_splines[2]);
-  cosmo->data.rsd_splines[0] = NULL;
-  cosmo->data.rsd_splines[1] = NULL;
-  cosmo->data.rsd_splines[1] = NULL;
-
-  // Interpolate to output values of s
-  cosmo->data.rsd_splines[0] = ccl_spline_init(N_ARR, s_arr, xi_arr0, xi_arr0[0], 0);
-  if (cosmo->data.rsd_splines[0] == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    free(xi_arr0);
-    free(xi_arr2);
-    free(xi_arr4);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
+Results will be in array pk_ell, with pk_ell[(ia*3+il)*n_k+ik] the
+multipole l = 2*il at a[ia] and k[ik], and in array xi_ell (if not NULL),
+with xi_ell[(ia*3+il)*n_r+ir] the multipole l = 2*il at a[ia] and r[ir].
+ */
 
-  cosmo->data.rsd_splines[1] = ccl_spline_init(N_ARR, s_arr, xi_arr2, xi_arr2[0], 0);
-  if (cosmo->data.rsd_splines[1] == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    free(xi_arr0);
-    free(xi_arr2);
-    free(xi_arr4);
-    ccl_spline_free(cosmo->data.rsd_splines[0]);
-    cosmo->data.rsd_splines[0] = NULL;
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
-    return;
-  }
+void ccl_rsd_multipoles(ccl_cosmology *cosmo, int n_a, double *a, double *beta,
+                        int n_k, double *k, double *pk_ell,
+                        int n_r, double *r, double *xi_ell, int *status) {
+  int ia, il, i;
+  double *pk_arr;
 
-  cosmo->data.rsd_splines[2] = ccl_spline_init(N_ARR, s_arr, xi_arr4, xi_arr4[0], 0);
-  if (cosmo->data.rsd_splines[2] == NULL) {
-    free(k_arr);
-    free(pk_arr);
-    free(s_arr);
-    free(xi_arr);
-    free(xi_arr0);
-    free(xi_arr2);
-    free(xi_arr4);
-    ccl_spline_free(cosmo->data.rsd_splines[0]);
-    cosmo->data.rsd_splines[0] = NULL;
-    ccl_spline_free(cosmo->data.rsd_splines[1]);
-    cosmo->data.rsd_splines[1] = NULL;
+  pk_arr = malloc(sizeof(double) * n_a * n_k);
+  if (pk_arr == NULL) {
     *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_multipole_spline ran out of "
-           "memory\n");
+    ccl_cosmology_set_status_message(cosmo, "ccl_correlation.c: ccl_rsd_multipoles ran out of memory\n");
     return;
   }
 
-  // set the scale factor
-  cosmo->data.rsd_splines_scalefactor = a;
+  ccl_nonlin_matter_power_array(cosmo, n_a, a, n_k, k, pk_arr, status);
 
-  free(k_arr);
+  if (*status == 0) {
+    for (ia = 0; ia < n_a; ia++) {
+      for (il = 0; il < CCL_XI_CACHE_NL; il++) {
+        double fac = kaiser_factor(2 * il, beta[ia]);
+        for (i = 0; i < n_k; i++)
+          pk_ell[(ia * CCL_XI_CACHE_NL + il) * n_k + i] = fac * pk_arr[ia * n_k + i];
+      }
+    }
+  }
   free(pk_arr);
-  free(s_arr);
-  free(xi_arr);
-  free(xi_arr0);
-  free(xi_arr2);
-  free(xi_arr4);
+
+  if ((xi_ell != NULL) && (*status == 0)) {
+    // One batched transform for all scale factors
+    xi_cache_fill(cosmo, n_a, a, status);
+
+    for (ia = 0; (ia < n_a) && (*status == 0); ia++) {
+      for (il = 0; il < CCL_XI_CACHE_NL; il++) {
+        double fac = kaiser_factor(2 * il, beta[ia]);
+        SplPar *spl = xi_cache_get(cosmo, a[ia], 2 * il, status);
+        if (spl == NULL)
+          break;
+        if (il == 1)
+          fac = -fac;
+        for (i = 0; i < n_r; i++)
+          xi_ell[(ia * CCL_XI_CACHE_NL + il) * n_r + i] = fac * ccl_spline_eval(r[i], spl);
+      }
+    }
+  }
 
   ccl_check_status(cosmo, status);
 
@@ -868,20 +1455,20 @@ void ccl_correlation_3dRsd(ccl_cosmology *cosmo, double a, int n_s, double *s,
     free(xi_arr4);
 
   } else {
-    if ((cosmo->data.rsd_splines[0] == NULL) ||
-        (cosmo->data.rsd_splines[1] == NULL) ||
-        (cosmo->data.rsd_splines[2] == NULL) ||
-        (cosmo->data.rsd_splines_scalefactor != a))
-      ccl_correlation_multipole_spline(cosmo, a, status);
-
-    for (i = 0; i < n_s; i++)
-      xi[i] = (1. + 2. / 3 * beta + 1. / 5 * beta * beta) *
-                  ccl_spline_eval(s[i], cosmo->data.rsd_splines[0]) -
-              (4. / 3 * beta + 4. / 7 * beta * beta) *
-                  ccl_spline_eval(s[i], cosmo->data.rsd_splines[1]) *
-                  gsl_sf_legendre_Pl(2, mu) +
-              8. / 35 * beta * beta * ccl_spline_eval(s[i], cosmo->data.rsd_splines[2]) *
-                  gsl_sf_legendre_Pl(4, mu);
+    SplPar *spl0 = xi_cache_get(cosmo, a, 0, status);
+    SplPar *spl2 = xi_cache_get(cosmo, a, 2, status);
+    SplPar *spl4 = xi_cache_get(cosmo, a, 4, status);
+
+    if (*status == 0) {
+      for (i = 0; i < n_s; i++)
+        xi[i] = (1. + 2. / 3 * beta + 1. / 5 * beta * beta) *
+                    ccl_spline_eval(s[i], spl0) -
+                (4. / 3 * beta + 4. / 7 * beta * beta) *
+                    ccl_spline_eval(s[i], spl2) *
+                    gsl_sf_legendre_Pl(2, mu) +
+                8. / 35 * beta * beta * ccl_spline_eval(s[i], spl4) *
+                    gsl_sf_legendre_Pl(4, mu);
+    }
   }
 
   ccl_check_status(cosmo, status);
@@ -922,49 +1509,79 @@ Correlation function result will be in array xi
 void ccl_correlation_pi_sigma(ccl_cosmology *cosmo, double a, double beta,
                               double pi, int n_sig, double *sig, double *xi,
                               int use_spline, int *status) {
-  int i;
-  double *mu_arr, *s_arr, *xi_arr;
+  ccl_correlation_pi_sigma_grid(cosmo, a, beta, 1, &pi, n_sig, sig, xi,
+                                use_spline, status);
+}
 
-  mu_arr = malloc(sizeof(double) * n_sig);
-  if (mu_arr == NULL) {
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_pi_sigma ran out of memory\n");
-    return;
-  }
+/*--------ROUTINE: ccl_correlation_pi_sigma_grid ------
+TASK: Calculate the redshift-space correlation function on a grid of
+      longitudinal and transverse coordinates pi and sigma. The three
+      multipoles are computed once for all cells, and combined with
+      the Legendre polynomials of mu = pi/s in each cell.
 
-  s_arr = malloc(sizeof(double) * n_sig);
+INPUT:  cosmology, scale factor a, beta (= growth rate / bias),
+        number of pi values, pi values, number of sigma values, sigma values,
+        key for using spline
+
+Correlation function result will be in array xi, with xi[j*n_sig+i]
+corresponding to pi[j] and sig[i].
+*/
+
+void ccl_correlation_pi_sigma_grid(ccl_cosmology *cosmo, double a, double beta,
+                                   int n_pi, double *pi, int n_sig, double *sig,
+                                   double *xi, int use_spline, int *status) {
+  int i, n = n_pi * n_sig;
+  double *s_arr, *mu_arr, *xi_arr0, *xi_arr2, *xi_arr4;
+
+  s_arr = malloc(sizeof(double) * 5 * n);
   if (s_arr == NULL) {
-    free(mu_arr);
     *status = CCL_ERROR_MEMORY;
     strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_pi_sigma ran out of memory\n");
+           "ccl_correlation.c: ccl_correlation_pi_sigma_grid ran out of memory\n");
     return;
   }
-
-  xi_arr = malloc(sizeof(double) * n_sig);
-  if (xi_arr == NULL) {
-    free(mu_arr);
-    free(s_arr);
-    *status = CCL_ERROR_MEMORY;
-    strcpy(cosmo->status_message,
-           "ccl_correlation.c: ccl_correlation_pi_sigma ran out of memory\n");
-    return;
+  mu_arr = &(s_arr[n]);
+  xi_arr0 = &(s_arr[2 * n]);
+  xi_arr2 = &(s_arr[3 * n]);
+  xi_arr4 = &(s_arr[4 * n]);
+
+  for (i = 0; i < n; i++) {
+    double p = pi[i / n_sig], sg = sig[i % n_sig];
+    s_arr[i] = sqrt(p * p + sg * sg);
+    mu_arr[i] = (s_arr[i] > 0) ? p / s_arr[i] : 0;
   }
 
-  for (i = 0; i < n_sig; i++) {
-    s_arr[i] = sqrt(pi * pi + sig[i] * sig[i]);
-    mu_arr[i] = pi / s_arr[i];
+  // Multipoles, including their beta-dependent prefactors
+  if (use_spline == 0) {
+    ccl_correlation_multipole(cosmo, a, beta, 0, n, s_arr, xi_arr0, status);
+    ccl_correlation_multipole(cosmo, a, beta, 2, n, s_arr, xi_arr2, status);
+    ccl_correlation_multipole(cosmo, a, beta, 4, n, s_arr, xi_arr4, status);
+  } else {
+    SplPar *spl0 = xi_cache_get(cosmo, a, 0, status);
+    SplPar *spl2 = xi_cache_get(cosmo, a, 2, status);
+    SplPar *spl4 = xi_cache_get(cosmo, a, 4, status);
+
+    if (*status == 0) {
+      double b0 = 1. + 2. / 3 * beta + 1. / 5 * beta * beta;
+      double b2 = -(4. / 3 * beta + 4. / 7 * beta * beta);
+      double b4 = 8. / 35 * beta * beta;
+      for (i = 0; i < n; i++) {
+        xi_arr0[i] = b0 * ccl_spline_eval(s_arr[i], spl0);
+        xi_arr2[i] = b2 * ccl_spline_eval(s_arr[i], spl2);
+        xi_arr4[i] = b4 * ccl_spline_eval(s_arr[i], spl4);
+      }
+    }
   }
 
-  for (i = 0; i < n_sig; i++) {
-    ccl_correlation_3dRsd(cosmo, a, n_sig, s_arr, mu_arr[i], beta, xi_arr,
-                          use_spline, status);
-    xi[i] = xi_arr[i];
+  if (*status == 0) {
+    for (i = 0; i < n; i++) {
+      double mu2 = mu_arr[i] * mu_arr[i];
+      double p2 = 0.5 * (3 * mu2 - 1);
+      double p4 = 0.125 * ((35 * mu2 - 30) * mu2 + 3);
+      xi[i] = xi_arr0[i] + xi_arr2[i] * p2 + xi_arr4[i] * p4;
+    }
   }
 
-  free(mu_arr);
-  free(xi_arr);
   free(s_arr);
 
   ccl_check_status(cosmo, status);
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#include <gsl/gsl_sf_bessel.h>
+
+#include "ccl.h"
+
+int ccl_covariance_pair_index(int n_tracers,int i,int j)
+{
+  if(i>j) {
+    int t=i;
+    i=j;
+    j=t;
+  }
+  return i*n_tracers-(i*(i-1))/2+j-i;
+}
+
+void ccl_covariance_cls_gaussian(int n_tracers,int n_ell,double *ell,double *delta_ell,
+				 double *cls,double *noise,double f_sky,
+				 double *cov,int *status)
+{
+  int i,j,n_pairs=(n_tracers*(n_tracers+1))/2;
+  size_t n_data=(size_t)n_pairs*n_ell;
+  int *pair_i,*pair_j;
+  double *prefac;
+
+  if(f_sky<=0) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_raise_warning(*status,"ccl_covariance.c: ccl_covariance_cls_gaussian(): "
+		      "f_sky must be positive\n");
+    return;
+  }
+
+  pair_i=malloc(n_pairs*sizeof(int));
+  pair_j=malloc(n_pairs*sizeof(int));
+  prefac=malloc(n_ell*sizeof(double));
+  if((pair_i==NULL) || (pair_j==NULL) || (prefac==NULL)) {
+    free(pair_i);
+    free(pair_j);
+    free(prefac);
+    *status=CCL_ERROR_MEMORY;
+    ccl_raise_warning(*status,"ccl_covariance.c: ccl_covariance_cls_gaussian(): "
+		      "memory allocation\n");
+    return;
+  }
+
+  for(i=0;i<n_tracers;i++) {
+    for(j=i;j<n_tracers;j++) {
+      int p=ccl_covariance_pair_index(n_tracers,i,j);
+      pair_i[p]=i;
+      pair_j[p]=j;
+    }
+  }
+  for(i=0;i<n_ell;i++)
+    prefac[i]=1./((2*ell[i]+1)*delta_ell[i]*f_sky);
+
+  //The covariance is block-diagonal in ell. All rows are zeroed first, then each
+  //thread computes the blocks (p,q) with q>=p for its pairs p and writes both
+  //(p,q) and (q,p), so that every element is written by a single thread.
+  #pragma omp parallel default(none)			\
+    shared(n_tracers,n_ell,n_pairs,n_data,cls,noise,cov,pair_i,pair_j,prefac)
+  {
+    int p,q,l;
+    size_t row;
+
+    #pragma omp for
+    for(row=0;row<n_data;row++)
+      memset(&(cov[row*n_data]),0,n_data*sizeof(double));
+
+    #pragma omp for schedule(dynamic)
+    for(p=0;p<n_pairs;p++) {
+      int ti=pair_i[p],tj=pair_j[p];
+      for(q=p;q<n_pairs;q++) {
+	int tk=pair_i[q],tm=pair_j[q];
+	double *c_ik=&(cls[(CCL_MIN(ti,tk)*n_tracers+CCL_MAX(ti,tk))*n_ell]);
+	double *c_jm=&(cls[(CCL_MIN(tj,tm)*n_tracers+CCL_MAX(tj,tm))*n_ell]);
+	double *c_im=&(cls[(CCL_MIN(ti,tm)*n_tracers+CCL_MAX(ti,tm))*n_ell]);
+	double *c_jk=&(cls[(CCL_MIN(tj,tk)*n_tracers+CCL_MAX(tj,tk))*n_ell]);
+	double n_ik=(ti==tk) ? noise[ti] : 0;
+	double n_jm=(tj==tm) ? noise[tj] : 0;
+	double n_im=(ti==tm) ? noise[ti] : 0;
+	double n_jk=(tj==tk) ? noise[tj] : 0;
+
+	for(l=0;l<n_ell;l++) {
+	  double c=((c_ik[l]+n_ik)*(c_jm[l]+n_jm)+(c_im[l]+n_im)*(c_jk[l]+n_jk))*prefac[l];
+	  size_t d_p=(size_t)p*n_ell+l,d_q=(size_t)q*n_ell+l;
+	  cov[d_p*n_data+d_q]=c;
+	  cov[d_q*n_data+d_p]=c;
+	}
+      }
+    } //end omp for
+  } //end omp parallel
+
+  free(pair_i);
+  free(pair_j);
+  free(prefac);
+}
+
+void ccl_covariance_gaussian(ccl_cosmology *cosmo,CCL_ClWorkspace *w,
+			     int n_tracers,CCL_ClTracer **tracers,ccl_p2d_t *psp,
+			     double *noise,double f_sky,
+			     int n_ell,double *ell,double *delta_ell,
+			     double *cov,int *status)
+{
+  int i,j;
+  double *cls=malloc(n_tracers*n_tracers*n_ell*sizeof(double));
+  if(cls==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_covariance.c: ccl_covariance_gaussian ran out of memory\n");
+    ccl_check_status(cosmo,status);
+    return;
+  }
+
+  //Every pair is only computed once, and the spectra are shared by all blocks
+  for(i=0;(i<n_tracers) && (*status==0);i++) {
+    for(j=i;(j<n_tracers) && (*status==0);j++) {
+      ccl_angular_cls_limber(cosmo,w,tracers[i],tracers[j],psp,n_ell,ell,
+			     &(cls[(i*n_tracers+j)*n_ell]),status);
+    }
+  }
+
+  if(*status==0) {
+    ccl_covariance_cls_gaussian(n_tracers,n_ell,ell,delta_ell,cls,noise,f_sky,cov,status);
+    if(*status)
+      ccl_cosmology_set_status_message(cosmo, "ccl_covariance.c: ccl_covariance_gaussian: "
+				       "error computing the covariance\n");
+  }
+
+  free(cls);
+  ccl_check_status(cosmo,status);
+}
+
+//Locates x in the ascending array lk, returning the lower node and the
+//interpolation weight of the upper one. Returns 0 if x is out of range.
+static int cov_lk_locate(int n_k,double *lk,double x,int *i,double *t)
+{
+  int lo=0,hi=n_k-1;
+
+  if((n_k<2) || (x<lk[0]) || (x>lk[n_k-1]))
+    return 0;
+  while(hi-lo>1) {
+    int mid=(lo+hi)/2;
+    if(lk[mid]>x)
+      hi=mid;
+    else
+      lo=mid;
+  }
+  *i=lo;
+  *t=(x-lk[lo])/(lk[lo+1]-lk[lo]);
+  return 1;
+}
+
+//Variance of the linear density field averaged over a circular footprint of angular
+//radius theta_s at comoving distance chi:
+//  sigma_b^2 = Integral[ dk k/(2 pi) P_lin(k,a) (2 J_1(k chi theta_s)/(k chi theta_s))^2 ]
+//evaluated with the Simpson nodes and weights in ln(k) of ccl_get_pk_simpson_lk_array
+static double cov_sigma_b2(ccl_cosmology *cosmo,int n_k,double *lk,double *w_lk,double a,double chi,
+			   double theta_s,int *status)
+{
+  int ik;
+  double sum=0;
+
+  for(ik=0;ik<n_k;ik++) {
+    double k=exp(lk[ik]);
+    double x=k*chi*theta_s;
+    double wx=(x<1E-6) ? 1. : 2*gsl_sf_bessel_J1(x)/x;
+    sum+=w_lk[ik]*k*k*ccl_linear_matter_power(cosmo,k,a,status)*wx*wx;
+  }
+
+  return sum/(2*M_PI);
+}
+
+void ccl_covariance_nongaussian(ccl_cosmology *cosmo,ccl_halomod_workspace *hw,
+				int n_tracers,CCL_ClTracer **tracers,double f_sky,
+				int n_ell,double *ell,
+				double *cov_1h,double *cov_ssc,int *status)
+{
+  int ia,ik,il,il2,t,i,j,n_a=hw->n_a,n_k=hw->n_k,n_k_sb=0;
+  int n_pairs=(n_tracers*(n_tracers+1))/2;
+  size_t n_data=(size_t)n_pairs*n_ell;
+  double omega_s=4*M_PI*f_sky;
+  int *pair_i=NULL,*pair_j;
+  double *chi=NULL,*w_chi,*kern=NULL,*tk=NULL,*t_int=NULL,*dpk=NULL,*r_int=NULL,*s_b=NULL;
+  double *lk_sb=NULL,*w_sb;
+
+  if((f_sky<=0) || (n_k<2)) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_covariance.c: ccl_covariance_nongaussian: "
+				     "f_sky must be positive and the workspace must have at least two wavenumbers\n");
+    return;
+  }
+
+  pair_i=malloc(2*n_pairs*sizeof(int));
+  chi=malloc(2*n_a*sizeof(double));
+  kern=malloc(n_tracers*n_ell*n_a*sizeof(double));
+  if(cov_1h!=NULL) {
+    tk=malloc(n_a*n_k*n_k*sizeof(double));
+    t_int=malloc(n_ell*n_ell*n_a*sizeof(double));
+  }
+  if(cov_ssc!=NULL) {
+    n_k_sb=ccl_get_pk_simpson_nk(cosmo);
+    lk_sb=malloc(2*n_k_sb*sizeof(double));
+    dpk=malloc((n_a*n_k+n_ell*n_a+n_a)*sizeof(double));
+  }
+  if((pair_i==NULL) || (chi==NULL) || (kern==NULL) ||
+     ((cov_1h!=NULL) && ((tk==NULL) || (t_int==NULL))) ||
+     ((cov_ssc!=NULL) && ((lk_sb==NULL) || (dpk==NULL)))) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_covariance.c: ccl_covariance_nongaussian ran out of memory\n");
+  }
+
+  //Comoving distances of the workspace nodes, with trapezoidal weights in chi,
+  //and the Limber kernels of all tracers, stored as kern[(t*n_ell+l)*n_a+ia]
+  if(*status==0) {
+    pair_j=&(pair_i[n_pairs]);
+    for(i=0;i<n_tracers;i++) {
+      for(j=i;j<n_tracers;j++) {
+	int p=ccl_covariance_pair_index(n_tracers,i,j);
+	pair_i[p]=i;
+	pair_j[p]=j;
+      }
+    }
+
+    w_chi=&(chi[n_a]);
+    for(ia=0;ia<n_a;ia++)
+      chi[ia]=ccl_comoving_radial_distance(cosmo,hw->a[ia],status);
+    for(ia=0;ia<n_a;ia++)
+      w_chi[ia]=0.5*fabs(chi[(ia==n_a-1) ? ia : ia+1]-chi[(ia==0) ? ia : ia-1]);
+
+    for(t=0;(t<n_tracers) && (*status==0);t++) {
+      for(il=0;(il<n_ell) && (*status==0);il++)
+	ccl_get_tracer_limber_kernel(cosmo,tracers[t],ell[il],n_a,chi,
+				     &(kern[(t*n_ell+il)*n_a]),status);
+    }
+  }
+
+  //One-halo trispectrum at the Limber wavenumbers of each pair of multipoles, interpolated
+  //bilinearly in log(k1), log(k2) and log(T), times the distance weights
+  if((*status==0) && (cov_1h!=NULL)) {
+    ccl_halomod_trispectrum_1h(cosmo,hw,tk,status);
+    for(ia=0;(ia<n_a) && (*status==0);ia++) {
+      double *tk_a=&(tk[ia*n_k*n_k]);
+      for(il=0;il<n_ell;il++) {
+	for(il2=0;il2<n_ell;il2++) {
+	  int i1,i2;
+	  double t1,t2,tv=0;
+	  if((chi[ia]>0) &&
+	     cov_lk_locate(n_k,hw->lk,log((ell[il]+0.5)/chi[ia]),&i1,&t1) &&
+	     cov_lk_locate(n_k,hw->lk,log((ell[il2]+0.5)/chi[ia]),&i2,&t2)) {
+	    tv=exp((1-t1)*(1-t2)*log(tk_a[i1*n_k+i2])+t1*(1-t2)*log(tk_a[(i1+1)*n_k+i2])+
+		   (1-t1)*t2*log(tk_a[i1*n_k+i2+1])+t1*t2*log(tk_a[(i1+1)*n_k+i2+1]));
+	    tv*=w_chi[ia]/(pow(chi[ia],6)*omega_s);
+	  }
+	  t_int[(il*n_ell+il2)*n_a+ia]=tv;
+	}
+      }
+    }
+  }
+
+  //Power spectrum response at the Limber wavenumber of each multipole, interpolated
+  //linearly in log(k), and the variance of the background mode times the distance weights
+  if((*status==0) && (cov_ssc!=NULL)) {
+    double theta_s=sqrt(omega_s/M_PI);
+    r_int=&(dpk[n_a*n_k]);
+    s_b=&(r_int[n_ell*n_a]);
+    ccl_halomod_ssc_response(cosmo,hw,dpk,status);
+    w_sb=&(lk_sb[n_k_sb]);
+    if(*status==0)
+      ccl_get_pk_simpson_lk_array(cosmo,n_k_sb,lk_sb,w_sb,status);
+    for(ia=0;(ia<n_a) && (*status==0);ia++) {
+      for(il=0;il<n_ell;il++) {
+	double rv=0,tl;
+	if((chi[ia]>0) && cov_lk_locate(n_k,hw->lk,log((ell[il]+0.5)/chi[ia]),&ik,&tl))
+	  rv=(1-tl)*dpk[ia*n_k+ik]+tl*dpk[ia*n_k+ik+1];
+	r_int[il*n_a+ia]=rv;
+      }
+      if(chi[ia]>0)
+	s_b[ia]=w_chi[ia]*cov_sigma_b2(cosmo,n_k_sb,lk_sb,w_sb,hw->a[ia],chi[ia],theta_s,status)/
+	  pow(chi[ia],4);
+      else
+	s_b[ia]=0;
+    }
+  }
+
+  //Each thread computes the blocks (p,q) with q>=p for its pairs p and writes both
+  //(p,q) and (q,p), so that every element is written by a single thread.
+  if(*status==0) {
+    #pragma omp parallel default(none)					\
+      shared(n_a,n_ell,n_pairs,n_data,pair_i,pair_j,kern,t_int,r_int,s_b,cov_1h,cov_ssc)
+    {
+      int p,q,l1,l2;
+
+      #pragma omp for schedule(dynamic)
+      for(p=0;p<n_pairs;p++) {
+	for(q=p;q<n_pairs;q++) {
+	  for(l1=0;l1<n_ell;l1++) {
+	    double *q_i=&(kern[(pair_i[p]*n_ell+l1)*n_a]);
+	    double *q_j=&(kern[(pair_j[p]*n_ell+l1)*n_a]);
+	    for(l2=0;l2<n_ell;l2++) {
+	      double *q_k=&(kern[(pair_i[q]*n_ell+l2)*n_a]);
+	      double *q_m=&(kern[(pair_j[q]*n_ell+l2)*n_a]);
+	      double c_1h=0,c_ssc=0;
+	      size_t d_p=(size_t)p*n_ell+l1,d_q=(size_t)q*n_ell+l2;
+	      int ia;
+
+	      for(ia=0;ia<n_a;ia++) {
+		double qq=q_i[ia]*q_j[ia]*q_k[ia]*q_m[ia];
+		if(qq==0)
+		  continue;
+		if(cov_1h!=NULL)
+		  c_1h+=qq*t_int[(l1*n_ell+l2)*n_a+ia];
+		if(cov_ssc!=NULL)
+		  c_ssc+=qq*r_int[l1*n_a+ia]*r_int[l2*n_a+ia]*s_b[ia];
+	      }
+	      if(cov_1h!=NULL) {
+		cov_1h[d_p*n_data+d_q]=c_1h;
+		cov_1h[d_q*n_data+d_p]=c_1h;
+	      }
+	      if(cov_ssc!=NULL) {
+		cov_ssc[d_p*n_data+d_q]=c_ssc;
+		cov_ssc[d_q*n_data+d_p]=c_ssc;
+	      }
+	    }
+	  }
+	}
+      } //end omp for
+    } //end omp parallel
+  }
+
+  free(pair_i);
+  free(chi);
+  free(kern);
+  free(tk);
+  free(t_int);
+  free(lk_sb);
+  free(dpk);
+  ccl_check_status(cosmo,status);
+}
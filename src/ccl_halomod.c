@@ -5,42 +5,123 @@
 
 #include <gsl/gsl_errno.h>
 #include <gsl/gsl_integration.h>
-#include <gsl/gsl_sf_expint.h>
+#include <gsl/gsl_math.h>
 #include <gsl/gsl_roots.h>
 
 #include "ccl.h"
 
+// Chebyshev coefficients of G(x)=x^2 g(x) and H(x)=x^2 (1-x f(x))/2 in t=8/x-1
+// for x>=4, where f and g are the auxiliary functions of the sine and cosine
+// integrals. Both tend to 1 as x->infinity; the truncation error is below 1E-15.
+#define NFW_NCHEB 32
+static const double nfw_cheb_g[NFW_NCHEB] = {
+  1.8240976510593161e+00, -1.0747890964438699e-01, -1.4042862912383221e-02,
+  4.9592034540747090e-03, -6.2691780467457204e-04, -4.2656567192295274e-05,
+  4.4682517374217900e-05, -1.2701604662169455e-05, 1.7726989407348322e-06,
+  2.2043478757633961e-07, -2.3697231492802797e-07, 8.8410293605107235e-08,
+  -2.0102731097882100e-08, 1.2607668108657068e-09, 1.4522795555349204e-09,
+  -9.1899049004501585e-10, 3.4212115828222783e-10, -8.4732190023404402e-11,
+  6.8533846566548594e-12, 6.8956306250248184e-12, -5.1721968613409329e-12,
+  2.2989771599011414e-12, -7.3670168634446902e-13, 1.4383026200893063e-13,
+  1.5542520612546463e-14, -3.2825382675326828e-14, 2.0111390128483657e-14,
+  -8.6876433419887565e-15, 2.7839962684720701e-15, -4.8737598158654638e-16,
+  -1.6521072704334116e-16, 2.4603799900213554e-16
+};
+static const double nfw_cheb_h[NFW_NCHEB] = {
+  1.7008834099879915e+00, -1.7695369589351809e-01, -1.5735331426937633e-02,
+  9.8707926707914864e-03, -1.9002981597207520e-03, 4.4440105091450612e-05,
+  1.0437305551601160e-04, -4.2603002325393396e-05, 9.2361218321074834e-06,
+  -3.9889462805697975e-07, -6.6339670006559208e-07, 3.6059086830794868e-07,
+  -1.1356238468767537e-07, 2.0222515562954676e-08, 2.0530871271302873e-09,
+  -3.5917110849005795e-09, 1.8248599280370052e-09, -6.1873901744356756e-10,
+  1.3138967159635289e-10, 4.2430022928301173e-12, -2.1611434947021772e-11,
+  1.3442477514866274e-11, -5.6287702761223987e-12, 1.7014523795953752e-12,
+  -2.6748709764807162e-13, -9.1995555415400974e-14, 1.0982053482745669e-13,
+  -6.3058461447287886e-14, 2.6679241136908414e-14, -8.4128251963179933e-15,
+  1.4110023913160853e-15, 5.2421355740036218e-16
+};
+
+// Auxiliary functions of the sine and cosine integrals, returning
+// fm = f(x)-1/x and g(x), with Si(x)=pi/2-f cos(x)-g sin(x) and
+// Ci(x)=f sin(x)-g cos(x).
+static void nfw_sici_aux(double x, double *fm, double *g)
+{
+  if (x <= 4.) {
+    // Power series of Si and Ci, which converge quickly for x<=4
+    double x2 = x*x, term = x, si = x, ci = 0, s, c;
+    for (int n=1; n<30; n++) {
+      term *= -x2/((2*n)*(2*n+1));
+      ci += term*(2*n+1)/(x*2*n);
+      si += term/(2*n+1);
+      if (fabs(term) < 1E-17)
+        break;
+    }
+    ci += M_EULER+log(x);
+    s = sin(x);
+    c = cos(x);
+    *fm = (M_PI_2-si)*c+ci*s-1./x;
+    *g = (M_PI_2-si)*s-ci*c;
+  }
+  else {
+    // Clenshaw recurrence for the Chebyshev series
+    double t = 8./x-1., x2 = x*x;
+    double bg0 = 0, bg1 = 0, bh0 = 0, bh1 = 0;
+    for (int n=NFW_NCHEB-1; n>0; n--) {
+      double tmp = bg0;
+      bg0 = 2*t*bg0-bg1+nfw_cheb_g[n];
+      bg1 = tmp;
+      tmp = bh0;
+      bh0 = 2*t*bh0-bh1+nfw_cheb_h[n];
+      bh1 = tmp;
+    }
+    *g = (t*bg0-bg1+0.5*nfw_cheb_g[0])/x2;
+    *fm = -2*(t*bh0-bh1+0.5*nfw_cheb_h[0])/(x2*x);
+  }
+}
+
+// Normalised NFW profile at x=k*rs for concentration c, with inv_fc=1/(ln(1+c)-c/(1+c)).
+// Written in terms of the auxiliary functions, the combination of sine and cosine
+// integrals in Cooray & Sheth (2002) reduces to g(x)+[f(y)-1/y] sin(cx)-g(y) cos(cx)
+// with y=(1+c)x, which needs a single sine and cosine and has no cancellation at large k.
+static double nfw_u_x(double x, double c, double inv_fc)
+{
+  double fm_x, g_x, fm_y, g_y;
+
+  if (x == 0.)
+    return 1.;
+
+  nfw_sici_aux(x, &fm_x, &g_x);
+  nfw_sici_aux((1.+c)*x, &fm_y, &g_y);
+  return (g_x+fm_y*sin(c*x)-g_y*cos(c*x))*inv_fc;
+}
+
 // Analytic FT of NFW profile, from Cooray & Sheth (2002; Section 3 of https://arxiv.org/abs/astro-ph/0206508)
 // Normalised such that U(k=0)=1
 static double u_nfw_c(ccl_cosmology *cosmo, double rv, double c, double k, int *status){
 
-  double rs, ks;
-  double f1, f2, f3, fc;
-
   // Special case to prevent numerical problems if k=0,
   // the result should be unity here because of the normalisation
   if (k==0.) {
     return 1.;
   }
 
-  // The general k case
-  else{
-
-    // Scale radius for NFW (rs=rv/c)
-    rs = rv/c;
+  // The general k case, with the scale radius for NFW rs=rv/c
+  return nfw_u_x(k*rv/c, c, 1./(log(1.+c)-c/(1.+c)));
+}
 
-    // Dimensionless wave-number variable
-    ks = k*rs;
+/*----- ROUTINE: ccl_halo_profile_nfw_fourier -----
+INPUT: halo radius [Mpc], concentration, wavenumbers [Mpc^-1]
+TASK: Computes the normalised Fourier transform of the NFW profile of a single
+      halo for an array of wavenumbers
+*/
+void ccl_halo_profile_nfw_fourier(double rv, double c, int n_k, double *k, double *uk){
 
-    // Various bits for summing together to get final result
-    f1 = sin(ks)*(gsl_sf_Si(ks*(1.+c))-gsl_sf_Si(ks));
-    f2 = cos(ks)*(gsl_sf_Ci(ks*(1.+c))-gsl_sf_Ci(ks));
-    f3 = sin(c*ks)/(ks*(1.+c));
-    fc = log(1.+c)-c/(1.+c);
+  double rs = rv/c;
+  double inv_fc = 1./(log(1.+c)-c/(1.+c));
 
-    return (f1+f2-f3)/fc;
+  for (int ik=0; ik<n_k; ik++)
+    uk[ik] = nfw_u_x(k[ik]*rs, c, inv_fc);
 
-  }
 }
 
 /*----- ROUTINE: ccl_halo_concentration -----
@@ -327,3 +408,693 @@ double ccl_halomodel_matter_power(ccl_cosmology *cosmo, double k, double a, int
   return ccl_twohalo_matter_power(cosmo, k, a, status)+ccl_onehalo_matter_power(cosmo, k, a, status);
 
 }
+
+/*----- ROUTINE: ccl_halomod_table_new -----
+INPUT: cosmology, scale factor
+TASK: Tabulates the mass function, halo bias, concentration and halo radius
+      on a fixed grid in log10(M), with Simpson weights for the mass integrals
+*/
+ccl_halomod_table *ccl_halomod_table_new(ccl_cosmology *cosmo, double a, int *status){
+
+  int i;
+  double log10mmin = log10(cosmo->gsl_params.HM_MMIN);
+  double log10mmax = log10(cosmo->gsl_params.HM_MMAX);
+  double dlogm, norm;
+  ccl_halomod_table *tab;
+
+  // Simpson's rule needs an even number of intervals
+  int n_int = (int)ceil((log10mmax-log10mmin)*cosmo->spline_params.N_M_HM);
+  if (n_int < 2) n_int = 2;
+  if (n_int % 2) n_int++;
+  dlogm = (log10mmax-log10mmin)/n_int;
+
+  tab = malloc(sizeof(ccl_halomod_table));
+  if (tab == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_table_new(): memory allocation\n");
+    return NULL;
+  }
+  tab->a = a;
+  tab->n_m = n_int+1;
+  tab->lmass = malloc(6*tab->n_m*sizeof(double));
+  if (tab->lmass == NULL) {
+    free(tab);
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_table_new(): memory allocation\n");
+    return NULL;
+  }
+  tab->weight = &(tab->lmass[tab->n_m]);
+  tab->dndlogm = &(tab->lmass[2*tab->n_m]);
+  tab->bias = &(tab->lmass[3*tab->n_m]);
+  tab->conc = &(tab->lmass[4*tab->n_m]);
+  tab->rdelta = &(tab->lmass[5*tab->n_m]);
+
+  // Quantities that only depend on the scale factor are computed once
+  tab->odelta = Dv_BryanNorman(cosmo, a, status);
+  tab->rho_m = ccl_rho_x(cosmo, 1., ccl_species_m_label, 1, status);
+
+  for (i=0; i<tab->n_m; i++) {
+    tab->lmass[i] = log10mmin+i*dlogm;
+    if ((i == 0) || (i == n_int))
+      tab->weight[i] = dlogm/3.;
+    else
+      tab->weight[i] = (i%2 ? 4. : 2.)*dlogm/3.;
+
+    // The masses are stored in rdelta until the mass function has been computed
+    tab->rdelta[i] = pow(10, tab->lmass[i]);
+  }
+  ccl_massfunc_bias_array(cosmo, tab->n_m, tab->rdelta, a, tab->odelta, tab->dndlogm, tab->bias, status);
+
+  norm = 0;
+  for (i=0; i<tab->n_m; i++) {
+    double halomass = tab->rdelta[i];
+    tab->conc[i] = ccl_halo_concentration(cosmo, halomass, a, tab->odelta, status);
+    tab->rdelta[i] = r_delta(cosmo, halomass, a, tab->odelta, status);
+
+    // The k=0 two-halo integral, where the window is just M/rho
+    norm += tab->weight[i]*tab->dndlogm[i]*tab->bias[i]*halomass/tab->rho_m;
+  }
+
+  // The additive correction is the missing part of the integral below the lower-mass limit
+  tab->corr_2h = 1.-norm;
+
+  if (*status) {
+    ccl_halomod_table_free(tab);
+    return NULL;
+  }
+
+  return tab;
+}
+
+/*----- ROUTINE: ccl_halomod_table_free -----
+INPUT: halo-model mass table
+*/
+void ccl_halomod_table_free(ccl_halomod_table *tab){
+
+  if (tab != NULL) {
+    free(tab->lmass);
+    free(tab);
+  }
+
+}
+
+/*----- ROUTINE: ccl_halomod_table_power -----
+INPUT: cosmology, mass table, wavenumbers [Mpc^-1]
+TASK: Computes the one- and two-halo power spectrum terms for all wavenumbers
+      as weighted sums over the mass table
+*/
+void ccl_halomod_table_power(ccl_cosmology *cosmo, ccl_halomod_table *tab,
+			     int n_k, double *k, double *pk_1h, double *pk_2h, int *status){
+
+  int ik;
+  double *mrho, *rs, *inv_fc;
+
+  // Mass-dependent prefactors of the NFW window, shared by all wavenumbers
+  mrho = malloc(3*tab->n_m*sizeof(double));
+  if (mrho == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_table_power(): memory allocation\n");
+    return;
+  }
+  rs = &(mrho[tab->n_m]);
+  inv_fc = &(mrho[2*tab->n_m]);
+  for (int i=0; i<tab->n_m; i++) {
+    double c = tab->conc[i];
+    mrho[i] = pow(10, tab->lmass[i])/tab->rho_m;
+    rs[i] = tab->rdelta[i]/c;
+    inv_fc[i] = 1./(log(1.+c)-c/(1.+c));
+  }
+
+  // The linear power spectrum is evaluated outside the parallel region,
+  // since the power spectrum splines share their accelerators
+  if (pk_2h != NULL) {
+    for (ik=0; ik<n_k; ik++)
+      pk_2h[ik] = ccl_linear_matter_power(cosmo, k[ik], tab->a, status);
+  }
+  if (*status) {
+    free(mrho);
+    return;
+  }
+
+  // Only the NFW window depends on k, so wavenumbers are independent
+  #pragma omp parallel for default(none) \
+    shared(tab,n_k,k,pk_1h,pk_2h,mrho,rs,inv_fc)
+  for (ik=0; ik<n_k; ik++) {
+    double i1h = 0, i2h = 0;
+
+    for (int i=0; i<tab->n_m; i++) {
+      double wk = mrho[i]*nfw_u_x(k[ik]*rs[i], tab->conc[i], inv_fc[i]);
+      double wn = tab->weight[i]*tab->dndlogm[i];
+      i1h += wn*wk*wk;
+      i2h += wn*tab->bias[i]*wk;
+    }
+
+    // The correction below the lower-mass limit scales with the window of the
+    // smallest halo, normalised to unity at k=0
+    i2h += tab->corr_2h*nfw_u_x(k[ik]*rs[0], tab->conc[0], inv_fc[0]);
+
+    if (pk_1h != NULL)
+      pk_1h[ik] = i1h;
+    if (pk_2h != NULL)
+      pk_2h[ik] *= i2h*i2h;
+  } //end omp parallel for
+
+  free(mrho);
+}
+
+/*----- ROUTINE: ccl_halomodel_matter_power_array -----
+INPUT: cosmology, scale factors, wavenumbers [Mpc^-1]
+TASK: Computes the halo model power spectrum on a grid of scale factors and
+      wavenumbers, with pk[ia*n_k+ik] = P(k[ik],a[ia]), using one mass table
+      per scale factor
+*/
+void ccl_halomodel_matter_power_array(ccl_cosmology *cosmo, int n_a, double *a,
+				      int n_k, double *k, double *pk, int *status){
+
+  double *pk_1h = malloc(n_k*sizeof(double));
+  if (pk_1h == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomodel_matter_power_array(): memory allocation\n");
+    return;
+  }
+
+  for (int ia=0; ia<n_a; ia++) {
+    double *pk_a = &(pk[ia*n_k]);
+    ccl_halomod_table *tab = ccl_halomod_table_new(cosmo, a[ia], status);
+    if (tab == NULL)
+      break;
+
+    ccl_halomod_table_power(cosmo, tab, n_k, k, pk_1h, pk_a, status);
+    ccl_halomod_table_free(tab);
+    if (*status)
+      break;
+
+    for (int ik=0; ik<n_k; ik++)
+      pk_a[ik] += pk_1h[ik];
+  }
+
+  free(pk_1h);
+}
+
+/*----- ROUTINE: ccl_halomod_workspace_free -----
+INPUT: halo-model workspace
+*/
+void ccl_halomod_workspace_free(ccl_halomod_workspace *w){
+
+  if (w != NULL) {
+    if (w->tab != NULL) {
+      for (int ia=0; ia<w->n_a; ia++)
+	ccl_halomod_table_free(w->tab[ia]);
+    }
+    free(w->tab);
+    free(w->a);
+    free(w->uk);
+    free(w->pk_lin);
+    free(w);
+  }
+
+}
+
+/*----- ROUTINE: ccl_halomod_workspace_new -----
+INPUT: cosmology, scale factors, wavenumbers [Mpc^-1]
+TASK: Tabulates everything the halo model needs on a grid of scale factors and
+      wavenumbers: mass tables, NFW profiles, the linear power spectrum and the
+      halo-model matter power spectrum
+*/
+ccl_halomod_workspace *ccl_halomod_workspace_new(ccl_cosmology *cosmo, int n_a, double *a,
+						 int n_k, double *k, int *status){
+
+  ccl_halomod_workspace *w;
+  if ((n_a <= 0) || (n_k <= 0)) {
+    *status = CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_workspace_new(): "
+				     "the workspace needs at least one scale factor and one wavenumber\n");
+    return NULL;
+  }
+
+  w = calloc(1, sizeof(ccl_halomod_workspace));
+  if (w == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_workspace_new(): memory allocation\n");
+    return NULL;
+  }
+  w->n_a = n_a;
+  w->n_k = n_k;
+  w->tab = calloc(n_a, sizeof(ccl_halomod_table *));
+  w->a = malloc((n_a+n_k)*sizeof(double));
+  w->pk_lin = malloc(3*n_a*n_k*sizeof(double));
+  if ((w->tab == NULL) || (w->a == NULL) || (w->pk_lin == NULL)) {
+    ccl_halomod_workspace_free(w);
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_workspace_new(): memory allocation\n");
+    return NULL;
+  }
+  w->lk = &(w->a[n_a]);
+  w->i_m = &(w->pk_lin[n_a*n_k]);
+  w->pk_mm = &(w->pk_lin[2*n_a*n_k]);
+  for (int ia=0; ia<n_a; ia++)
+    w->a[ia] = a[ia];
+  for (int ik=0; ik<n_k; ik++)
+    w->lk[ik] = log(k[ik]);
+
+  // Mass tables and the linear power spectrum use the cosmology's splines
+  // and accelerators, so they are computed serially
+  for (int ia=0; ia<n_a; ia++) {
+    w->tab[ia] = ccl_halomod_table_new(cosmo, a[ia], status);
+    if (w->tab[ia] == NULL)
+      break;
+    for (int ik=0; ik<n_k; ik++)
+      w->pk_lin[ia*n_k+ik] = ccl_linear_matter_power(cosmo, k[ik], a[ia], status);
+  }
+  if (*status) {
+    ccl_halomod_workspace_free(w);
+    return NULL;
+  }
+
+  w->n_m = w->tab[0]->n_m;
+  w->uk = malloc(n_a*w->n_m*n_k*sizeof(double));
+  if (w->uk == NULL) {
+    ccl_halomod_workspace_free(w);
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_workspace_new(): memory allocation\n");
+    return NULL;
+  }
+
+  #pragma omp parallel default(none) shared(w,k,n_a,n_k)
+  {
+    // NFW profiles of every halo
+    #pragma omp for collapse(2)
+    for (int ia=0; ia<n_a; ia++) {
+      for (int im=0; im<w->n_m; im++) {
+	ccl_halomod_table *tab = w->tab[ia];
+	double c = tab->conc[im];
+	double rs = tab->rdelta[im]/c;
+	double inv_fc = 1./(log(1.+c)-c/(1.+c));
+	double *uk = &(w->uk[(ia*w->n_m+im)*n_k]);
+	for (int ik=0; ik<n_k; ik++)
+	  uk[ik] = nfw_u_x(k[ik]*rs, c, inv_fc);
+      }
+    } //end omp for
+
+    // Matter power spectrum, as in ccl_halomod_table_power
+    #pragma omp for collapse(2)
+    for (int ia=0; ia<n_a; ia++) {
+      for (int ik=0; ik<n_k; ik++) {
+	ccl_halomod_table *tab = w->tab[ia];
+	double i1h = 0, i2h = 0;
+	for (int im=0; im<w->n_m; im++) {
+	  double wk = pow(10, tab->lmass[im])*w->uk[(ia*w->n_m+im)*n_k+ik]/tab->rho_m;
+	  double wn = tab->weight[im]*tab->dndlogm[im];
+	  i1h += wn*wk*wk;
+	  i2h += wn*tab->bias[im]*wk;
+	}
+	i2h += tab->corr_2h*w->uk[ia*w->n_m*n_k+ik];
+	w->i_m[ia*n_k+ik] = i2h;
+	w->pk_mm[ia*n_k+ik] = w->pk_lin[ia*n_k+ik]*i2h*i2h+i1h;
+      }
+    } //end omp for
+  } //end omp parallel
+
+  return w;
+}
+
+/*----- ROUTINE: hod_occupation -----
+INPUT: HOD parameters, log10 of the halo mass
+TASK: Returns the mean number of centrals, and the mean number of satellites per central
+*/
+static void hod_occupation(ccl_hod_params *hod, double lmass, double *n_c, double *f_s){
+
+  *n_c = 0.5*(1.+erf((lmass-hod->log10_mmin)/hod->sigma_logm));
+  if (lmass > hod->log10_m0)
+    *f_s = pow((pow(10, lmass)-pow(10, hod->log10_m0))/pow(10, hod->log10_m1), hod->alpha);
+  else
+    *f_s = 0;
+
+}
+
+/*----- ROUTINE: ccl_halomod_hod_power -----
+INPUT: cosmology, halo-model workspace, HOD parameters
+TASK: Computes the galaxy number density and the galaxy-galaxy and galaxy-matter
+      power spectra on the grid of the workspace
+*/
+void ccl_halomod_hod_power(ccl_cosmology *cosmo, ccl_halomod_workspace *w, ccl_hod_params *hod,
+			   double *n_g, double *pk_gg, double *pk_gm, int *status){
+
+  int n_k = w->n_k, n_m = w->n_m;
+
+  if (!(hod->sigma_logm > 0)) {
+    *status = CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_hod_power(): "
+				     "sigma_logm must be positive\n");
+    return;
+  }
+
+  // Occupations weighted by the mass function, and the galaxy number density
+  double *wn_c = malloc((2*w->n_a*n_m+w->n_a)*sizeof(double));
+  if (wn_c == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_hod_power(): memory allocation\n");
+    return;
+  }
+  double *f_s = &(wn_c[w->n_a*n_m]);
+  double *ng = &(wn_c[2*w->n_a*n_m]);
+
+  for (int ia=0; ia<w->n_a; ia++) {
+    ccl_halomod_table *tab = w->tab[ia];
+    ng[ia] = 0;
+    for (int im=0; im<n_m; im++) {
+      double n_c;
+      hod_occupation(hod, tab->lmass[im], &n_c, &(f_s[ia*n_m+im]));
+      wn_c[ia*n_m+im] = tab->weight[im]*tab->dndlogm[im]*n_c;
+      ng[ia] += wn_c[ia*n_m+im]*(1.+f_s[ia*n_m+im]);
+    }
+    if (!(ng[ia] > 0)) {
+      *status = CCL_ERROR_INCONSISTENT;
+      ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_hod_power(): the HOD has no galaxies at a=%lf\n", w->a[ia]);
+      free(wn_c);
+      return;
+    }
+    if (n_g != NULL)
+      n_g[ia] = ng[ia];
+  }
+
+  #pragma omp parallel for collapse(2) default(none) \
+    shared(w,n_k,n_m,wn_c,f_s,ng,pk_gg,pk_gm)
+  for (int ia=0; ia<w->n_a; ia++) {
+    for (int ik=0; ik<n_k; ik++) {
+      ccl_halomod_table *tab = w->tab[ia];
+      double i_gg = 0, i_gm = 0, i_g = 0;
+
+      for (int im=0; im<n_m; im++) {
+	double u = w->uk[(ia*n_m+im)*n_k+ik];
+	double fu = f_s[ia*n_m+im]*u;
+	double wn = wn_c[ia*n_m+im];
+	i_gg += wn*fu*(2.+fu);
+	i_gm += wn*(1.+fu)*pow(10, tab->lmass[im])*u/tab->rho_m;
+	i_g += wn*(1.+fu)*tab->bias[im];
+      }
+      i_g /= ng[ia];
+
+      if (pk_gg != NULL)
+	pk_gg[ia*n_k+ik] = w->pk_lin[ia*n_k+ik]*i_g*i_g+i_gg/(ng[ia]*ng[ia]);
+      if (pk_gm != NULL)
+	pk_gm[ia*n_k+ik] = w->pk_lin[ia*n_k+ik]*i_g*w->i_m[ia*n_k+ik]+i_gm/ng[ia];
+    }
+  } //end omp parallel for
+
+  free(wn_c);
+}
+
+/*----- ROUTINE: ccl_halomod_hod_p2d -----
+INPUT: cosmology, halo-model workspace, HOD parameters
+TASK: Builds the galaxy-galaxy, galaxy-matter and matter-matter power spectra
+      of an HOD sample as 2D splines
+*/
+void ccl_halomod_hod_p2d(ccl_cosmology *cosmo, ccl_halomod_workspace *w, ccl_hod_params *hod,
+			 ccl_p2d_t **p_gg, ccl_p2d_t **p_gm, ccl_p2d_t **p_mm, int *status){
+
+  int n_ak = w->n_a*w->n_k;
+  double *pk_g;
+
+  // Bicubic splines need four nodes per dimension, and ccl_p2d_t_new needs the grid to end at a=1
+  if ((w->n_a < 4) || (w->n_k < 4) || (fabs(w->a[w->n_a-1]-1) > 1E-4)) {
+    *status = CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_hod_p2d(): the workspace needs "
+				     "at least 4 scale factors, ending at a=1, and 4 wavenumbers\n");
+    return;
+  }
+
+  pk_g = malloc(3*n_ak*sizeof(double));
+  if (pk_g == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_hod_p2d(): memory allocation\n");
+    return;
+  }
+  double *lpk = &(pk_g[2*n_ak]);
+
+  if ((p_gg != NULL) || (p_gm != NULL))
+    ccl_halomod_hod_power(cosmo, w, hod, NULL, pk_g, &(pk_g[n_ak]), status);
+
+  // The splines hold log(P), as for the matter power spectra of the cosmology
+  for (int ip=0; (ip<3) && (*status == 0); ip++) {
+    ccl_p2d_t **psp = (ip == 0) ? p_gg : ((ip == 1) ? p_gm : p_mm);
+    double *pk = (ip == 2) ? w->pk_mm : &(pk_g[ip*n_ak]);
+    if (psp == NULL)
+      continue;
+
+    for (int i=0; i<n_ak; i++)
+      lpk[i] = log(pk[i]);
+    *psp = ccl_p2d_t_new(w->n_a, w->a, w->n_k, w->lk, lpk, 1, 2, ccl_p2d_cclgrowth,
+			 1, NULL, 0, ccl_p2d_3, status);
+  }
+
+  free(pk_g);
+}
+
+/*----- ROUTINE: ccl_halomod_trispectrum_1h -----
+INPUT: cosmology, halo-model workspace
+TASK: Computes the one-halo matter trispectrum on the (k1,k2) grid of the workspace
+*/
+void ccl_halomod_trispectrum_1h(ccl_cosmology *cosmo, ccl_halomod_workspace *w,
+				double *tk, int *status){
+
+  int n_k = w->n_k, n_m = w->n_m;
+
+  // (M/rho_m)^2 u^2(k,M) for every halo, so that the trispectrum is a weighted
+  // sum of products of two of these
+  double *mu2 = malloc(w->n_a*n_m*n_k*sizeof(double));
+  if (mu2 == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_trispectrum_1h(): memory allocation\n");
+    return;
+  }
+
+  #pragma omp parallel default(none) shared(w,n_k,n_m,mu2,tk)
+  {
+    #pragma omp for collapse(2)
+    for (int ia=0; ia<w->n_a; ia++) {
+      for (int im=0; im<n_m; im++) {
+	ccl_halomod_table *tab = w->tab[ia];
+	double mrho = pow(10, tab->lmass[im])/tab->rho_m;
+	for (int ik=0; ik<n_k; ik++) {
+	  double wk = mrho*w->uk[(ia*n_m+im)*n_k+ik];
+	  mu2[(ia*n_m+im)*n_k+ik] = wk*wk;
+	}
+      }
+    } //end omp for
+
+    // The trispectrum is symmetric, so only k2>=k1 is computed
+    #pragma omp for collapse(2) schedule(dynamic)
+    for (int ia=0; ia<w->n_a; ia++) {
+      for (int ik1=0; ik1<n_k; ik1++) {
+	ccl_halomod_table *tab = w->tab[ia];
+	for (int ik2=ik1; ik2<n_k; ik2++) {
+	  double t = 0;
+	  for (int im=0; im<n_m; im++) {
+	    double *mu2_m = &(mu2[(ia*n_m+im)*n_k]);
+	    t += tab->weight[im]*tab->dndlogm[im]*mu2_m[ik1]*mu2_m[ik2];
+	  }
+	  tk[(ia*n_k+ik1)*n_k+ik2] = t;
+	  tk[(ia*n_k+ik2)*n_k+ik1] = t;
+	}
+      }
+    } //end omp for
+  } //end omp parallel
+
+  free(mu2);
+}
+
+/*----- ROUTINE: ccl_halomod_ssc_response -----
+INPUT: cosmology, halo-model workspace
+TASK: Computes the response of the halo-model matter power spectrum to a
+      super-survey density mode on the grid of the workspace
+*/
+void ccl_halomod_ssc_response(ccl_cosmology *cosmo, ccl_halomod_workspace *w,
+			      double *dpk, int *status){
+
+  int n_k = w->n_k, n_m = w->n_m;
+  double dlk = 0.01;
+
+  // Logarithmic slope of the linear power spectrum, evaluated serially since
+  // the power spectrum splines share their accelerators
+  for (int ia=0; ia<w->n_a; ia++) {
+    for (int ik=0; ik<n_k; ik++) {
+      double pkp = ccl_linear_matter_power(cosmo, exp(w->lk[ik]+dlk), w->a[ia], status);
+      double pkm = ccl_linear_matter_power(cosmo, exp(w->lk[ik]-dlk), w->a[ia], status);
+      dpk[ia*n_k+ik] = 3.+0.5*log(pkp/pkm)/dlk;
+    }
+  }
+  if (*status) {
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halomod_ssc_response(): error evaluating the linear power spectrum\n");
+    return;
+  }
+
+  #pragma omp parallel for collapse(2) default(none) shared(w,n_k,n_m,dpk)
+  for (int ia=0; ia<w->n_a; ia++) {
+    for (int ik=0; ik<n_k; ik++) {
+      ccl_halomod_table *tab = w->tab[ia];
+      double i12 = 0, i_m = w->i_m[ia*n_k+ik];
+
+      for (int im=0; im<n_m; im++) {
+	double wk = pow(10, tab->lmass[im])*w->uk[(ia*n_m+im)*n_k+ik]/tab->rho_m;
+	i12 += tab->weight[im]*tab->dndlogm[im]*tab->bias[im]*wk*wk;
+      }
+
+      dpk[ia*n_k+ik] = (68./21.-dpk[ia*n_k+ik]/3.)*i_m*i_m*w->pk_lin[ia*n_k+ik]+i12;
+    }
+  } //end omp parallel for
+
+}
+
+// Halo catalogues are processed in chunks of this many rows, which are sorted
+// by redshift and split into blocks that are handled by one thread each.
+#define HALO_CATALOG_CHUNK 1048576
+#define HALO_CATALOG_BLOCK 4096
+
+// A row of a halo catalogue chunk, sorted by redshift
+typedef struct {
+  double z;
+  long i;
+} halo_catalog_row;
+
+static int halo_catalog_row_cmp(const void *p1, const void *p2){
+
+  double z1 = ((const halo_catalog_row *)p1)->z;
+  double z2 = ((const halo_catalog_row *)p2)->z;
+
+  return (z1 > z2)-(z1 < z2);
+}
+
+// Annotates the sorted rows [r0,r1) of a catalogue chunk. Consecutive rows at
+// the same redshift share the redshift-dependent parts of the calculation.
+static void halo_catalog_block(ccl_cosmology *cosmo, halo_catalog_row *rows, long r0, long r1,
+			       double *halomass, double odelta, double *dndlogm, double *bias,
+			       double *conc, double *chi, double *mbuf, double *dnbuf, double *bbuf,
+			       int *status){
+
+  long j = r0;
+
+  while ((j < r1) && (*status == 0)) {
+    long n_run = 1;
+    double a = 1./(1.+rows[j].z);
+    double odelta_a, chi_a = 0;
+
+    while ((j+n_run < r1) && (rows[j+n_run].z == rows[j].z))
+      n_run++;
+
+    // Virial haloes if no overdensity was given
+    odelta_a = (odelta > 0) ? odelta : Dv_BryanNorman(cosmo, a, status);
+    if (chi != NULL)
+      chi_a = ccl_comoving_radial_distance(cosmo, a, status);
+
+    for (long l=0; l<n_run; l++)
+      mbuf[l] = halomass[rows[j+l].i];
+    if ((dndlogm != NULL) || (bias != NULL))
+      ccl_massfunc_bias_array(cosmo, (int)n_run, mbuf, a, odelta_a,
+			      dndlogm == NULL ? NULL : dnbuf,
+			      bias == NULL ? NULL : bbuf, status);
+
+    for (long l=0; l<n_run; l++) {
+      long i = rows[j+l].i;
+      if (dndlogm != NULL)
+	dndlogm[i] = dnbuf[l];
+      if (bias != NULL)
+	bias[i] = bbuf[l];
+      if (conc != NULL)
+	conc[i] = ccl_halo_concentration(cosmo, mbuf[l], a, odelta_a, status);
+      if (chi != NULL)
+	chi[i] = chi_a;
+    }
+
+    j += n_run;
+  }
+
+}
+
+/*----- ROUTINE: ccl_halo_catalog_annotate -----
+INPUT: cosmology, halo masses [Msun] and redshifts, halo overdensity (virial if <=0)
+TASK: Computes the mass function, halo bias, concentration and comoving distance
+      for every row of a halo catalogue, in chunks of bounded size
+*/
+void ccl_halo_catalog_annotate(ccl_cosmology *cosmo, long n_halo, double *halomass, double *z,
+			       double odelta, double *dndlogm, double *bias, double *conc,
+			       double *chi, int *status){
+
+  halo_catalog_row *rows;
+
+  if (n_halo <= 0)
+    return;
+
+  // Everything the threads need (distances, growth, sigma(M) and the mass
+  // function parameters) is computed here, by annotating the first row with the
+  // original cosmology. The thread-local copies then only read splines.
+  {
+    halo_catalog_row row0 = {z[0], 0};
+    double m0, dn0, b0;
+    halo_catalog_block(cosmo, &row0, 0, 1, halomass, odelta, dndlogm, bias,
+		       conc, chi, &m0, &dn0, &b0, status);
+  }
+  if (*status)
+    return;
+
+  rows = malloc(CCL_MIN(n_halo, HALO_CATALOG_CHUNK)*sizeof(halo_catalog_row));
+  if (rows == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halo_catalog_annotate(): memory allocation\n");
+    return;
+  }
+
+  for (long i0=0; i0<n_halo; i0+=HALO_CATALOG_CHUNK) {
+    long n_chunk = CCL_MIN(n_halo-i0, HALO_CATALOG_CHUNK);
+    long n_block = (n_chunk+HALO_CATALOG_BLOCK-1)/HALO_CATALOG_BLOCK;
+
+    // Sorting by redshift keeps the interpolation accelerators on the
+    // redshift splines warm, and groups haloes at the same redshift
+    for (long i=0; i<n_chunk; i++) {
+      rows[i].z = z[i0+i];
+      rows[i].i = i0+i;
+    }
+    qsort(rows, n_chunk, sizeof(halo_catalog_row), halo_catalog_row_cmp);
+
+    #pragma omp parallel default(none) \
+      shared(cosmo,rows,n_chunk,n_block,halomass,odelta,dndlogm,bias,conc,chi,status)
+    {
+      int local_status = 0;
+      ccl_cosmology *cosmo_t = ccl_cosmology_thread_copy(cosmo);
+      double *mbuf = malloc(3*HALO_CATALOG_BLOCK*sizeof(double));
+
+      if ((cosmo_t == NULL) || (mbuf == NULL))
+	local_status = CCL_ERROR_MEMORY;
+
+      #pragma omp for schedule(dynamic)
+      for (long ib=0; ib<n_block; ib++) {
+	long r0 = ib*HALO_CATALOG_BLOCK;
+	if (local_status)
+	  continue;
+	halo_catalog_block(cosmo_t, rows, r0, CCL_MIN(r0+HALO_CATALOG_BLOCK, n_chunk),
+			   halomass, odelta, dndlogm, bias, conc, chi, mbuf,
+			   &(mbuf[HALO_CATALOG_BLOCK]), &(mbuf[2*HALO_CATALOG_BLOCK]),
+			   &local_status);
+      } //end omp for
+
+      if (local_status) {
+	#pragma omp critical
+	{
+	  *status = local_status;
+	  if (cosmo_t != NULL)
+	    memcpy(cosmo->status_message, cosmo_t->status_message, sizeof(cosmo->status_message));
+	}
+      }
+      ccl_cosmology_thread_copy_free(cosmo_t);
+      free(mbuf);
+    } //end omp parallel
+
+    if (*status) {
+      if (*status == CCL_ERROR_MEMORY)
+	ccl_cosmology_set_status_message(cosmo, "ccl_halomod.c: ccl_halo_catalog_annotate(): memory allocation\n");
+      break;
+    }
+  }
+
+  free(rows);
+}
@@ -7,6 +7,7 @@
 #include <gsl/gsl_interp.h>
 #include <gsl/gsl_spline.h>
 #include <gsl/gsl_errno.h>
+#include <gsl/gsl_spline2d.h>
 
 #include "ccl.h"
 
@@ -220,25 +221,33 @@ static void ccl_cosmology_compute_hmfparams(ccl_cosmology *cosmo, int *status)
 
 //TODO: some of these are unused, many are included in ccl.h
 
-/*----- ROUTINE: ccl_massfunc_f -----
-INPUT: cosmology+parameters, a halo mass, and scale factor
-TASK: Outputs fitting function for use in halo mass function calculation;
+// Parameters of the mass function and halo bias fitting functions. These only
+// depend on the scale factor and the halo overdensity, so they are computed once
+// for every batch of masses.
+typedef struct {
+  double fit_A, fit_a, fit_b, fit_c, fit_d, fit_p;
+  double fit_B, fit_C;
+  double delta_c;
+  double fail_value; // returned by the scalar functions when the parameters can't be computed
+} hmf_fit_par;
+
+/*----- ROUTINE: massfunc_f_params -----
+INPUT: cosmology+parameters, scale factor, halo overdensity
+TASK: Computes the parameters of the fitting function for use in halo mass function calculation;
   currently only supports:
     ccl_tinker (arxiv 0803.2706 )
     ccl_tinker10 (arxiv 1001.3162 )
     ccl_angulo (arxiv 1203.3216 )
     ccl_watson (arxiv 1212.0095 )
     ccl_shethtormen (arxiv 9901122)
+  Returns 0 on success.
 */
-static double massfunc_f(ccl_cosmology *cosmo, double halomass, double a, double odelta, int *status)
+static int massfunc_f_params(ccl_cosmology *cosmo, double a, double odelta, hmf_fit_par *p, int *status)
 {
-  double fit_A, fit_a, fit_b, fit_c, fit_d, fit_p, overdensity_delta;
   double Omega_m_a;
-  double delta_c_Tinker, nu;
-
-  double sigma=ccl_sigmaM(cosmo, halomass, a, status);
   int gslstatus;
 
+  p->fail_value = NAN;
   switch(cosmo->config.mass_function_method) {
 
   // Equation (10) in arxiv: 9901122
@@ -249,18 +258,17 @@ static double massfunc_f(ccl_cosmology *cosmo, double halomass, double a, double
     if (odelta != Dv_BryanNorman(cosmo, a, status)) {
       *status = CCL_ERROR_HMF_DV;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: massfunc_f(): Sheth-Tormen called with not virial Delta_v\n");
-      return NAN;
+      return 1;
     }
 
     // ST mass function fitting parameters
-    fit_A = 0.21616;
-    fit_p = 0.3;
-    fit_a = 0.707;
+    p->fit_A = 0.21616;
+    p->fit_p = 0.3;
+    p->fit_a = 0.707;
 
     // nu = delta_c(z) / sigma(M)
-    nu = dc_NakamuraSuto(cosmo, a, status)/ccl_sigmaM(cosmo, halomass, a, status);
-
-    return nu*fit_A*(1.+pow(fit_a*pow(nu,2),-fit_p))*exp(-fit_a*pow(nu,2)/2.);
+    p->delta_c = dc_NakamuraSuto(cosmo, a, status);
+    return 0;
 
   case ccl_tinker:
 
@@ -268,7 +276,7 @@ static double massfunc_f(ccl_cosmology *cosmo, double halomass, double a, double
     if ((odelta < 200) || (odelta > 3200)) {
       *status = CCL_ERROR_HMF_INTERP;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: massfunc_f(): Tinker 2008 only supported in range of Delta = 200 to Delta = 3200.\n");
-      return NAN;
+      return 1;
     }
 
     // Compute HMF parameter (alpha, beta, gamma, phi) splines if they haven't
@@ -277,23 +285,23 @@ static double massfunc_f(ccl_cosmology *cosmo, double halomass, double a, double
       ccl_cosmology_compute_hmfparams(cosmo, status);
       ccl_check_status(cosmo, status);
     }
-    gslstatus = gsl_spline_eval_e(cosmo->data.alphahmf, log10(odelta), cosmo->data.accelerator_d,&fit_A);
-    gslstatus |= gsl_spline_eval_e(cosmo->data.betahmf, log10(odelta), cosmo->data.accelerator_d,&fit_a);
-    gslstatus |= gsl_spline_eval_e(cosmo->data.gammahmf, log10(odelta), cosmo->data.accelerator_d,&fit_b);
-    gslstatus |= gsl_spline_eval_e(cosmo->data.phihmf, log10(odelta), cosmo->data.accelerator_d,&fit_c);
-    fit_d = pow(10, -1.0*pow(0.75 / log10(odelta / 75.0), 1.2));
-
-    fit_A = fit_A*pow(a, 0.14);
-    fit_a = fit_a*pow(a, 0.06);
-    fit_b = fit_b*pow(a, fit_d);
+    gslstatus = gsl_spline_eval_e(cosmo->data.alphahmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_A));
+    gslstatus |= gsl_spline_eval_e(cosmo->data.betahmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_a));
+    gslstatus |= gsl_spline_eval_e(cosmo->data.gammahmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_b));
+    gslstatus |= gsl_spline_eval_e(cosmo->data.phihmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_c));
+    p->fit_d = pow(10, -1.0*pow(0.75 / log10(odelta / 75.0), 1.2));
+
+    p->fit_A = p->fit_A*pow(a, 0.14);
+    p->fit_a = p->fit_a*pow(a, 0.06);
+    p->fit_b = p->fit_b*pow(a, p->fit_d);
     if(gslstatus != GSL_SUCCESS) {
       ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: ccl_massfunc_f():");
       *status |= gslstatus;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_massfunc_f(): interpolation error for Tinker MF\n");
-      return NAN;
+      return 1;
     }
-    return fit_A*(pow(sigma/fit_b,-fit_a)+1.0)*exp(-fit_c/sigma/sigma);
-    break;
+    return 0;
+
   case ccl_tinker10:
     // this version uses f(nu) parameterization from Eq. 8 in Tinker et al. 2010
     // use this for consistency with Tinker et al. 2010 fitting function for halo bias
@@ -302,7 +310,8 @@ static double massfunc_f(ccl_cosmology *cosmo, double halomass, double a, double
     if ((odelta < 200) || (odelta > 3200)) {
       *status = CCL_ERROR_HMF_INTERP;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: massfunc_f(): Tinker 2010 only supported in range of Delta = 200 to Delta = 3200.\n");
-      return 0;
+      p->fail_value = 0;
+      return 1;
     }
 
     if (!cosmo->computed_hmfparams) {
@@ -310,71 +319,101 @@ static double massfunc_f(ccl_cosmology *cosmo, double halomass, double a, double
         ccl_check_status(cosmo, status);
     }
     //critical collapse overdensity assumed in this model
-    delta_c_Tinker = 1.686;
-    nu = delta_c_Tinker/(sigma);
-
-    gslstatus = gsl_spline_eval_e(cosmo->data.alphahmf, log10(odelta), cosmo->data.accelerator_d,&fit_A); //alpha in Eq. 8
-    gslstatus |= gsl_spline_eval_e(cosmo->data.etahmf, log10(odelta), cosmo->data.accelerator_d,&fit_a); //eta in Eq. 8
-    gslstatus |= gsl_spline_eval_e(cosmo->data.betahmf, log10(odelta), cosmo->data.accelerator_d,&fit_b); //beta in Eq. 8
-    gslstatus |= gsl_spline_eval_e(cosmo->data.gammahmf, log10(odelta), cosmo->data.accelerator_d,&fit_c); //gamma in Eq. 8
-    gslstatus |= gsl_spline_eval_e(cosmo->data.phihmf, log10(odelta), cosmo->data.accelerator_d,&fit_d); //phi in Eq. 8;
-
-    fit_a *=pow(a, -0.27);
-    fit_b *=pow(a, -0.20);
-    fit_c *=pow(a, 0.01);
-    fit_d *=pow(a, 0.08);
+    p->delta_c = 1.686;
+
+    gslstatus = gsl_spline_eval_e(cosmo->data.alphahmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_A)); //alpha in Eq. 8
+    gslstatus |= gsl_spline_eval_e(cosmo->data.etahmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_a)); //eta in Eq. 8
+    gslstatus |= gsl_spline_eval_e(cosmo->data.betahmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_b)); //beta in Eq. 8
+    gslstatus |= gsl_spline_eval_e(cosmo->data.gammahmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_c)); //gamma in Eq. 8
+    gslstatus |= gsl_spline_eval_e(cosmo->data.phihmf, log10(odelta), cosmo->data.accelerator_d,&(p->fit_d)); //phi in Eq. 8;
+
+    p->fit_a *=pow(a, -0.27);
+    p->fit_b *=pow(a, -0.20);
+    p->fit_c *=pow(a, 0.01);
+    p->fit_d *=pow(a, 0.08);
     if(gslstatus != GSL_SUCCESS) {
       ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: ccl_massfunc_f():");
       *status |= gslstatus;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_massfunc_f(): interpolation error for Tinker 2010 MF\n");
-      return NAN;
+      return 1;
     }
-    return nu*fit_A*(1.+pow(fit_b*nu,-2.*fit_d))*pow(nu, 2.*fit_a)*exp(-0.5*fit_c*nu*nu);
-    break;
+    return 0;
 
   case ccl_watson:
     if(odelta!=200.) {
       *status = CCL_ERROR_HMF_INTERP;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_massfunc_f(): Watson HMF only supported for Delta = 200.\n");
-      return NAN;
+      return 1;
     }
     // these parameters from: Angulo et al 2012 (arxiv 1203.3216 )
     Omega_m_a = ccl_omega_x(cosmo, a, ccl_species_m_label,status);
-    fit_A = Omega_m_a*(0.990*pow(a,3.216)+0.074);
-    fit_a = Omega_m_a*(5.907*pow(a,3.599)+2.344);
-    fit_b = Omega_m_a*(3.136*pow(a,3.058)+2.349);
-    fit_c = 1.318;
-
-    return fit_A*(pow(sigma/fit_b,-fit_a)+1.0)*exp(-fit_c/sigma/sigma);
+    p->fit_A = Omega_m_a*(0.990*pow(a,3.216)+0.074);
+    p->fit_a = Omega_m_a*(5.907*pow(a,3.599)+2.344);
+    p->fit_b = Omega_m_a*(3.136*pow(a,3.058)+2.349);
+    p->fit_c = 1.318;
+    return 0;
 
   case ccl_angulo:
     if(odelta!=200.) {
       *status = CCL_ERROR_HMF_INTERP;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_massfunc_f(): Angulo HMF only supported for Delta = 200.\n");
-      return NAN;
+      return 1;
     }
     // these parameters from: Watson et al 2012 (arxiv 1212.0095 )
-    fit_A = 0.201;
-    fit_a = 2.08;
-    fit_b = 1.7;
-    fit_c = 1.172;
-
-    return fit_A*pow( (fit_a/sigma)+1.0, fit_b)*exp(-fit_c/sigma/sigma);
+    p->fit_A = 0.201;
+    p->fit_a = 2.08;
+    p->fit_b = 1.7;
+    p->fit_c = 1.172;
+    return 0;
 
   default:
     *status = CCL_ERROR_MF;
     ccl_cosmology_set_status_message(cosmo ,
 	    "ccl_massfunc.c: ccl_massfunc(): Unknown or non-implemented mass function method: %d \n",
 	    cosmo->config.mass_function_method);
+    return 1;
+  }
+}
+
+/*----- ROUTINE: massfunc_f_eval -----
+INPUT: cosmology, fitting function parameters, sigma(M,a)
+TASK: Outputs fitting function for use in halo mass function calculation
+*/
+static double massfunc_f_eval(ccl_cosmology *cosmo, hmf_fit_par *p, double sigma)
+{
+  double nu;
+
+  switch(cosmo->config.mass_function_method) {
+
+  case ccl_shethtormen:
+    nu = p->delta_c/sigma;
+    return nu*p->fit_A*(1.+pow(p->fit_a*pow(nu,2),-p->fit_p))*exp(-p->fit_a*pow(nu,2)/2.);
+
+  case ccl_tinker:
+  case ccl_watson:
+    return p->fit_A*(pow(sigma/p->fit_b,-p->fit_a)+1.0)*exp(-p->fit_c/sigma/sigma);
+
+  case ccl_tinker10:
+    nu = p->delta_c/(sigma);
+    return nu*p->fit_A*(1.+pow(p->fit_b*nu,-2.*p->fit_d))*pow(nu, 2.*p->fit_a)*exp(-0.5*p->fit_c*nu*nu);
+
+  case ccl_angulo:
+    return p->fit_A*pow( (p->fit_a/sigma)+1.0, p->fit_b)*exp(-p->fit_c/sigma/sigma);
+
+  default:
     return NAN;
   }
 }
 
-static double ccl_halo_b1(ccl_cosmology *cosmo, double halomass, double a, double odelta, int *status)
+/*----- ROUTINE: halo_b1_params -----
+INPUT: cosmology+parameters, scale factor, halo overdensity
+TASK: Computes the parameters of the halo bias fitting function. Returns 0 on success.
+*/
+static int halo_b1_params(ccl_cosmology *cosmo, double a, double odelta, hmf_fit_par *p, int *status)
 {
-  double fit_A, fit_B, fit_C, fit_a, fit_b, fit_c, fit_p, overdensity_delta, y;
-  double delta_c_Tinker, nu;
-  double sigma=ccl_sigmaM(cosmo,halomass,a, status);
+  double y;
+
+  p->fail_value = NAN;
   switch(cosmo->config.mass_function_method) {
 
   // Equation (12) in  arXiv: 9901122
@@ -386,47 +425,232 @@ static double ccl_halo_b1(ccl_cosmology *cosmo, double halomass, double a, doubl
     if (odelta != Dv_BryanNorman(cosmo, a, status)) {
       *status = CCL_ERROR_HMF_DV;
       ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: halo_b1(): Sheth-Tormen called with not virial Delta_v\n");
-      return NAN;
+      return 1;
     }
 
     // ST bias fitting parameters (which are the same as for the mass function)
-    fit_p = 0.3;
-    fit_a = 0.707;
+    p->fit_p = 0.3;
+    p->fit_a = 0.707;
 
-    // Cosmology dependent delta_c and nu
-    double delta_c = dc_NakamuraSuto(cosmo, a, status);
-    nu = delta_c/ccl_sigmaM(cosmo, halomass, a, status);
-
-    return 1.+(fit_a*pow(nu,2)-1.+2.*fit_p/(1.+pow(fit_a*pow(nu,2),fit_p)))/delta_c;
+    // Cosmology dependent delta_c
+    p->delta_c = dc_NakamuraSuto(cosmo, a, status);
+    return 0;
 
     //this version uses b(nu) parameterization, Eq. 6 in Tinker et al. 2010
     // use this for consistency with Tinker et al. 2010 fitting function for halo bias
   case ccl_tinker10:
     y = log10(odelta);
     //critical collapse overdensity assumed in this model
-    delta_c_Tinker = 1.686;
-    //peak height - note that this factorization is incorrect for e.g. massive neutrino cosmologies
-    nu = delta_c_Tinker/(sigma);
+    p->delta_c = 1.686;
     // Table 2 in https://arxiv.org/pdf/1001.3162.pdf
-    fit_A = 1.0 + 0.24*y*exp(-pow(4./y,4.));
-    fit_a = 0.44*y-0.88;
-    fit_B = 0.183;
-    fit_b = 1.5;
-    fit_C = 0.019+0.107*y+0.19*exp(-pow(4./y,4.));
-    fit_c = 2.4;
-
-    return 1.-fit_A*pow(nu,fit_a)/(pow(nu,fit_a)+pow(delta_c_Tinker,fit_a))+fit_B*pow(nu,fit_b)+fit_C*pow(nu,fit_c);
-    break;
+    p->fit_A = 1.0 + 0.24*y*exp(-pow(4./y,4.));
+    p->fit_a = 0.44*y-0.88;
+    p->fit_B = 0.183;
+    p->fit_b = 1.5;
+    p->fit_C = 0.019+0.107*y+0.19*exp(-pow(4./y,4.));
+    p->fit_c = 2.4;
+    return 0;
 
   default:
     *status = CCL_ERROR_MF;
     ccl_cosmology_set_status_message(cosmo ,
 	    "ccl_massfunc.c: ccl_halo_b1(): No b(M) fitting function implemented for mass_function_method: %d \n",
       cosmo->config.mass_function_method);
+    p->fail_value = 0;
+    return 1;
+  }
+}
+
+/*----- ROUTINE: halo_b1_eval -----
+INPUT: cosmology, fitting function parameters, sigma(M,a)
+TASK: Outputs the linear halo bias fitting function
+*/
+static double halo_b1_eval(ccl_cosmology *cosmo, hmf_fit_par *p, double sigma)
+{
+  //peak height - note that this factorization is incorrect for e.g. massive neutrino cosmologies
+  double nu = p->delta_c/sigma;
+
+  switch(cosmo->config.mass_function_method) {
+
+  case ccl_shethtormen:
+    return 1.+(p->fit_a*pow(nu,2)-1.+2.*p->fit_p/(1.+pow(p->fit_a*pow(nu,2),p->fit_p)))/p->delta_c;
+
+  case ccl_tinker10:
+    return 1.-p->fit_A*pow(nu,p->fit_a)/(pow(nu,p->fit_a)+pow(p->delta_c,p->fit_a))+
+      p->fit_B*pow(nu,p->fit_b)+p->fit_C*pow(nu,p->fit_c);
+
+  default:
     return 0;
   }
 }
 
+static double massfunc_f(ccl_cosmology *cosmo, double halomass, double a, double odelta, int *status)
+{
+  hmf_fit_par p;
+
+  if (massfunc_f_params(cosmo, a, odelta, &p, status))
+    return p.fail_value;
+
+  return massfunc_f_eval(cosmo, &p, ccl_sigmaM(cosmo, halomass, a, status));
+}
+
+static double ccl_halo_b1(ccl_cosmology *cosmo, double halomass, double a, double odelta, int *status)
+{
+  hmf_fit_par p;
+
+  if (halo_b1_params(cosmo, a, odelta, &p, status))
+    return p.fail_value;
+
+  return halo_b1_eval(cosmo, &p, ccl_sigmaM(cosmo, halomass, a, status));
+}
+
+/*----- ROUTINE: tophat_window -----
+INPUT: x=kR
+TASK: returns the top-hat window W(x)=3[sin(x)-x*cos(x)]/x^3 and x*dW/dx
+*/
+static void tophat_window(double x, double *w, double *xdw)
+{
+  double x2 = x*x;
+
+  // Maclaurin expansions, to avoid the cancellation between the two terms at low x
+  if (x < 0.1) {
+    *w = 1. + x2*(-1./10. + x2*(1./280. + x2*(-1./15120. + x2/1330560.)));
+    *xdw = x2*(-1./5. + x2*(1./70. + x2*(-1./2520. + x2/166320.)));
+  }
+  else {
+    double sx = sin(x), cx = cos(x);
+    *w = 3.*(sx - x*cx)/(x2*x);
+    *xdw = 3.*((x2 - 3.)*sx + 3.*x*cx)/(x2*x);
+  }
+}
+
+/*----- ROUTINE: sigma_transform -----
+INPUT: ccl_cosmology * cosmo, nm nodes in log10(M), na scale factors
+TASK: computes log10(sigma(M,a)) and dln(1/sigma)/dlog10(M) at every (a,M), stored as [ia*nm+im].
+  sigma^2 and its derivative with respect to ln(R) come out of the same Simpson integration in
+  ln(k), using the top-hat window and its analytic derivative, and P_lin(k,a) is only evaluated
+  once on the k grid for all masses. Masses are spread over threads.
+*/
+static void sigma_transform(ccl_cosmology *cosmo, int nm, double *lm, int na, double *a_arr,
+			    double *lsig, double *dlns, int *status)
+{
+  int nk = ccl_get_pk_simpson_nk(cosmo);
+  double *lk, *pk, *radius, *s2;
+
+  lk = malloc(3*nk*sizeof(double));
+  pk = malloc(nk*na*sizeof(double));
+  radius = malloc(nm*sizeof(double));
+  s2 = malloc(2*na*nm*sizeof(double));
+  if ((lk == NULL) || (pk == NULL) || (radius == NULL) || (s2 == NULL)) {
+    free(lk);
+    free(pk);
+    free(radius);
+    free(s2);
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: sigma_transform(): memory allocation\n");
+    return;
+  }
+  double *k = &(lk[nk]);
+  double *wk = &(lk[2*nk]);
+
+  ccl_get_pk_simpson_lk_array(cosmo, nk, lk, wk, status);
+
+  // k^3 P(k,a)/(2 pi^2) times the integration weights, stored as pk[ik*na+ia]. This is done
+  // serially, since the power spectrum splines share their accelerators
+  if (*status == 0) {
+    for (int ik=0; ik<nk; ik++) {
+      k[ik] = exp(lk[ik]);
+      double wp = wk[ik]*k[ik]*k[ik]*k[ik]/(2.*M_PI*M_PI);
+      for (int ia=0; ia<na; ia++)
+        pk[ik*na+ia] = wp*ccl_linear_matter_power(cosmo, k[ik], a_arr[ia], status);
+    }
+    for (int im=0; im<nm; im++)
+      radius[im] = ccl_massfunc_m2r(cosmo, pow(10, lm[im]), status);
+    if (*status)
+      ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: sigma_transform(): error evaluating the linear power spectrum\n");
+  }
+
+  if (*status == 0) {
+    #pragma omp parallel for default(none) \
+      shared(nm, na, nk, k, pk, radius, s2, lsig, dlns)
+    for (int im=0; im<nm; im++) {
+      // sigma^2 and dsigma^2/dlnR at all scale factors for this mass
+      double *s2_m = &(s2[2*na*im]);
+      for (int ia=0; ia<2*na; ia++)
+        s2_m[ia] = 0;
+      for (int ik=0; ik<nk; ik++) {
+        double w, xdw;
+        tophat_window(k[ik]*radius[im], &w, &xdw);
+        for (int ia=0; ia<na; ia++) {
+          s2_m[ia] += pk[ik*na+ia]*w*w;
+          s2_m[na+ia] += pk[ik*na+ia]*2.*w*xdw;
+        }
+      }
+
+      // dlnR/dlog10(M) = ln(10)/3
+      for (int ia=0; ia<na; ia++) {
+        lsig[ia*nm+im] = 0.5*log10(s2_m[ia]);
+        dlns[ia*nm+im] = -M_LN10*s2_m[na+ia]/(6.*s2_m[ia]);
+      }
+    } //end omp parallel for
+  }
+
+  free(lk);
+  free(pk);
+  free(radius);
+  free(s2);
+}
+
+/*----- ROUTINE: compute_sigma_2d -----
+INPUT: ccl_cosmology * cosmo, nm nodes in log10(M)
+TASK: tabulates log10(sigma(M,a)) and dln(1/sigma)/dlog10(M) on the mass nodes and on the
+  scale factor nodes of the linear power spectrum, directly from P_lin(k,a), so no assumption
+  of scale-independent growth is made.
+*/
+static void compute_sigma_2d(ccl_cosmology *cosmo, int nm, double *lm, int *status)
+{
+  int na = ccl_get_pk_spline_na(cosmo);
+  double *a_arr, *y;
+  gsl_spline2d *logsigma = NULL, *dlnsigma_dlogm = NULL;
+
+  a_arr = malloc(na*sizeof(double));
+  y = malloc(2*na*nm*sizeof(double));
+  if ((a_arr == NULL) || (y == NULL)) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: compute_sigma_2d(): memory allocation\n");
+  }
+
+  if (*status == 0)
+    ccl_get_pk_spline_a_array(cosmo, na, a_arr, status);
+  if (*status == 0)
+    sigma_transform(cosmo, nm, lm, na, a_arr, y, &(y[na*nm]), status);
+
+  if (*status == 0) {
+    logsigma = gsl_spline2d_alloc(gsl_interp2d_bicubic, nm, na);
+    dlnsigma_dlogm = gsl_spline2d_alloc(gsl_interp2d_bicubic, nm, na);
+    if ((logsigma == NULL) || (dlnsigma_dlogm == NULL) ||
+        gsl_spline2d_init(logsigma, lm, a_arr, y, nm, na) ||
+        gsl_spline2d_init(dlnsigma_dlogm, lm, a_arr, &(y[na*nm]), nm, na)) {
+      *status = CCL_ERROR_SPLINE;
+      ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: compute_sigma_2d(): Error creating sigma(M,a) splines\n");
+    }
+  }
+
+  if (*status == 0) {
+    if (cosmo->data.accelerator_m == NULL)
+      cosmo->data.accelerator_m = gsl_interp_accel_alloc();
+    cosmo->data.logsigma_2d = logsigma;
+    cosmo->data.dlnsigma_dlogm_2d = dlnsigma_dlogm;
+  }
+  else {
+    gsl_spline2d_free(logsigma);
+    gsl_spline2d_free(dlnsigma_dlogm);
+  }
+
+  free(a_arr);
+  free(y);
+}
+
 void ccl_cosmology_compute_sigma(ccl_cosmology *cosmo, int *status)
 {
   if(cosmo->computed_sigma)
@@ -437,14 +661,11 @@ void ccl_cosmology_compute_sigma(ccl_cosmology *cosmo, int *status)
   double * m = ccl_linear_spacing(cosmo->spline_params.LOGM_SPLINE_MIN, cosmo->spline_params.LOGM_SPLINE_MAX, nm);
 
   // create space for y, to be filled with sigma and dlnsigma_dlogm
-  double * y = malloc(sizeof(double)*nm);
-  double smooth_radius;
-  double na, nb;
+  double * y = malloc(sizeof(double)*2*nm);
 
   // start up of GSL pointers
-  int gslstatus = 0;
-  gsl_spline *logsigma;
-  gsl_spline *dlnsigma_dlogm;
+  gsl_spline *logsigma = NULL;
+  gsl_spline *dlnsigma_dlogm = NULL;
 
   if (m==NULL ||
       (fabs(m[0]-cosmo->spline_params.LOGM_SPLINE_MIN)>1e-5) ||
@@ -454,86 +675,66 @@ void ccl_cosmology_compute_sigma(ccl_cosmology *cosmo, int *status)
     *status = CCL_ERROR_LINSPACE;
     ccl_cosmology_set_status_message(cosmo,"ccl_cosmology_compute_sigmas(): Error creating linear spacing in m\n");
   }
-
-  // fill in sigma, if no errors have been triggered at this time.
-  if (*status == 0) {
-    for (int i=0; i<nm; i++) {
-      smooth_radius = ccl_massfunc_m2r(cosmo, pow(10,m[i]), status);
-      y[i] = log10(ccl_sigmaR(cosmo, smooth_radius, 1., status));
-    }
-    logsigma = gsl_spline_alloc(cosmo->spline_params.M_SPLINE_TYPE, nm);
-    *status = gsl_spline_init(logsigma, m, y, nm);
+  if ((*status == 0) && (y == NULL)) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo,"ccl_cosmology_compute_sigmas(): memory allocation\n");
   }
 
-  if (*status !=0 ) {
-    *status = CCL_ERROR_SPLINE ;
-    ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_cosmology_compute_sigma(): Error creating sigma(M) spline\n");
+  // With scale-dependent growth sigma(M) can't be obtained by rescaling its value at z=0
+  if ((*status == 0) &&
+      (cosmo->spline_params.SIGMA_SPLINE_2D || (cosmo->params.N_nu_mass>0))) {
+    compute_sigma_2d(cosmo, nm, m, status);
+    cosmo->computed_sigma = (*status == 0);
+    free(m);
+    free(y);
+    return;
   }
 
-  // again, making splines assuming nothing bad has happened to this point
-
-  if (*status == 0 ) {
-    for (int i=0; i<nm; i++) {
-      if(i==0) {
-        gslstatus |= gsl_spline_eval_e(logsigma, m[i], NULL,&na);
-        gslstatus |= gsl_spline_eval_e(logsigma, m[i]+cosmo->spline_params.LOGM_SPLINE_DELTA/2., NULL,&nb);
-        y[i] = (na-nb)*log(10.);
-        y[i] = 2.*y[i] / cosmo->spline_params.LOGM_SPLINE_DELTA;
-      }
-      else if (i==nm-1) {
-        gslstatus |= gsl_spline_eval_e(logsigma, m[i]-cosmo->spline_params.LOGM_SPLINE_DELTA/2., NULL,&na);
-        gslstatus |= gsl_spline_eval_e(logsigma, m[i], NULL,&nb);
-        y[i] = (na-nb)*log(10.);
-        y[i] = 2.*y[i] / cosmo->spline_params.LOGM_SPLINE_DELTA;
-      }
-      else {
-        gslstatus |= gsl_spline_eval_e(logsigma, m[i]-cosmo->spline_params.LOGM_SPLINE_DELTA/2., NULL,&na);
-        gslstatus |= gsl_spline_eval_e(logsigma, m[i]+cosmo->spline_params.LOGM_SPLINE_DELTA/2., NULL,&nb);
-        y[i] = (na-nb)*log(10.);
-        y[i] = y[i] / cosmo->spline_params.LOGM_SPLINE_DELTA;
-      }
-    }
+  // sigma and its exact logarithmic derivative at a=1, if no errors have been triggered at this time.
+  if (*status == 0) {
+    double a1 = 1.;
+    sigma_transform(cosmo, nm, m, 1, &a1, y, &(y[nm]), status);
   }
 
-  if(gslstatus != GSL_SUCCESS) {
-    ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: ccl_cosmology_compute_sigma():");
-    *status |= gslstatus;
-    *status = CCL_ERROR_SPLINE ;
-    ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_cosmology_compute_sigma(): Error evaluating grid points for dlnsigma/dlogM spline\n");
+  if (*status == 0) {
+    logsigma = gsl_spline_alloc(cosmo->spline_params.M_SPLINE_TYPE, nm);
+    *status = gsl_spline_init(logsigma, m, y, nm);
+    if (*status !=0 ) {
+      *status = CCL_ERROR_SPLINE ;
+      ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_cosmology_compute_sigma(): Error creating sigma(M) spline\n");
+    }
   }
 
   if(*status==0) {
     dlnsigma_dlogm = gsl_spline_alloc(cosmo->spline_params.M_SPLINE_TYPE, nm);
-    *status = gsl_spline_init(dlnsigma_dlogm, m, y, nm);
-    if(cosmo->data.accelerator_m==NULL)
+    *status = gsl_spline_init(dlnsigma_dlogm, m, &(y[nm]), nm);
+    if(*status!=0) {
+      *status = CCL_ERROR_SPLINE ;
+      ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_cosmology_compute_sigma(): Error creating dlnsigma/dlogM spline\n");
+    }
+    else if(cosmo->data.accelerator_m==NULL)
       cosmo->data.accelerator_m=gsl_interp_accel_alloc();
   }
 
-  if(*status!=0) {
-    *status = CCL_ERROR_SPLINE ;
-    ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_cosmology_compute_sigma(): Error creating dlnsigma/dlogM spline\n");
-  }
-
-
-  cosmo->data.logsigma = logsigma;
-  cosmo->data.dlnsigma_dlogm = dlnsigma_dlogm;
-  cosmo->computed_sigma = true;
-
   free(m);
   free(y);
   if(*status != 0) {
     gsl_spline_free(logsigma);
     gsl_spline_free(dlnsigma_dlogm);
+    return;
   }
-  return;
+
+  cosmo->data.logsigma = logsigma;
+  cosmo->data.dlnsigma_dlogm = dlnsigma_dlogm;
+  cosmo->computed_sigma = true;
 }
 
 /*----- ROUTINE: ccl_dlninvsig_dlogm -----
-INPUT: ccl_cosmology *cosmo, double halo mass in units of Msun
+INPUT: ccl_cosmology *cosmo, double halo mass in units of Msun, double scale factor
 TASK: returns the value of the derivative of ln(sigma^-1) with respect to log10 in halo mass.
 */
 
-static double ccl_dlninvsig_dlogm(ccl_cosmology *cosmo, double halomass, int*status)
+static double ccl_dlninvsig_dlogm(ccl_cosmology *cosmo, double halomass, double a, int*status)
 {
   if (!cosmo->computed_sigma) {
     ccl_cosmology_compute_sigma(cosmo, status);
@@ -544,7 +745,12 @@ static double ccl_dlninvsig_dlogm(ccl_cosmology *cosmo, double halomass, int*sta
 
   logmass = log10(halomass);
 
-  int gslstatus = gsl_spline_eval_e(cosmo->data.dlnsigma_dlogm, logmass, cosmo->data.accelerator_m,&val);
+  int gslstatus;
+  if (cosmo->data.dlnsigma_dlogm_2d != NULL)
+    gslstatus = gsl_spline2d_eval_e(cosmo->data.dlnsigma_dlogm_2d, logmass, a,
+                                    cosmo->data.accelerator_m, NULL, &val);
+  else
+    gslstatus = gsl_spline_eval_e(cosmo->data.dlnsigma_dlogm, logmass, cosmo->data.accelerator_m,&val);
   if(gslstatus != GSL_SUCCESS) {
     ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: ccl_massfunc():");
     *status |= gslstatus;
@@ -560,18 +766,12 @@ TASK: returns halo mass function as dn/dlog10(m) in comoving Msun^-1 Mpc^-3 (hal
 */
 double ccl_massfunc(ccl_cosmology *cosmo, double halomass, double a, double odelta, int *status)
 {
-  if (cosmo->params.N_nu_mass>0){
-	  *status = CCL_ERROR_NOT_IMPLEMENTED;
-	  ccl_cosmology_set_status_message(cosmo, "ccl_background.c: ccl_cosmology_compute_growth(): Support for the halo mass function in cosmologies with massive neutrinos is not yet implemented.\n");
-	  return NAN;
-  }
-
   double f, rho_m;
 
   rho_m = ccl_constants.RHO_CRITICAL*cosmo->params.Omega_m*cosmo->params.h*cosmo->params.h;
   f=massfunc_f(cosmo,halomass,a,odelta,status);
 
-  return f*rho_m*ccl_dlninvsig_dlogm(cosmo,halomass,status)/halomass;
+  return f*rho_m*ccl_dlninvsig_dlogm(cosmo,halomass,a,status)/halomass;
 }
 
 /*----- ROUTINE: ccl_halob1 -----
@@ -580,13 +780,6 @@ TASK: returns dimensionless linear halo bias
 */
 double ccl_halo_bias(ccl_cosmology *cosmo, double halomass, double a, double odelta, int *status)
 {
-  if (cosmo->params.N_nu_mass>0){
-	  *status = CCL_ERROR_NOT_IMPLEMENTED;
-	  ccl_cosmology_set_status_message(cosmo, "ccl_background.c: ccl_cosmology_compute_growth(): Support for the halo bias in cosmologies with massive neutrinos is not yet implemented.\n");
-	  return NAN;
-  }
-
-
   if (!cosmo->computed_sigma) {
     ccl_cosmology_compute_sigma(cosmo, status);
     ccl_check_status(cosmo, status);
@@ -622,12 +815,6 @@ necessary.
 */
 double ccl_sigmaM(ccl_cosmology *cosmo, double halomass, double a, int *status)
 {
-  if (cosmo->params.N_nu_mass>0){
-	  *status = CCL_ERROR_NOT_IMPLEMENTED;
-	  ccl_cosmology_set_status_message(cosmo, "ccl_background.c: ccl_cosmology_compute_growth(): Support for the sigma(M) function in cosmologies with massive neutrinos is not yet implemented.\n");
-	  return NAN;
-  }
-
   double sigmaM;
   // Check if sigma has already been calculated
   if (!cosmo->computed_sigma) {
@@ -636,10 +823,23 @@ double ccl_sigmaM(ccl_cosmology *cosmo, double halomass, double a, int *status)
   }
 
   double lgsigmaM;
+  int gslstatus;
 
-  int gslstatus = gsl_spline_eval_e(cosmo->data.logsigma,
-                                    log10(halomass),
-                                    cosmo->data.accelerator_m,&lgsigmaM);
+  // A single bicubic lookup if sigma(M,a) has been tabulated
+  if (cosmo->data.logsigma_2d != NULL) {
+    gslstatus = gsl_spline2d_eval_e(cosmo->data.logsigma_2d, log10(halomass), a,
+                                    cosmo->data.accelerator_m, NULL, &lgsigmaM);
+    if(gslstatus != GSL_SUCCESS) {
+      ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: ccl_sigmaM():");
+      *status |= gslstatus;
+    }
+    ccl_check_status(cosmo, status);
+    return pow(10,lgsigmaM);
+  }
+
+  gslstatus = gsl_spline_eval_e(cosmo->data.logsigma,
+                                log10(halomass),
+                                cosmo->data.accelerator_m,&lgsigmaM);
 
   if(gslstatus != GSL_SUCCESS) {
     ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: ccl_sigmaM():");
@@ -651,3 +851,177 @@ double ccl_sigmaM(ccl_cosmology *cosmo, double halomass, double a, int *status)
   ccl_check_status(cosmo, status);
   return sigmaM;
 }
+
+/*----- ROUTINE: massfunc_sigma_table -----
+INPUT: ccl_cosmology * cosmo, n_m halo masses in units of Msun
+TASK: returns sigma(M) at a=1 and dln(1/sigma)/dlog10(M), which only depend on mass.
+  Nothing is filled in if sigma(M,a) has been tabulated, see massfunc_sigma_at.
+*/
+static int massfunc_sigma_table(ccl_cosmology *cosmo, int n_m, double *halomass,
+				double *sigma0, double *dlns, int *status)
+{
+  int gslstatus = GSL_SUCCESS;
+
+  if (!cosmo->computed_sigma) {
+    ccl_cosmology_compute_sigma(cosmo, status);
+    ccl_check_status(cosmo, status);
+    if (*status)
+      return 1;
+  }
+
+  if (cosmo->data.logsigma_2d != NULL)
+    return 0;
+
+  for (int i=0; i<n_m; i++) {
+    double logmass = log10(halomass[i]);
+    gslstatus |= gsl_spline_eval_e(cosmo->data.logsigma, logmass, cosmo->data.accelerator_m, &(sigma0[i]));
+    gslstatus |= gsl_spline_eval_e(cosmo->data.dlnsigma_dlogm, logmass, cosmo->data.accelerator_m, &(dlns[i]));
+    sigma0[i] = pow(10, sigma0[i]);
+  }
+
+  if(gslstatus != GSL_SUCCESS) {
+    ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: massfunc_sigma_table():");
+    *status |= gslstatus;
+    ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: massfunc_sigma_table(): interpolation error for sigma(M)\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+/*----- ROUTINE: massfunc_sigma_at -----
+INPUT: ccl_cosmology * cosmo, n_m halo masses in units of Msun with the output of
+  massfunc_sigma_table, scale factor
+TASK: returns sigma(M,a), and updates dln(1/sigma)/dlog10(M) if it depends on a
+*/
+static int massfunc_sigma_at(ccl_cosmology *cosmo, int n_m, double *halomass, double *sigma0,
+			     double a, double *sigma, double *dlns, int *status)
+{
+  if (cosmo->data.logsigma_2d != NULL) {
+    int gslstatus = GSL_SUCCESS;
+    for (int i=0; i<n_m; i++) {
+      double logmass = log10(halomass[i]);
+      gslstatus |= gsl_spline2d_eval_e(cosmo->data.logsigma_2d, logmass, a,
+				       cosmo->data.accelerator_m, NULL, &(sigma[i]));
+      gslstatus |= gsl_spline2d_eval_e(cosmo->data.dlnsigma_dlogm_2d, logmass, a,
+				       cosmo->data.accelerator_m, NULL, &(dlns[i]));
+      sigma[i] = pow(10, sigma[i]);
+    }
+    if(gslstatus != GSL_SUCCESS) {
+      ccl_raise_gsl_warning(gslstatus, "ccl_massfunc.c: massfunc_sigma_at():");
+      *status |= gslstatus;
+      ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: massfunc_sigma_at(): interpolation error for sigma(M,a)\n");
+      return 1;
+    }
+  }
+  else {
+    double growth = ccl_growth_factor(cosmo, a, status);
+    if (*status)
+      return 1;
+    for (int i=0; i<n_m; i++)
+      sigma[i] = sigma0[i]*growth;
+  }
+
+  return 0;
+}
+
+/*----- ROUTINE: massfunc_bias_at -----
+INPUT: ccl_cosmology * cosmo, n_m halo masses with their sigma(M,a) and dln(1/sigma)/dlog10(M),
+  scale factor, halo overdensity
+TASK: fills dn/dlog10(m) and the linear halo bias (either may be NULL) at a single scale factor
+*/
+static void massfunc_bias_at(ccl_cosmology *cosmo, int n_m, double *halomass, double *sigma,
+			     double *dlns, double a, double odelta,
+			     double *dndlogm, double *bias, int *status)
+{
+  hmf_fit_par pf, pb;
+  double rho_m = ccl_constants.RHO_CRITICAL*cosmo->params.Omega_m*cosmo->params.h*cosmo->params.h;
+
+  // On failure the outputs are filled with the values the scalar functions return
+  if ((dndlogm != NULL) && massfunc_f_params(cosmo, a, odelta, &pf, status)) {
+    for (int i=0; i<n_m; i++)
+      dndlogm[i] = pf.fail_value;
+    return;
+  }
+  if ((bias != NULL) && halo_b1_params(cosmo, a, odelta, &pb, status)) {
+    for (int i=0; i<n_m; i++)
+      bias[i] = pb.fail_value;
+    return;
+  }
+  if (*status)
+    return;
+
+  for (int i=0; i<n_m; i++) {
+    if (dndlogm != NULL)
+      dndlogm[i] = massfunc_f_eval(cosmo, &pf, sigma[i])*rho_m*dlns[i]/halomass[i];
+    if (bias != NULL)
+      bias[i] = halo_b1_eval(cosmo, &pb, sigma[i]);
+  }
+}
+
+/*----- ROUTINE: ccl_massfunc_bias_array -----
+INPUT: ccl_cosmology * cosmo, n_m halo masses in units of Msun, scale factor, halo overdensity
+TASK: returns the halo mass function as dn/dlog10(m) and the dimensionless linear halo bias
+  for all masses; either output may be NULL
+*/
+void ccl_massfunc_bias_array(ccl_cosmology *cosmo, int n_m, double *halomass, double a, double odelta,
+			     double *dndlogm, double *bias, int *status)
+{
+  ccl_massfunc_bias_grid(cosmo, 1, &a, &odelta, n_m, halomass, dndlogm, bias, status);
+}
+
+/*----- ROUTINE: ccl_massfunc_bias_grid -----
+INPUT: ccl_cosmology * cosmo, n_a scale factors with their halo overdensities, n_m halo masses
+  in units of Msun
+TASK: returns dn/dlog10(m) and the linear halo bias at every (a,M), stored as [ia*n_m+im];
+  either output may be NULL. The interpolation in mass is only done once,
+  unless sigma(M,a) has been tabulated.
+*/
+void ccl_massfunc_bias_grid(ccl_cosmology *cosmo, int n_a, double *a, double *odelta,
+			    int n_m, double *halomass, double *dndlogm, double *bias, int *status)
+{
+  double *sigma0 = malloc(3*n_m*sizeof(double));
+  double *sigma, *dlns;
+
+  if (sigma0 == NULL) {
+    *status = CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_massfunc.c: ccl_massfunc_bias_grid(): memory allocation\n");
+    return;
+  }
+  sigma = &(sigma0[n_m]);
+  dlns = &(sigma0[2*n_m]);
+
+  if (massfunc_sigma_table(cosmo, n_m, halomass, sigma0, dlns, status) == 0) {
+    for (int ia=0; ia<n_a; ia++) {
+      if (massfunc_sigma_at(cosmo, n_m, halomass, sigma0, a[ia], sigma, dlns, status))
+	break;
+      massfunc_bias_at(cosmo, n_m, halomass, sigma, dlns, a[ia], odelta[ia],
+		       dndlogm == NULL ? NULL : &(dndlogm[ia*n_m]),
+		       bias == NULL ? NULL : &(bias[ia*n_m]), status);
+      if (*status)
+	break;
+    }
+  }
+
+  free(sigma0);
+}
+
+/*----- ROUTINE: ccl_massfunc_array -----
+INPUT: ccl_cosmology * cosmo, n_m halo masses in units of Msun, scale factor, halo overdensity
+TASK: returns halo mass function as dn/dlog10(m) for all masses
+*/
+void ccl_massfunc_array(ccl_cosmology *cosmo, int n_m, double *halomass, double a, double odelta,
+			double *dndlogm, int *status)
+{
+  ccl_massfunc_bias_array(cosmo, n_m, halomass, a, odelta, dndlogm, NULL, status);
+}
+
+/*----- ROUTINE: ccl_halo_bias_array -----
+INPUT: ccl_cosmology * cosmo, n_m halo masses in units of Msun, scale factor, halo overdensity
+TASK: returns dimensionless linear halo bias for all masses
+*/
+void ccl_halo_bias_array(ccl_cosmology *cosmo, int n_m, double *halomass, double a, double odelta,
+			 double *bias, int *status)
+{
+  ccl_massfunc_bias_array(cosmo, n_m, halomass, a, odelta, NULL, bias, status);
+}
@@ -71,25 +71,44 @@ ccl_p2d_t *ccl_p2d_t_new(int na,double *a_arr,
   return psp;
 }
 
-double ccl_p2d_t_eval(ccl_p2d_t *psp,double lk,double a,ccl_cosmology *cosmo,
-		      int *status)
+//Scale factor at which the spline should be evaluated for a given a.
+//Returns a negative number if a is outside the allowed range.
+static double p2d_a_eval(ccl_p2d_t *psp,double a)
 {
-  double a_ev=a;
-  int is_hiz= a<psp->amin;
-  int is_loz= a>psp->amax;
-
-  if(is_loz) { //Are we above the interpolation range in a?
-    *status=CCL_ERROR_SPLINE_EV;
-    return NAN;
-  }
-  else if(is_hiz) { //Are we below the interpolation range in a?
-    if(psp->extrap_linear_growth==ccl_p2d_no_extrapol) {
-      *status=CCL_ERROR_SPLINE_EV;
-      return NAN;
-    }
-    a_ev=psp->amin;
+  if(a>psp->amax) //Are we above the interpolation range in a?
+    return -1;
+  else if(a<psp->amin) { //Are we below the interpolation range in a?
+    if(psp->extrap_linear_growth==ccl_p2d_no_extrapol)
+      return -1;
+    return psp->amin;
   }
+  return a;
+}
 
+//Factor by which the power spectrum at a_ev must be multiplied to extrapolate it to a<a_ev
+static double p2d_growth_extrap(ccl_p2d_t *psp,double a,double a_ev,ccl_cosmology *cosmo,
+				int *status)
+{
+  double gz;
+
+  if(a>=a_ev)
+    return 1;
+
+  if(psp->extrap_linear_growth==ccl_p2d_cclgrowth) //Use CCL's growth function
+    gz=ccl_growth_factor(cosmo,a,status)/ccl_growth_factor(cosmo,a_ev,status);
+  else if(psp->extrap_linear_growth==ccl_p2d_customgrowth) //Use internal growth function
+    gz=psp->growth(a)/psp->growth(a_ev);
+  else //Use constant growth factor
+    gz=psp->growth_factor_0;
+
+  return gz*gz;
+}
+
+//Evaluate the spline at (lk,a_ev), extrapolating in k if needed.
+//a_ev must be within the interpolation range.
+static double p2d_eval_k(ccl_p2d_t *psp,double lk,double a_ev,
+			 gsl_interp_accel *xacc,gsl_interp_accel *yacc,int *status)
+{
   double pk_pre,pk_post;
   double lk_ev=lk;
   int is_hik= lk>psp->lkmax;
@@ -100,7 +119,7 @@ double ccl_p2d_t_eval(ccl_p2d_t *psp,double lk,double a,ccl_cosmology *cosmo,
     lk_ev=psp->lkmin;
 
   //Evaluate spline
-  int spstatus=gsl_spline2d_eval_e(psp->pk,lk_ev,a_ev,NULL,NULL,&pk_pre);
+  int spstatus=gsl_spline2d_eval_e(psp->pk,lk_ev,a_ev,xacc,yacc,&pk_pre);
   if(spstatus) {
     *status=CCL_ERROR_SPLINE_EV;
     return NAN;
@@ -112,14 +131,14 @@ double ccl_p2d_t_eval(ccl_p2d_t *psp,double lk,double a,ccl_cosmology *cosmo,
     if(psp->extrap_order_hik>0) {
       double pd;
       double dlk=lk-lk_ev;
-      spstatus=gsl_spline2d_eval_deriv_x_e(psp->pk,lk_ev,a_ev,NULL,NULL,&pd);
+      spstatus=gsl_spline2d_eval_deriv_x_e(psp->pk,lk_ev,a_ev,xacc,yacc,&pd);
       if(spstatus) {
 	*status=CCL_ERROR_SPLINE_EV;
 	return NAN;
       }
       pk_post+=pd*dlk;
       if(psp->extrap_order_hik>1) {
-	spstatus=gsl_spline2d_eval_deriv_xx_e(psp->pk,lk_ev,a_ev,NULL,NULL,&pd);
+	spstatus=gsl_spline2d_eval_deriv_xx_e(psp->pk,lk_ev,a_ev,xacc,yacc,&pd);
 	if(spstatus) {
 	  *status=CCL_ERROR_SPLINE_EV;
 	  return NAN;
@@ -133,14 +152,14 @@ double ccl_p2d_t_eval(ccl_p2d_t *psp,double lk,double a,ccl_cosmology *cosmo,
     if(psp->extrap_order_lok>0) {
       double pd;
       double dlk=lk-lk_ev;
-      spstatus=gsl_spline2d_eval_deriv_x_e(psp->pk,lk_ev,a_ev,NULL,NULL,&pd);
+      spstatus=gsl_spline2d_eval_deriv_x_e(psp->pk,lk_ev,a_ev,xacc,yacc,&pd);
       if(spstatus) {
 	*status=CCL_ERROR_SPLINE_EV;
 	return NAN;
       }
       pk_post+=pd*dlk;
       if(psp->extrap_order_lok>1) {
-	spstatus=gsl_spline2d_eval_deriv_xx_e(psp->pk,lk_ev,a_ev,NULL,NULL,&pd);
+	spstatus=gsl_spline2d_eval_deriv_xx_e(psp->pk,lk_ev,a_ev,xacc,yacc,&pd);
 	if(spstatus) {
 	  *status=CCL_ERROR_SPLINE_EV;
 	  return NAN;
@@ -156,19 +175,58 @@ double ccl_p2d_t_eval(ccl_p2d_t *psp,double lk,double a,ccl_cosmology *cosmo,
   if(psp->is_log)
     pk_post=exp(pk_post);
 
+  return pk_post;
+}
+
+double ccl_p2d_t_eval(ccl_p2d_t *psp,double lk,double a,ccl_cosmology *cosmo,
+		      int *status)
+{
+  double pk;
+  double a_ev=p2d_a_eval(psp,a);
+
+  if(a_ev<0) {
+    *status=CCL_ERROR_SPLINE_EV;
+    return NAN;
+  }
+
+  pk=p2d_eval_k(psp,lk,a_ev,NULL,NULL,status);
+
   //Extrapolate in a if needed
-  if(is_hiz) {
+  return pk*p2d_growth_extrap(psp,a,a_ev,cosmo,status);
+}
+
+void ccl_p2d_t_eval_array(ccl_p2d_t *psp,int nk,double *lk,int na,double *a,
+			  ccl_cosmology *cosmo,double *pk,int *status)
+{
+  int ia,ik;
+  gsl_interp_accel *xacc=gsl_interp_accel_alloc();
+  gsl_interp_accel *yacc=gsl_interp_accel_alloc();
+  if((xacc==NULL) || (yacc==NULL)) {
+    gsl_interp_accel_free(xacc);
+    gsl_interp_accel_free(yacc);
+    *status=CCL_ERROR_MEMORY;
+    return;
+  }
+
+  for(ia=0;ia<na;ia++) {
+    double a_ev=p2d_a_eval(psp,a[ia]);
     double gz;
-    if(psp->extrap_linear_growth==ccl_p2d_cclgrowth) //Use CCL's growth function
-      gz=ccl_growth_factor(cosmo,a,status)/ccl_growth_factor(cosmo,a_ev,status);
-    else if(psp->extrap_linear_growth==ccl_p2d_customgrowth) //Use internal growth function
-      gz=psp->growth(a)/psp->growth(a_ev);
-    else //Use constant growth factor
-      gz=psp->growth_factor_0;
-    pk_post*=gz*gz;
+
+    if(a_ev<0) {
+      *status=CCL_ERROR_SPLINE_EV;
+      for(ik=0;ik<nk;ik++)
+	pk[ia*nk+ik]=NAN;
+      continue;
+    }
+
+    //The growth extrapolation only depends on a
+    gz=p2d_growth_extrap(psp,a[ia],a_ev,cosmo,status);
+    for(ik=0;ik<nk;ik++)
+      pk[ia*nk+ik]=gz*p2d_eval_k(psp,lk[ik],a_ev,xacc,yacc,status);
   }
 
-  return pk_post;
+  gsl_interp_accel_free(xacc);
+  gsl_interp_accel_free(yacc);
 }
 
 void ccl_p2d_t_free(ccl_p2d_t *psp)
@@ -324,6 +324,8 @@ static void ccl_cosmology_compute_power_emu(ccl_cosmology * cosmo, int * status)
 static void ccl_cosmology_spline_nonlinpower(
     ccl_cosmology* cosmo,
     double (*pk)(ccl_cosmology* cosmo, double k, double a, int* status),
+    void (*pk_array)(ccl_cosmology* cosmo, int n_a, double *a,
+                     int n_k, double *k, double *pk, int* status),
     int* status) {
 
   double sigma8,log_sigma8;
@@ -378,10 +380,18 @@ static void ccl_cosmology_spline_nonlinpower(
   if (*status == 0) {
     // Calculate P(k) on a, k grid. After this loop, x will contain log(k) and y
     // will contain log(pk) [which has not yet been normalized]
-    for (int i=0; i<nk; i++) {
-      for (int j = 0; j<na; j++) {
-        if (*status == 0)
-          y2d[j*nk + i] = log((*pk)(cosmo, x[i], z[j], status));
+    if (pk_array != NULL) {
+      // Models that can compute all wavenumbers at once for a given a
+      (*pk_array)(cosmo, na, z, nk, x, y2d, status);
+      for (int i=0; i<nk*na; i++)
+        y2d[i] = log(y2d[i]);
+    }
+    else {
+      for (int i=0; i<nk; i++) {
+        for (int j = 0; j<na; j++) {
+          if (*status == 0)
+            y2d[j*nk + i] = log((*pk)(cosmo, x[i], z[j], status));
+        }
       }
     }
 
@@ -449,7 +459,7 @@ void ccl_cosmology_compute_power(ccl_cosmology* cosmo, int* status)
       case ccl_linear: {
           // temporarily set computed_power to true
           cosmo->computed_power = true;
-          ccl_cosmology_spline_nonlinpower(cosmo, ccl_linear_matter_power, status);
+          ccl_cosmology_spline_nonlinpower(cosmo, ccl_linear_matter_power, NULL, status);
           cosmo->computed_power = false;}
         break;
 
@@ -469,7 +479,7 @@ void ccl_cosmology_compute_power(ccl_cosmology* cosmo, int* status)
       case ccl_halo_model: {
           // temporarily set computed_power to true
           cosmo->computed_power = true;
-          ccl_cosmology_spline_nonlinpower(cosmo, ccl_halomodel_matter_power, status);
+          ccl_cosmology_spline_nonlinpower(cosmo, NULL, ccl_halomodel_matter_power_array, status);
           cosmo->computed_power = false;}
         break;
 
@@ -521,16 +531,92 @@ double ccl_nonlin_matter_power(ccl_cosmology* cosmo, double k, double a, int* st
   return ccl_p2d_t_eval(cosmo->data.p_nl,log(k),a,cosmo,status);
 }
 
+/*------ ROUTINE: ccl_nonlin_matter_power_array -----
+INPUT: ccl_cosmology * cosmo, n_a scale factors a, n_k wavenumbers k [1/Mpc]
+TASK: compute the nonlinear power spectrum on a grid of scale factors and
+      wavenumbers, with pk[ia*n_k+ik] = P_NL(k[ik],a[ia])
+*/
+void ccl_nonlin_matter_power_array(ccl_cosmology* cosmo, int n_a, double *a,
+				   int n_k, double *k, double *pk, int* status)
+{
+  int ik;
+  double *lk;
+
+  if (!cosmo->computed_power) ccl_cosmology_compute_power(cosmo, status);
+  // Return if compilation failed
+  if (!cosmo->computed_power) return;
+
+  lk=malloc(n_k*sizeof(double));
+  if(lk==NULL) {
+    *status=CCL_ERROR_MEMORY;
+    ccl_cosmology_set_status_message(cosmo, "ccl_power.c: ccl_nonlin_matter_power_array ran out of memory\n");
+    return;
+  }
+  for(ik=0;ik<n_k;ik++)
+    lk[ik]=log(k[ik]);
+
+  ccl_p2d_t_eval_array(cosmo->data.p_nl,n_k,lk,n_a,a,cosmo,pk,status);
+
+  free(lk);
+}
+
+/*------ ROUTINE: ccl_get_pk_simpson_nk -----
+INPUT: ccl_cosmology * cosmo
+TASK: number of ln(k) nodes used to integrate over the range of the power spectrum splines
+      with Simpson's rule: the number of spline nodes, plus one if it is even
+*/
+int ccl_get_pk_simpson_nk(ccl_cosmology *cosmo)
+{
+  int nk=ccl_get_pk_spline_nk(cosmo);
+  return (nk%2==0) ? nk+1 : nk;
+}
+
+/*------ ROUTINE: ccl_get_pk_simpson_lk_array -----
+INPUT: ccl_cosmology * cosmo, number of nodes nk (from ccl_get_pk_simpson_nk)
+TASK: Simpson ln(k) nodes spanning the P(k) splines, and their weights in ln(k).
+      The nodes are not the spline nodes themselves, since Simpson's rule may need one more,
+      so they can't be obtained from ccl_get_pk_spline_lk_array.
+*/
+void ccl_get_pk_simpson_lk_array(ccl_cosmology *cosmo,int nk,double *lk,double *w,int *status)
+{
+  int ik;
+  double dlk,*k_arr;
+
+  if(nk!=ccl_get_pk_simpson_nk(cosmo)) {
+    *status=CCL_ERROR_INCONSISTENT;
+    ccl_cosmology_set_status_message(cosmo, "ccl_power.c: ccl_get_pk_simpson_lk_array(): "
+				     "wrong number of nodes\n");
+    return;
+  }
+
+  k_arr=ccl_log_spacing(cosmo->spline_params.K_MIN,cosmo->spline_params.K_MAX,nk);
+  if(k_arr==NULL) {
+    *status=CCL_ERROR_LOGSPACE;
+    ccl_cosmology_set_status_message(cosmo, "ccl_power.c: ccl_get_pk_simpson_lk_array(): "
+				     "error creating log spacing in k\n");
+    return;
+  }
+  for(ik=0;ik<nk;ik++)
+    lk[ik]=log(k_arr[ik]);
+  free(k_arr);
+
+  dlk=(lk[nk-1]-lk[0])/(nk-1);
+  for(ik=0;ik<nk;ik++)
+    w[ik]=dlk*(((ik==0) || (ik==nk-1)) ? 1. : ((ik%2) ? 4. : 2.))/3.;
+}
+
 // Params for sigma(R) integrand
 typedef struct {
   ccl_cosmology *cosmo;
   double R;
+  double a; // scale factor at which P_lin(k) is integrated
   int* status;
 } SigmaR_pars;
 
 typedef struct {
   ccl_cosmology *cosmo;
   double R;
+  double a; // scale factor at which P_lin(k) is integrated
   int* status;
 } SigmaV_pars;
 
@@ -565,7 +651,7 @@ static double sigmaR_integrand(double lk,void *params)
   SigmaR_pars *par=(SigmaR_pars *)params;
 
   double k=pow(10.,lk);
-  double pk=ccl_linear_matter_power(par->cosmo,k, 1.,par->status);
+  double pk=ccl_linear_matter_power(par->cosmo,k, par->a,par->status);
   double kR=k*par->R;
   double w = w_tophat(kR);
 
@@ -578,7 +664,7 @@ static double sigmaV_integrand(double lk,void *params)
   SigmaV_pars *par=(SigmaV_pars *)params;
 
   double k=pow(10.,lk);
-  double pk=ccl_linear_matter_power(par->cosmo,k, 1.,par->status);
+  double pk=ccl_linear_matter_power(par->cosmo,k, par->a,par->status);
   double kR=k*par->R;
   double w = w_tophat(kR);
 
@@ -597,6 +683,8 @@ double ccl_sigmaR(ccl_cosmology *cosmo,double R,double a,int *status)
 
   par.cosmo=cosmo;
   par.R=R;
+  // Growth is scale-dependent with massive neutrinos, so P_lin is then integrated at a itself
+  par.a=(cosmo->params.N_nu_mass>0) ? a : 1.;
   gsl_integration_cquad_workspace *workspace=gsl_integration_cquad_workspace_alloc(cosmo->gsl_params.N_ITERATION);
   gsl_function F;
   F.function=&sigmaR_integrand;
@@ -612,6 +700,8 @@ double ccl_sigmaR(ccl_cosmology *cosmo,double R,double a,int *status)
 
   gsl_integration_cquad_workspace_free(workspace);
 
+  if(cosmo->params.N_nu_mass>0)
+    return sqrt(sigma_R*M_LN10/(2*M_PI*M_PI));
   return sqrt(sigma_R*M_LN10/(2*M_PI*M_PI))*ccl_growth_factor(cosmo, a, status);
 }
 
@@ -628,6 +718,8 @@ double ccl_sigmaV(ccl_cosmology *cosmo,double R,double a,int *status)
 
   par.cosmo=cosmo;
   par.R=R;
+  // Growth is scale-dependent with massive neutrinos, so P_lin is then integrated at a itself
+  par.a=(cosmo->params.N_nu_mass>0) ? a : 1.;
   gsl_integration_cquad_workspace *workspace=gsl_integration_cquad_workspace_alloc(cosmo->gsl_params.N_ITERATION);
   gsl_function F;
   F.function=&sigmaV_integrand;
@@ -644,6 +736,8 @@ double ccl_sigmaV(ccl_cosmology *cosmo,double R,double a,int *status)
 
   gsl_integration_cquad_workspace_free(workspace);
 
+  if(cosmo->params.N_nu_mass>0)
+    return sqrt(sigma_V*M_LN10/(2*M_PI*M_PI));
   return sqrt(sigma_V*M_LN10/(2*M_PI*M_PI))*ccl_growth_factor(cosmo, a, status);
 }
 
@@ -166,6 +166,25 @@ SplPar *ccl_spline_init(int n,double *x,double *y,double y0,double yf)
   return spl;
 }
 
+//Re-initializes spline with new data of the same size
+int ccl_spline_reinit(SplPar *spl,int n,double *x,double *y,double y0,double yf)
+{
+  if(n!=(int)(spl->spline->size))
+    return 1;
+
+  int parstatus=gsl_spline_init(spl->spline,x,y,n);
+  if(parstatus)
+    return parstatus;
+  gsl_interp_accel_reset(spl->intacc);
+
+  spl->x0=x[0];
+  spl->xf=x[n-1];
+  spl->y0=y0;
+  spl->yf=yf;
+
+  return 0;
+}
+
 //Evaluates spline at x checking for bound errors
 double ccl_spline_eval(double x,SplPar *spl)
 {
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 #include <fftw3.h>
@@ -84,6 +85,189 @@ void compute_u_coefficients(int N, double mu, double q, double L, double kcrc, d
     u[N/2] = (creal(u[N/2]) + I*0.0);
 }
 
+/* FFTW plans and transform coefficients are cached across calls, so that
+ * repeated transforms of the same size only pay for the FFTs themselves.
+ * The FFTW planner is not thread-safe, so planning, plan destruction, wisdom
+ * handling and any access to the caches happen inside OpenMP critical sections.
+ * Executing a cached plan on new arrays (fftw_execute_dft) is thread-safe. */
+#define FFTLOG_NPLANS_MAX 32   // Maximum number of transform sizes with cached plans
+#define FFTLOG_NUCOEFFS_MAX 128 // Maximum number of cached sets of u coefficients
+
+typedef struct {
+  int N;
+  int howmany; // Number of transforms performed by each plan (real plans only)
+  int real; // Complex-to-complex (0) or real-to-complex/complex-to-real (1) plans
+  fftw_plan forward; // Out-of-place
+  fftw_plan reverse; // In-place for complex plans, out-of-place for real ones
+} fftlog_plans;
+
+typedef struct {
+  int N;
+  double mu, q, L, kcrc;
+  double complex* u;
+} fftlog_ucoeffs;
+
+static fftlog_plans plan_cache[FFTLOG_NPLANS_MAX];
+static int plan_cache_n = 0;
+static fftlog_ucoeffs u_cache[FFTLOG_NUCOEFFS_MAX];
+static int u_cache_n = 0;
+static int u_cache_next = 0;
+static unsigned plan_flags = FFTW_ESTIMATE;
+
+/* Creates the plans for a complex transform of size N, or for howmany real
+ * transforms of size N stored contiguously.  Must be called from within the
+ * fftlog_fftw critical section. */
+static void make_plans(int N, int howmany, int real, fftw_plan* forward, fftw_plan* reverse)
+{
+  // Planning with FFTW_MEASURE overwrites the arrays, so use scratch ones.
+  // FFTW_UNALIGNED allows the plans to be executed on arbitrary arrays.
+  unsigned flags = plan_flags | FFTW_UNALIGNED;
+  if(real) {
+    int Nc = N/2+1;
+    double* x = fftw_malloc(sizeof(double)*N*howmany);
+    fftw_complex* c = fftw_malloc(sizeof(fftw_complex)*Nc*howmany);
+    *forward = fftw_plan_many_dft_r2c(1, &N, howmany, x, NULL, 1, N, c, NULL, 1, Nc, flags);
+    *reverse = fftw_plan_many_dft_c2r(1, &N, howmany, c, NULL, 1, Nc, x, NULL, 1, N, flags);
+    fftw_free(x);
+    fftw_free(c);
+  }
+  else {
+    fftw_complex* in = fftw_malloc(sizeof(fftw_complex)*N);
+    fftw_complex* out = fftw_malloc(sizeof(fftw_complex)*N);
+    *forward = fftw_plan_dft_1d(N, in, out, -1, flags);
+    *reverse = fftw_plan_dft_1d(N, out, out, +1, flags);
+    fftw_free(in);
+    fftw_free(out);
+  }
+}
+
+/* Returns the forward and reverse plans for transforms of size N (see make_plans).
+ * *owned is set to 1 if the plans could not be cached, in which case they
+ * must be released with release_plans once used. */
+static void get_plans(int N, int howmany, int real, fftw_plan* forward, fftw_plan* reverse, int* owned)
+{
+  *owned = 1;
+#pragma omp critical(fftlog_fftw)
+  {
+    for(int i = 0; i < plan_cache_n; i++) {
+      if((plan_cache[i].N == N) && (plan_cache[i].howmany == howmany) &&
+         (plan_cache[i].real == real)) {
+        *forward = plan_cache[i].forward;
+        *reverse = plan_cache[i].reverse;
+        *owned = 0;
+        break;
+      }
+    }
+
+    if(*owned) {
+      make_plans(N, howmany, real, forward, reverse);
+      if(plan_cache_n < FFTLOG_NPLANS_MAX) {
+        plan_cache[plan_cache_n].N = N;
+        plan_cache[plan_cache_n].howmany = howmany;
+        plan_cache[plan_cache_n].real = real;
+        plan_cache[plan_cache_n].forward = *forward;
+        plan_cache[plan_cache_n].reverse = *reverse;
+        plan_cache_n++;
+        *owned = 0;
+      }
+    }
+  }
+}
+
+static void release_plans(fftw_plan forward, fftw_plan reverse, int owned)
+{
+  if(owned) {
+#pragma omp critical(fftlog_fftw)
+    {
+      fftw_destroy_plan(forward);
+      fftw_destroy_plan(reverse);
+    }
+  }
+}
+
+/* Same as compute_u_coefficients, but reusing previously computed coefficients */
+static void get_u_coefficients(int N, double mu, double q, double L, double kcrc, double complex u[])
+{
+  int found = 0;
+#pragma omp critical(fftlog_ucache)
+  {
+    for(int i = 0; i < u_cache_n; i++) {
+      fftlog_ucoeffs* c = &(u_cache[i]);
+      if((c->N == N) && (c->mu == mu) && (c->q == q) && (c->L == L) && (c->kcrc == kcrc)) {
+        memcpy(u, c->u, N*sizeof(double complex));
+        found = 1;
+        break;
+      }
+    }
+  }
+  if(found)
+    return;
+
+  compute_u_coefficients(N, mu, q, L, kcrc, u);
+
+  double complex* u_store = malloc(sizeof(double complex)*N);
+  if(u_store == NULL)
+    return;
+  memcpy(u_store, u, N*sizeof(double complex));
+#pragma omp critical(fftlog_ucache)
+  {
+    // Once full, the oldest entries are overwritten first
+    fftlog_ucoeffs* c = &(u_cache[u_cache_next]);
+    if(u_cache_n == FFTLOG_NUCOEFFS_MAX)
+      free(c->u);
+    else
+      u_cache_n++;
+    c->N = N;
+    c->mu = mu;
+    c->q = q;
+    c->L = L;
+    c->kcrc = kcrc;
+    c->u = u_store;
+    u_cache_next = (u_cache_next + 1) % FFTLOG_NUCOEFFS_MAX;
+  }
+}
+
+void fftlog_set_measure(int measure)
+{
+#pragma omp critical(fftlog_fftw)
+  plan_flags = measure ? FFTW_MEASURE : FFTW_ESTIMATE;
+}
+
+int fftlog_import_wisdom(const char* fname)
+{
+  int success;
+#pragma omp critical(fftlog_fftw)
+  success = fftw_import_wisdom_from_filename(fname);
+  return success;
+}
+
+int fftlog_export_wisdom(const char* fname)
+{
+  int success;
+#pragma omp critical(fftlog_fftw)
+  success = fftw_export_wisdom_to_filename(fname);
+  return success;
+}
+
+void fftlog_clear_cache(void)
+{
+#pragma omp critical(fftlog_fftw)
+  {
+    for(int i = 0; i < plan_cache_n; i++) {
+      fftw_destroy_plan(plan_cache[i].forward);
+      fftw_destroy_plan(plan_cache[i].reverse);
+    }
+    plan_cache_n = 0;
+  }
+#pragma omp critical(fftlog_ucache)
+  {
+    for(int i = 0; i < u_cache_n; i++)
+      free(u_cache[i].u);
+    u_cache_n = 0;
+    u_cache_next = 0;
+  }
+}
+
 void fht(int N, const double r[], const double complex a[], double k[], double complex b[], double mu,
          double q, double kcrc, int noring, double complex* u)
 {
@@ -93,19 +277,19 @@ void fht(int N, const double r[], const double complex a[], double k[], double c
     if(noring)
       kcrc = goodkr(N, mu, q, L, kcrc);
     ulocal = malloc (sizeof(complex double)*N);
-    compute_u_coefficients(N, mu, q, L, kcrc, ulocal);
+    get_u_coefficients(N, mu, q, L, kcrc, ulocal);
     u = ulocal;
   }
 
   /* Compute the convolution b = a*u using FFTs */
-  fftw_plan forward_plan = fftw_plan_dft_1d(N, (fftw_complex*) a, (fftw_complex*) b,  -1, FFTW_ESTIMATE);
-  fftw_plan reverse_plan = fftw_plan_dft_1d(N, (fftw_complex*) b, (fftw_complex*) b, +1, FFTW_ESTIMATE);
-  fftw_execute(forward_plan);
+  fftw_plan forward_plan, reverse_plan;
+  int owned;
+  get_plans(N, 1, 0, &forward_plan, &reverse_plan, &owned);
+  fftw_execute_dft(forward_plan, (fftw_complex*) a, (fftw_complex*) b);
   for(int m = 0; m < N; m++)
     b[m] *= u[m] / (double)(N);       // divide by N since FFTW doesn't normalize the inverse FFT
-  fftw_execute(reverse_plan);
-  fftw_destroy_plan(forward_plan);
-  fftw_destroy_plan(reverse_plan);
+  fftw_execute_dft(reverse_plan, (fftw_complex*) b, (fftw_complex*) b);
+  release_plans(forward_plan, reverse_plan, owned);
 
   /* Reverse b array */
   double complex tmp;
@@ -124,36 +308,123 @@ void fht(int N, const double r[], const double complex a[], double k[], double c
   free(ulocal);
 }
 
+void fht_real_many(int n_mu, const double mu[], int M, int N, const double r[], const double a[],
+                   double k[], double b[], double q, double kcrc, int noring)
+{
+  double L = log(r[N-1]/r[0]) * N/(N-1.);
+  int Nc = N/2+1;
+  double complex* af = malloc(sizeof(double complex)*Nc*M);
+  double complex* bf = malloc(sizeof(double complex)*Nc*M);
+  double complex* u = malloc(sizeof(double complex)*N);
+  if((af == NULL) || (bf == NULL) || (u == NULL)) {
+    free(af);
+    free(bf);
+    free(u);
+    return;
+  }
+
+  /* The forward FFTs don't depend on the order, so they are shared by all of them */
+  fftw_plan forward_plan, reverse_plan;
+  int owned;
+  get_plans(N, M, 1, &forward_plan, &reverse_plan, &owned);
+  fftw_execute_dft_r2c(forward_plan, (double*) a, (fftw_complex*) af);
+
+  for(int i_mu = 0; i_mu < n_mu; i_mu++) {
+    double kcrc_mu = kcrc;
+    if(noring)
+      kcrc_mu = goodkr(N, mu[i_mu], q, L, kcrc);
+    get_u_coefficients(N, mu[i_mu], q, L, kcrc_mu, u);
+
+    /* a and u are real and hermitian respectively, so the convolution is real */
+    for(int j = 0; j < M; j++) {
+      for(int m = 0; m < Nc; m++)
+        bf[j*Nc+m] = af[j*Nc+m] * u[m] / (double)(N);
+    }
+    double* b_mu = &(b[i_mu*M*N]);
+    fftw_execute_dft_c2r(reverse_plan, (fftw_complex*) bf, b_mu);
+
+    /* Reverse b arrays */
+    for(int j = 0; j < M; j++) {
+      double* bj = &(b_mu[j*N]);
+      for(int n = 0; n < N/2; n++) {
+        double tmp = bj[n];
+        bj[n] = bj[N-n-1];
+        bj[N-n-1] = tmp;
+      }
+    }
+
+    /* Compute k's corresponding to input r's */
+    double* k_mu = &(k[i_mu*N]);
+    k_mu[0] = kcrc_mu * exp(-L) / r[0];
+    for(int n = 1; n < N; n++)
+      k_mu[n] = k_mu[0] * exp(n*L/N);
+  }
+  release_plans(forward_plan, reverse_plan, owned);
+
+  free(af);
+  free(bf);
+  free(u);
+}
+
+void fht_real(int N, const double r[], const double a[], double k[], double b[], double mu,
+              double q, double kcrc, int noring)
+{
+  fht_real_many(1, &mu, 1, N, r, a, k, b, q, kcrc, noring);
+}
+
+void fftlog_ComputeXi2D_many(int n_orders, const double bessel_order[], int M, int N,
+                             const double l[], const double cl[], double th[], double xi[])
+{
+  double* a = malloc(sizeof(double)*N*M);
+  if(a == NULL)
+    return;
+
+  for(int j = 0; j < M; j++) {
+    for(int i = 0; i < N; i++)
+      a[j*N+i] = l[i]*cl[j*N+i];
+  }
+  fht_real_many(n_orders, bessel_order, M, N, l, a, th, xi, 0, 1, 1);
+  for(int io = 0; io < n_orders; io++) {
+    for(int j = 0; j < M; j++) {
+      for(int i = 0; i < N; i++)
+        xi[(io*M+j)*N+i] /= 2*M_PI*th[io*N+i];
+    }
+  }
+
+  free(a);
+}
+
 void fftlog_ComputeXi2D(double bessel_order,int N,const double l[],const double cl[],
 			double th[], double xi[])
 {
-  double complex* a = malloc(sizeof(complex double)*N);
-  double complex* b = malloc(sizeof(complex double)*N);
+  fftlog_ComputeXi2D_many(1, &bessel_order, 1, N, l, cl, th, xi);
+}
+
+void fftlog_ComputeXiLM_many(double l, double m, int M, int N, const double k[], const double pk[],
+                             double r[], double xi[])
+{
+  double* a = malloc(sizeof(double)*N*M);
+  double mu = l + 0.5;
+  if(a == NULL)
+    return;
 
-  for(int i=0;i<N;i++)
-    a[i]=l[i]*cl[i];
-  fht(N,l,a,th,b,bessel_order,0,1,1,NULL);
-  for(int i=0;i<N;i++)
-    xi[i]=creal(b[i]/(2*M_PI*th[i]));
+  for(int j = 0; j < M; j++) {
+    for(int i = 0; i < N; i++)
+      a[j*N+i] = pow(k[i], m - 0.5) * pk[j*N+i];
+  }
+  fht_real_many(1, &mu, M, N, k, a, r, xi, 0, 1, 1);
+  for(int j = 0; j < M; j++) {
+    for(int i = 0; i < N; i++)
+      xi[j*N+i] *= pow(2*M_PI*r[i], -(m-0.5));
+  }
 
   free(a);
-  free(b);
 }
 
 void fftlog_ComputeXiLM(double l, double m, int N, const double k[], const double pk[],
 			double r[], double xi[])
 {
-  double complex* a = malloc(sizeof(complex double)*N);
-  double complex* b = malloc(sizeof(complex double)*N);
-
-  for(int i = 0; i < N; i++)
-    a[i] = pow(k[i], m - 0.5) * pk[i];
-  fht(N, k, a, r, b, l + 0.5, 0, 1, 1, NULL);
-  for(int i = 0; i < N; i++)
-    xi[i] = creal(pow(2*M_PI*r[i], -(m-0.5)) * b[i]);
-
-  free(a);
-  free(b);
+  fftlog_ComputeXiLM_many(l, m, 1, N, k, pk, r, xi);
 }
 
 void pk2xi(int N, const double k[], const double pk[], double r[], double xi[])
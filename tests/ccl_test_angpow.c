@@ -1,7 +1,9 @@
 #include "ccl.h"
 #include "ctest.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
+#include <gsl/gsl_sf_bessel.h>
 
 #define NZ 1024
 #define Z0_GC 1.0 
@@ -9,6 +11,14 @@
 #define NL 499
 
 #define CLS_PRECISION 3E-3 
+// The native and Angpow C_ells are compared with each other, each of them being accurate
+// to CLS_PRECISION, so they can differ by twice as much
+#define CLS_PRECISION_NATIVE (2*CLS_PRECISION)
+// Accuracy of the direct quadrature used as a reference for lensing-like tracers
+#define CLS_PRECISION_DIRECT 5E-3
+#define NK_DIRECT 300
+#define NCHI_DIRECT 8000
+#define KMAX_DIRECT 0.1
 
 CTEST_DATA(angpow) {
   double Omega_c;
@@ -47,7 +57,7 @@ CTEST_SETUP(angpow){
 
 
 
-static void test_angpow_precision(struct angpow_data * data)
+static void test_angpow_precision(struct angpow_data * data,int method,double precision)
 {
   // Status flag
   int status =0;
@@ -89,6 +99,7 @@ static void test_angpow_precision(struct angpow_data * data)
   double logstep = 1.15;
   double dchi = (ct_gc_A->chimax-ct_gc_A->chimin)/1000.; 
   CCL_ClWorkspace *wap=ccl_cl_workspace_new(NL+1,2*ells[NL-1],logstep,linstep,&status);
+  wap->nonlimber_method=method;
   
   // Compute C_ell
   ccl_angular_cls(ccl_cosmo,wap,ct_gc_A,ct_gc_A,NULL,NL,ells,cells_gg_angpow,&status);
@@ -105,7 +116,7 @@ static void test_angpow_precision(struct angpow_data * data)
   }
   fclose(f);
   rel_precision /= NL;
-  ASSERT_TRUE(rel_precision < CLS_PRECISION);
+  ASSERT_TRUE(rel_precision < precision);
   
   //Free up tracers
   ccl_cl_tracer_free(ct_gc_A);
@@ -117,5 +128,111 @@ static void test_angpow_precision(struct angpow_data * data)
 }
 
 CTEST2(angpow,precision) {
-  test_angpow_precision(data);
+  test_angpow_precision(data,ccl_nonlimber_angpow,CLS_PRECISION);
+}
+
+CTEST2(angpow,native) {
+  test_angpow_precision(data,ccl_nonlimber_native,CLS_PRECISION_NATIVE);
+}
+
+// Lensing-like radial kernel of a tracer, including the growth factor, with the same
+// normalization as in the native non-Limber calculation
+static double direct_kernel(ccl_cosmology *cosmo,CCL_ClTracer *clt,double chi,int *status)
+{
+  double w;
+  double a=ccl_scale_factor_of_chi(cosmo,chi,status);
+  if(clt->tracer_type==ccl_weak_lensing_tracer)
+    w=fmax(ccl_spline_eval(chi,clt->spl_wL),0);
+  else if(clt->tracer_type==ccl_number_counts_tracer)
+    w=-2*fmax(ccl_spline_eval(chi,clt->spl_wM),0);
+  else
+    w=(chi<clt->chi_source) ? 1-chi/clt->chi_source : 0;
+  return ccl_growth_factor(cosmo,a,status)*clt->prefac_lensing*w/(a*chi);
+}
+
+// Non-Limber auto-spectrum of a lensing-like tracer with the linear power spectrum,
+//   C_l = 2/pi * Integral[ dk k^2 P_lin(k) Delta_l(k)^2 ],
+//   Delta_l(k) = g(l)/k^2 * Integral[ dchi f(chi) j_l(k*chi) ],
+// computed by direct quadrature with spherical Bessel functions.
+static double direct_cl(ccl_cosmology *cosmo,CCL_ClTracer *clt,double chimax,int l,int *status)
+{
+  double g,cl=0;
+  double lkmin=log(cosmo->spline_params.K_MIN),lkmax=log(KMAX_DIRECT);
+  double dlk=(lkmax-lkmin)/(NK_DIRECT-1),dchi=chimax/NCHI_DIRECT;
+  double *f=malloc(NCHI_DIRECT*sizeof(double));
+
+  if(clt->tracer_type==ccl_weak_lensing_tracer)
+    g=sqrt((l+2.)*(l+1.)*l*(l-1.));
+  else
+    g=l*(l+1.);
+
+  // Midpoint rule in chi, so that the 1/chi behaviour of the kernels is never evaluated at 0
+  for(int ic=0;ic<NCHI_DIRECT;ic++)
+    f[ic]=direct_kernel(cosmo,clt,(ic+0.5)*dchi,status);
+
+  // Trapezoidal rule in ln(k)
+  for(int ik=0;ik<NK_DIRECT;ik++) {
+    double k=exp(lkmin+ik*dlk),delta=0;
+    for(int ic=0;ic<NCHI_DIRECT;ic++)
+      delta+=f[ic]*gsl_sf_bessel_jl(l,k*(ic+0.5)*dchi);
+    delta*=g*dchi/(k*k);
+    cl+=((ik==0) || (ik==NK_DIRECT-1) ? 0.5 : 1.)*k*k*k*ccl_linear_matter_power(cosmo,k,1.,status)*delta*delta;
+  }
+
+  free(f);
+  return 2*cl*dlk/M_PI;
+}
+
+// Native non-Limber C_ells of shear, magnification and CMB lensing tracers against the
+// direct quadrature above, at multipoles where Limber's approximation is inaccurate
+CTEST2(angpow,native_lensing) {
+  int status=0;
+  int ells[2]={3,10};
+  double z_arr[NZ],nz_arr[NZ],bz_arr[NZ],sz_arr[NZ];
+  ccl_configuration config=default_config;
+  config.transfer_function_method=ccl_bbks;
+  config.matter_power_spectrum_method=ccl_linear;
+  ccl_parameters params=ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							data->A_s,data->n_s,&status);
+  params.sigma8=0.8;
+  ccl_cosmology *cosmo=ccl_cosmology_create(params,config);
+  ASSERT_NOT_NULL(cosmo);
+
+  for(int i=0;i<NZ;i++) {
+    z_arr[i]=2.0*(i+0.5)/NZ;
+    nz_arr[i]=exp(-0.5*pow((z_arr[i]-0.8)/0.15,2));
+    // Zero bias, so that only magnification contributes to the number counts
+    bz_arr[i]=0;
+    sz_arr[i]=0;
+  }
+  CCL_ClTracer *tr[3];
+  double chimax[3];
+  tr[0]=ccl_cl_tracer_lensing_simple(cosmo,NZ,z_arr,nz_arr,&status);
+  tr[1]=ccl_cl_tracer_number_counts(cosmo,0,1,NZ,z_arr,nz_arr,NZ,z_arr,bz_arr,
+				    NZ,z_arr,sz_arr,&status);
+  tr[2]=ccl_cl_tracer_cmblens(cosmo,1100.,&status);
+  ASSERT_EQUAL(0,status);
+  chimax[0]=tr[0]->spl_wL->xf;
+  chimax[1]=tr[1]->spl_wM->xf;
+  chimax[2]=tr[2]->chi_source;
+
+  // Both multipoles are workspace nodes, so no interpolation is involved
+  CCL_ClWorkspace *w=ccl_cl_workspace_new(50,49,1.15,40,&status);
+  ASSERT_EQUAL(0,status);
+
+  for(int it=0;it<3;it++) {
+    double cls[2];
+    ccl_angular_cls(cosmo,w,tr[it],tr[it],NULL,2,ells,cls,&status);
+    ASSERT_EQUAL(0,status);
+    for(int il=0;il<2;il++) {
+      double cl_direct=direct_cl(cosmo,tr[it],chimax[it],ells[il],&status);
+      ASSERT_EQUAL(0,status);
+      ASSERT_DBL_NEAR_TOL(1.,cls[il]/cl_direct,CLS_PRECISION_DIRECT);
+    }
+  }
+
+  ccl_cl_workspace_free(w);
+  for(int it=0;it<3;it++)
+    ccl_cl_tracer_free(tr[it]);
+  ccl_cosmology_free(cosmo);
 }
@@ -709,3 +709,246 @@ CTEST2(cls,analytic) {
 CTEST2(cls,histo) {
   compare_cls("histo",data);
 }
+
+static void compare_spec_bind(struct cls_data * data)
+{
+  int status=0;
+  int nz=256,nl=100;
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->A_s,data->n_s, &status);
+  params.sigma8=data->sigma8;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  double *zarr=malloc(nz*sizeof(double));
+  double *pzarr=malloc(nz*sizeof(double));
+  double *bzarr=malloc(nz*sizeof(double));
+  for(int ii=0;ii<nz;ii++) {
+    zarr[ii]=2.0*(ii+0.5)/nz;
+    pzarr[ii]=exp(-0.5*(zarr[ii]-0.8)*(zarr[ii]-0.8)/(0.1*0.1));
+    bzarr[ii]=1+zarr[ii];
+  }
+  int *ells=malloc(nl*sizeof(int));
+  double *cls_direct=malloc(nl*sizeof(double));
+  double *cls_bound=malloc(nl*sizeof(double));
+  for(int ii=0;ii<nl;ii++)
+    ells[ii]=10*(ii+1);
+
+  //Tracers built directly for this cosmology
+  CCL_ClTracer *tr_nc=ccl_cl_tracer_number_counts_simple(cosmo,nz,zarr,pzarr,nz,zarr,bzarr,&status);
+  ASSERT_NOT_NULL(tr_nc);
+  CCL_ClTracer *tr_wl=ccl_cl_tracer_lensing_simple(cosmo,nz,zarr,pzarr,&status);
+  ASSERT_NOT_NULL(tr_wl);
+
+  //Tracers bound from cosmology-independent specs
+  CCL_ClTracerSpec *sp_nc=ccl_cl_tracer_spec_new(ccl_number_counts_tracer,0,0,0,
+						 nz,zarr,pzarr,nz,zarr,bzarr,-1,NULL,NULL,
+						 -1,NULL,NULL,-1,NULL,NULL,0,&status);
+  ASSERT_NOT_NULL(sp_nc);
+  CCL_ClTracerSpec *sp_wl=ccl_cl_tracer_spec_new(ccl_weak_lensing_tracer,0,0,0,
+						 nz,zarr,pzarr,-1,NULL,NULL,-1,NULL,NULL,
+						 -1,NULL,NULL,-1,NULL,NULL,0,&status);
+  ASSERT_NOT_NULL(sp_wl);
+  CCL_ClTracer *trb_nc=ccl_cl_tracer_bind(cosmo,sp_nc,&status);
+  ASSERT_NOT_NULL(trb_nc);
+  CCL_ClTracer *trb_wl=ccl_cl_tracer_bind(cosmo,sp_wl,&status);
+  ASSERT_NOT_NULL(trb_wl);
+
+  CCL_ClWorkspace *w=ccl_cl_workspace_new_limber(ells[nl-1],1.05,5,&status);
+  ccl_angular_cls(cosmo,w,tr_nc,tr_wl,NULL,nl,ells,cls_direct,&status);
+  ccl_angular_cls(cosmo,w,trb_nc,trb_wl,NULL,nl,ells,cls_bound,&status);
+  ASSERT_EQUAL(0,status);
+  for(int ii=0;ii<nl;ii++)
+    ASSERT_DBL_NEAR_TOL(1.,cls_bound[ii]/cls_direct[ii],1E-6);
+
+  //Freeing bound tracers must leave the spec usable
+  ccl_cl_tracer_free(trb_nc);
+  trb_nc=ccl_cl_tracer_bind(cosmo,sp_nc,&status);
+  ASSERT_NOT_NULL(trb_nc);
+  ccl_angular_cls(cosmo,w,trb_nc,trb_wl,NULL,nl,ells,cls_bound,&status);
+  ASSERT_EQUAL(0,status);
+  for(int ii=0;ii<nl;ii++)
+    ASSERT_DBL_NEAR_TOL(1.,cls_bound[ii]/cls_direct[ii],1E-6);
+
+  ccl_cl_workspace_free(w);
+  ccl_cl_tracer_free(trb_nc);
+  ccl_cl_tracer_free(trb_wl);
+  ccl_cl_tracer_spec_free(sp_nc);
+  ccl_cl_tracer_spec_free(sp_wl);
+  ccl_cl_tracer_free(tr_nc);
+  ccl_cl_tracer_free(tr_wl);
+  free(ells); free(cls_direct); free(cls_bound);
+  free(zarr); free(pzarr); free(bzarr);
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(cls,spec_bind) {
+  compare_spec_bind(data);
+}
+
+static void compare_components(struct cls_data * data)
+{
+  int status=0;
+  int nz=256,nl=100;
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->A_s,data->n_s, &status);
+  params.sigma8=data->sigma8;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  double *zarr=malloc(nz*sizeof(double));
+  double *pzarr=malloc(nz*sizeof(double));
+  double *bzarr=malloc(nz*sizeof(double));
+  double *b2zarr=malloc(nz*sizeof(double));
+  double *szarr=malloc(nz*sizeof(double));
+  double *azarr=malloc(nz*sizeof(double));
+  double *a2zarr=malloc(nz*sizeof(double));
+  double *rzarr=malloc(nz*sizeof(double));
+  for(int ii=0;ii<nz;ii++) {
+    zarr[ii]=2.0*(ii+0.5)/nz;
+    pzarr[ii]=exp(-0.5*(zarr[ii]-0.8)*(zarr[ii]-0.8)/(0.1*0.1));
+    bzarr[ii]=1+zarr[ii];
+    b2zarr[ii]=1.5*bzarr[ii];
+    szarr[ii]=0.2;
+    azarr[ii]=1.;
+    a2zarr[ii]=2.;
+    rzarr[ii]=1.;
+  }
+  int *ells=malloc(nl*sizeof(int));
+  double *cls_full=malloc(nl*sizeof(double));
+  double *cls_comb=malloc(nl*sizeof(double));
+  for(int ii=0;ii<nl;ii++)
+    ells[ii]=10*(ii+1);
+
+  CCL_ClTracer *tr_nc=ccl_cl_tracer_number_counts(cosmo,1,1,nz,zarr,pzarr,nz,zarr,bzarr,
+						  nz,zarr,szarr,&status);
+  ASSERT_NOT_NULL(tr_nc);
+  CCL_ClTracer *tr_wl=ccl_cl_tracer_lensing(cosmo,1,nz,zarr,pzarr,nz,zarr,azarr,nz,zarr,rzarr,&status);
+  ASSERT_NOT_NULL(tr_wl);
+  CCL_ClWorkspace *w=ccl_cl_workspace_new_limber(ells[nl-1],1.05,5,&status);
+
+  //Unit amplitudes must reproduce the full calculation
+  CCL_ClComponents *clc=ccl_angular_cls_components(cosmo,w,tr_nc,tr_wl,NULL,nl,ells,&status);
+  ASSERT_NOT_NULL(clc);
+  ccl_angular_cls(cosmo,w,tr_nc,tr_wl,NULL,nl,ells,cls_full,&status);
+  ASSERT_EQUAL(0,status);
+  ccl_angular_cls_combine(clc,NULL,NULL,cls_comb);
+  for(int ii=0;ii<nl;ii++)
+    ASSERT_DBL_NEAR_TOL(1.,cls_comb[ii]/cls_full[ii],CLS_TOLERANCE);
+
+  //Rescaling the bias and IA amplitudes
+  double amp1[CCL_CL_NCOMP]={1.5,1.,1.,1.,1.};
+  double amp2[CCL_CL_NCOMP]={1.,1.,1.,1.,2.};
+  CCL_ClTracer *tr_nc2=ccl_cl_tracer_number_counts(cosmo,1,1,nz,zarr,pzarr,nz,zarr,b2zarr,
+						   nz,zarr,szarr,&status);
+  ASSERT_NOT_NULL(tr_nc2);
+  CCL_ClTracer *tr_wl2=ccl_cl_tracer_lensing(cosmo,1,nz,zarr,pzarr,nz,zarr,a2zarr,nz,zarr,rzarr,&status);
+  ASSERT_NOT_NULL(tr_wl2);
+  ccl_angular_cls(cosmo,w,tr_nc2,tr_wl2,NULL,nl,ells,cls_full,&status);
+  ASSERT_EQUAL(0,status);
+  ccl_angular_cls_combine(clc,amp1,amp2,cls_comb);
+  for(int ii=0;ii<nl;ii++)
+    ASSERT_DBL_NEAR_TOL(1.,cls_comb[ii]/cls_full[ii],CLS_TOLERANCE);
+
+  ccl_cl_components_free(clc);
+  ccl_cl_workspace_free(w);
+  ccl_cl_tracer_free(tr_nc);
+  ccl_cl_tracer_free(tr_wl);
+  ccl_cl_tracer_free(tr_nc2);
+  ccl_cl_tracer_free(tr_wl2);
+  free(ells); free(cls_full); free(cls_comb);
+  free(zarr); free(pzarr); free(bzarr); free(b2zarr);
+  free(szarr); free(azarr); free(a2zarr); free(rzarr);
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(cls,components) {
+  compare_components(data);
+}
+
+static void compare_nz_transform(struct cls_data * data)
+{
+  int status=0;
+  int nz=256,nl=100;
+  double dz=0.05,stretch=1.2;
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->A_s,data->n_s, &status);
+  params.sigma8=data->sigma8;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  double *zarr=malloc(nz*sizeof(double));
+  double *ztarr=malloc(nz*sizeof(double));
+  double *pzarr=malloc(nz*sizeof(double));
+  double *bzarr=malloc(nz*sizeof(double));
+  for(int ii=0;ii<nz;ii++) {
+    //Far enough from z=0 for the transformed nodes to stay at positive redshift
+    zarr[ii]=0.3+1.0*(ii+0.5)/nz;
+    pzarr[ii]=exp(-0.5*(zarr[ii]-0.8)*(zarr[ii]-0.8)/(0.1*0.1));
+    bzarr[ii]=1.;
+  }
+  int *ells=malloc(nl*sizeof(int));
+  double *cls_direct=malloc(nl*sizeof(double));
+  double *cls_transf=malloc(nl*sizeof(double));
+  for(int ii=0;ii<nl;ii++)
+    ells[ii]=10*(ii+1);
+  CCL_ClWorkspace *w=ccl_cl_workspace_new_limber(ells[nl-1],1.05,5,&status);
+
+  CCL_ClTracer *tr_nc=ccl_cl_tracer_number_counts_simple(cosmo,nz,zarr,pzarr,nz,zarr,bzarr,&status);
+  ASSERT_NOT_NULL(tr_nc);
+  CCL_ClTracer *tr_wl=ccl_cl_tracer_lensing_simple(cosmo,nz,zarr,pzarr,&status);
+  ASSERT_NOT_NULL(tr_wl);
+  ccl_cl_tracer_nz_transform(cosmo,tr_nc,dz,stretch,&status);
+  ccl_cl_tracer_nz_transform(cosmo,tr_wl,dz,stretch,&status);
+  ASSERT_EQUAL(0,status);
+
+  //Same tracers built from the transformed N(z)
+  double zm=tr_nc->spec->z_mean;
+  for(int ii=0;ii<nz;ii++)
+    ztarr[ii]=zm+stretch*(zarr[ii]-zm)+dz;
+  CCL_ClTracer *trt_nc=ccl_cl_tracer_number_counts_simple(cosmo,nz,ztarr,pzarr,nz,zarr,bzarr,&status);
+  ASSERT_NOT_NULL(trt_nc);
+  CCL_ClTracer *trt_wl=ccl_cl_tracer_lensing_simple(cosmo,nz,ztarr,pzarr,&status);
+  ASSERT_NOT_NULL(trt_wl);
+
+  ccl_angular_cls(cosmo,w,trt_nc,trt_nc,NULL,nl,ells,cls_direct,&status);
+  ccl_angular_cls(cosmo,w,tr_nc,tr_nc,NULL,nl,ells,cls_transf,&status);
+  ASSERT_EQUAL(0,status);
+  for(int ii=0;ii<nl;ii++)
+    ASSERT_DBL_NEAR_TOL(1.,cls_transf[ii]/cls_direct[ii],CLS_TOLERANCE);
+
+  ccl_angular_cls(cosmo,w,trt_wl,trt_wl,NULL,nl,ells,cls_direct,&status);
+  ccl_angular_cls(cosmo,w,tr_wl,tr_wl,NULL,nl,ells,cls_transf,&status);
+  ASSERT_EQUAL(0,status);
+  for(int ii=0;ii<nl;ii++)
+    ASSERT_DBL_NEAR_TOL(1.,cls_transf[ii]/cls_direct[ii],CLS_TOLERANCE);
+
+  //Shifts that move N(z) below z=0 are rejected and leave the tracer as it was
+  ccl_cl_tracer_nz_transform(cosmo,tr_wl,-0.5,1.,&status);
+  ASSERT_EQUAL(CCL_ERROR_INCONSISTENT,status);
+  ASSERT_DBL_NEAR_TOL(dz,tr_wl->nz_shift,1E-10);
+  ASSERT_DBL_NEAR_TOL(stretch,tr_wl->nz_stretch,1E-10);
+  status=0;
+
+  ccl_cl_workspace_free(w);
+  ccl_cl_tracer_free(tr_nc);
+  ccl_cl_tracer_free(tr_wl);
+  ccl_cl_tracer_free(trt_nc);
+  ccl_cl_tracer_free(trt_wl);
+  free(ells); free(cls_direct); free(cls_transf);
+  free(zarr); free(ztarr); free(pzarr); free(bzarr);
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(cls,nz_transform) {
+  compare_nz_transform(data);
+}
@@ -0,0 +1,89 @@
+#include "ccl.h"
+#include "ctest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define CLUSTER_TOLERANCE 1E-3
+#define CLUSTER_NREF 200
+
+CTEST_DATA(cluster_counts) {
+  double Omega_c;
+  double Omega_b;
+  double h;
+  double sigma8;
+  double n_s;
+};
+
+CTEST_SETUP(cluster_counts) {
+  data->Omega_c = 0.25;
+  data->Omega_b = 0.05;
+  data->h = 0.7;
+  data->sigma8 = 0.8;
+  data->n_s = 0.96;
+}
+
+//Smooth selection in log10(M), with the threshold given in params
+static void erf_selection(int n_m, double *halomass, double z, double *sel, void *params)
+{
+  double lm_th=*((double *)params);
+  for(int i=0;i<n_m;i++)
+    sel[i]=0.5*(1+erf((log10(halomass[i])-lm_th)/0.2));
+}
+
+//Brute-force counts in a single bin with Simpson's rule
+static double counts_bin(ccl_cosmology *cosmo,double z0,double z1,double m0,double m1,
+			 double lm_th,double f_sky,int *status)
+{
+  double hz=(z1-z0)/CLUSTER_NREF,hm=log10(m1/m0)/CLUSTER_NREF,sum=0;
+  for(int i=0;i<=CLUSTER_NREF;i++) {
+    double z=z0+i*hz,a=1./(1.+z);
+    double wz=((i==0) || (i==CLUSTER_NREF)) ? 1 : (i%2 ? 4 : 2);
+    double dm=ccl_comoving_angular_distance(cosmo,a,status);
+    double dvdz=dm*dm*ccl_constants.CLIGHT_HMPC/(cosmo->params.h*ccl_h_over_h0(cosmo,a,status));
+    double summ=0;
+    for(int j=0;j<=CLUSTER_NREF;j++) {
+      double lm=log10(m0)+j*hm,m=pow(10.,lm),s;
+      double wm=((j==0) || (j==CLUSTER_NREF)) ? 1 : (j%2 ? 4 : 2);
+      erf_selection(1,&m,z,&s,&lm_th);
+      summ+=wm*ccl_massfunc(cosmo,m,a,200.,status)*s;
+    }
+    sum+=wz*dvdz*summ*hm/3;
+  }
+  return 4*M_PI*f_sky*sum*hz/3;
+}
+
+CTEST2(cluster_counts,bins) {
+  int status=0;
+  double z_edges[3]={0.1,0.4,0.8};
+  double m_edges[3]={1E14,3E14,1E15};
+  double lm_th=14.3,f_sky=0.3;
+  double counts[4];
+  ccl_configuration config=default_config;
+  config.transfer_function_method=ccl_bbks;
+  config.matter_power_spectrum_method=ccl_linear;
+  config.mass_function_method=ccl_tinker10;
+  ccl_parameters params=ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							data->sigma8,data->n_s,&status);
+  ccl_cosmology *cosmo=ccl_cosmology_create(params,config);
+  ASSERT_NOT_NULL(cosmo);
+
+  ccl_cluster_counts(cosmo,2,z_edges,2,m_edges,200.,f_sky,erf_selection,&lm_th,counts,&status);
+  ASSERT_EQUAL(0,status);
+
+  for(int iz=0;iz<2;iz++) {
+    for(int im=0;im<2;im++) {
+      double n=counts_bin(cosmo,z_edges[iz],z_edges[iz+1],m_edges[im],m_edges[im+1],
+			  lm_th,f_sky,&status);
+      ASSERT_DBL_NEAR_TOL(n,counts[iz*2+im],CLUSTER_TOLERANCE*n);
+    }
+  }
+  ASSERT_EQUAL(0,status);
+
+  //Bins that are not increasing are rejected
+  z_edges[1]=0.;
+  ccl_cluster_counts(cosmo,2,z_edges,2,m_edges,200.,f_sky,NULL,NULL,counts,&status);
+  ASSERT_EQUAL(CCL_ERROR_INCONSISTENT,status);
+
+  ccl_cosmology_free(cosmo);
+}
@@ -5,6 +5,8 @@
 #include <math.h>
 #include <time.h>
 #include <string.h>
+#include <gsl/gsl_sf_legendre.h>
+#include <gsl/gsl_sf_bessel.h>
 
 #define CORR_ERROR_FRACTION 0.1
 #define ELL_MAX_CL 10000
@@ -803,3 +805,376 @@ CTEST2(corrs,analytic_bessel) {
 CTEST2(corrs,histo_bessel) {
   compare_corr("histo",CCL_CORR_BESSEL,data);
 }
+
+//Compares the fused tracer-to-correlation calculation with the two-step one
+static void compare_corr_tracers(struct corrs_data * data)
+{
+  int ii,ic,status=0;
+  int nz=512,nth=10;
+  int corr_types[3]={CCL_CORR_GG,CCL_CORR_LP,CCL_CORR_LM};
+  double zarr[512],pzarr[512],bzarr[512],theta[10];
+  double wt_fused[3*10],wt_twostep[10];
+
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->sigma8,data->n_s,&status);
+  params.T_CMB=2.7;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  for(ii=0;ii<nz;ii++) {
+    zarr[ii]=0.25+1.5*(ii+0.5)/nz;
+    pzarr[ii]=exp(-0.5*(zarr[ii]-1.)*(zarr[ii]-1.)/(0.15*0.15));
+    bzarr[ii]=1.;
+  }
+  for(ii=0;ii<nth;ii++)
+    theta[ii]=0.1*pow(20.,ii/(nth-1.));
+
+  CCL_ClTracer *tr_nc=ccl_cl_tracer_number_counts_simple(cosmo,nz,zarr,pzarr,nz,zarr,bzarr,&status);
+  CCL_ClTracer *tr_wl=ccl_cl_tracer_lensing_simple(cosmo,nz,zarr,pzarr,&status);
+  ASSERT_NOT_NULL(tr_nc);
+  ASSERT_NOT_NULL(tr_wl);
+
+  int *ells=malloc(ELL_MAX_CL*sizeof(int));
+  double *larr=malloc(ELL_MAX_CL*sizeof(double));
+  double *clarr=malloc(ELL_MAX_CL*sizeof(double));
+  for(ii=0;ii<ELL_MAX_CL;ii++) {
+    ells[ii]=ii;
+    larr[ii]=ii;
+  }
+  CCL_ClWorkspace *wyl=ccl_cl_workspace_new_limber(ELL_MAX_CL+1,1.05,20,&status);
+
+  for(ic=0;ic<3;ic++) {
+    CCL_ClTracer *tr=(ic==0) ? tr_nc : tr_wl;
+    ccl_correlation_tracers(cosmo,tr,tr,NULL,nth,theta,1,&(corr_types[ic]),wt_fused,
+			    0,NULL,&status);
+    ASSERT_EQUAL(0,status);
+    ccl_angular_cls(cosmo,wyl,tr,tr,NULL,ELL_MAX_CL,ells,clarr,&status);
+    ccl_correlation(cosmo,ELL_MAX_CL,larr,clarr,nth,theta,wt_twostep,corr_types[ic],
+		    0,NULL,CCL_CORR_FFTLOG,&status);
+    ASSERT_EQUAL(0,status);
+    for(ii=0;ii<nth;ii++)
+      ASSERT_DBL_NEAR_TOL(1.,wt_fused[ii]/wt_twostep[ii],CORR_ERROR_FRACTION);
+  }
+
+  //All correlation types at once for the shear tracer
+  ccl_correlation_tracers(cosmo,tr_wl,tr_wl,NULL,nth,theta,2,&(corr_types[1]),wt_fused,
+			  0,NULL,&status);
+  ASSERT_EQUAL(0,status);
+  for(ic=1;ic<3;ic++) {
+    ccl_correlation_tracers(cosmo,tr_wl,tr_wl,NULL,nth,theta,1,&(corr_types[ic]),wt_twostep,
+			    0,NULL,&status);
+    for(ii=0;ii<nth;ii++)
+      ASSERT_DBL_NEAR_TOL(1.,wt_fused[(ic-1)*nth+ii]/wt_twostep[ii],1E-10);
+  }
+
+  free(ells);
+  free(larr);
+  free(clarr);
+  ccl_cl_workspace_free(wyl);
+  ccl_cl_tracer_free(tr_nc);
+  ccl_cl_tracer_free(tr_wl);
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(corrs,tracers_fftlog) {
+  compare_corr_tracers(data);
+}
+
+//Checks the Legendre recurrences and bin averages against GSL
+static void check_corr_matrix(void)
+{
+  int i,j,l,status=0;
+  int ell_max=200,n_sub=2000;
+  double theta_lo[2]={0.5,2.},theta_hi[2]={1.,3.};
+  int corr_types[2]={CCL_CORR_GG,CCL_CORR_GL};
+
+  for(j=0;j<2;j++) {
+    CCL_CorrMatrix *cm=ccl_corr_matrix_new(corr_types[j],ell_max,2,theta_lo,NULL,&status);
+    CCL_CorrMatrix *cm_bin=ccl_corr_matrix_new(corr_types[j],ell_max,2,theta_lo,theta_hi,&status);
+    ASSERT_EQUAL(0,status);
+
+    for(i=0;i<2;i++) {
+      double x=cos(theta_lo[i]*M_PI/180);
+      double x_lo=cos(theta_hi[i]*M_PI/180),x_hi=x;
+      for(l=2;l<ell_max;l+=7) {
+	double w,w_bin=0;
+	int k;
+	if(corr_types[j]==CCL_CORR_GG)
+	  w=(2*l+1.)*gsl_sf_legendre_Pl(l,x)/(4*M_PI);
+	else
+	  w=(2*l+1.)*gsl_sf_legendre_Plm(l,2,x)/(l*(l+1.)*4*M_PI);
+	ASSERT_DBL_NEAR_TOL(w,cm->w[i*ell_max+l],1E-8*fabs(w)+1E-12);
+
+	//Midpoint average in x
+	for(k=0;k<n_sub;k++) {
+	  double xx=x_lo+(x_hi-x_lo)*(k+0.5)/n_sub;
+	  if(corr_types[j]==CCL_CORR_GG)
+	    w_bin+=(2*l+1.)*gsl_sf_legendre_Pl(l,xx)/(4*M_PI);
+	  else
+	    w_bin+=(2*l+1.)*gsl_sf_legendre_Plm(l,2,xx)/(l*(l+1.)*4*M_PI);
+	}
+	w_bin/=n_sub;
+	ASSERT_DBL_NEAR_TOL(w_bin,cm_bin->w[i*ell_max+l],1E-5*fabs(cm->w[i*ell_max+l])+1E-10);
+      }
+    }
+
+    //Several power spectra at once
+    double cls[2*200],wth[2*2];
+    for(l=0;l<ell_max;l++) {
+      cls[l]=1./(l+1.);
+      cls[ell_max+l]=2./(l+1.);
+    }
+    ccl_corr_matrix_apply(cm,2,cls,wth);
+    for(i=0;i<2;i++) {
+      double sum=0;
+      for(l=0;l<ell_max;l++)
+	sum+=cm->w[i*ell_max+l]*cls[l];
+      ASSERT_DBL_NEAR_TOL(sum,wth[i],1E-10*fabs(sum));
+      ASSERT_DBL_NEAR_TOL(2*sum,wth[2+i],1E-10*fabs(sum));
+    }
+
+    ccl_corr_matrix_free(cm);
+    ccl_corr_matrix_free(cm_bin);
+  }
+}
+
+CTEST(corrs,legendre_matrix) {
+  check_corr_matrix();
+}
+
+//Bessel method applied to a Gaussian power spectrum, for which
+//Integral[ l J_0(l*theta) exp(-l^2 s^2/2) dl ] = exp(-theta^2/(2 s^2))/s^2
+static void check_corr_bessel_gaussian(struct corrs_data * data)
+{
+  int ii,status=0;
+  int nl=20000,nth=8;
+  double sig=1./300.;
+  double theta[8],wtheta[8];
+
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->sigma8,data->n_s,&status);
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  double *larr=malloc(nl*sizeof(double));
+  double *clarr=malloc(nl*sizeof(double));
+  for(ii=0;ii<nl;ii++) {
+    larr[ii]=ii;
+    clarr[ii]=exp(-0.5*ii*ii*sig*sig);
+  }
+  for(ii=0;ii<nth;ii++)
+    theta[ii]=0.05*(ii+1);
+
+  ccl_correlation(cosmo,nl,larr,clarr,nth,theta,wtheta,CCL_CORR_GG,
+		  0,NULL,CCL_CORR_BESSEL,&status);
+  ASSERT_EQUAL(0,status);
+  for(ii=0;ii<nth;ii++) {
+    double th=theta[ii]*M_PI/180;
+    double w_exact=exp(-0.5*th*th/(sig*sig))/(sig*sig*2*M_PI);
+    ASSERT_DBL_NEAR_TOL(w_exact,wtheta[ii],1E-6/(sig*sig*2*M_PI));
+  }
+
+  free(larr);
+  free(clarr);
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(corrs,bessel_gaussian) {
+  check_corr_bessel_gaussian(data);
+}
+
+//Flat-sky correlation function of order n (0, 2 or 4) for a Gaussian beam C_l=exp(-l^2 sig^2/2):
+//  xi_n(t) = Integral[ l dl J_n(l t) C_l ]/(2 pi)
+//          = sqrt(pi) t/(8 a^(3/2)) e^(-v) [I_{(n-1)/2}(v) - I_{(n+1)/2}(v)]/(2 pi),
+//with a=sig^2/2 and v=t^2/(8 a).
+static double gaussian_xi_flat(int n,double sig,double t)
+{
+  double a=0.5*sig*sig,v=t*t/(8*a);
+  if(n==0)
+    return exp(-0.5*t*t/(sig*sig))/(2*M_PI*sig*sig);
+  return sqrt(M_PI)*t*(gsl_sf_bessel_Inu_scaled(0.5*(n-1),v)-gsl_sf_bessel_Inu_scaled(0.5*(n+1),v))/
+    (8*pow(a,1.5)*2*M_PI);
+}
+
+//Average of gaussian_xi_flat over [t_lo,t_hi] with weight t, using Simpson's rule
+static double gaussian_xi_flat_bin(int n,double sig,double t_lo,double t_hi)
+{
+  int ii,nt=1000;
+  double dt=(t_hi-t_lo)/nt,sum=0;
+  for(ii=0;ii<=nt;ii++) {
+    double t=t_lo+ii*dt;
+    double w=((ii==0) || (ii==nt)) ? 1. : ((ii%2) ? 4. : 2.);
+    sum+=w*t*gaussian_xi_flat(n,sig,t);
+  }
+  return 2*sum*dt/(3*(t_hi*t_hi-t_lo*t_lo));
+}
+
+//Bin-averaged correlation functions for a Gaussian beam, for which the average
+//of w(theta) over a bin with weight theta is known analytically.
+static void check_corr_binned_gaussian(struct corrs_data * data)
+{
+  int ii,im,status=0;
+  int nl=20000,nth=8;
+  double sig=1./300.;
+  double th_lo[8],th_hi[8],wtheta[8];
+  int methods[3]={CCL_CORR_BESSEL,CCL_CORR_FFTLOG,CCL_CORR_LGNDRE};
+  double tols[3]={1E-6,1E-3,1E-4};
+
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->sigma8,data->n_s,&status);
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  double *larr=malloc(nl*sizeof(double));
+  double *clarr=malloc(nl*sizeof(double));
+  for(ii=0;ii<nl;ii++) {
+    larr[ii]=ii;
+    clarr[ii]=exp(-0.5*ii*ii*sig*sig);
+  }
+  for(ii=0;ii<nth;ii++) {
+    th_lo[ii]=0.05*(ii+1);
+    th_hi[ii]=0.05*(ii+2);
+  }
+
+  for(im=0;im<3;im++) {
+    ccl_correlation_binned(cosmo,nl,larr,clarr,nth,th_lo,th_hi,wtheta,CCL_CORR_GG,
+			   0,NULL,methods[im],&status);
+    ASSERT_EQUAL(0,status);
+    for(ii=0;ii<nth;ii++) {
+      double t_lo=th_lo[ii]*M_PI/180,t_hi=th_hi[ii]*M_PI/180;
+      double w_exact=(exp(-0.5*t_lo*t_lo/(sig*sig))-exp(-0.5*t_hi*t_hi/(sig*sig)))/
+	(M_PI*(t_hi*t_hi-t_lo*t_lo));
+      ASSERT_DBL_NEAR_TOL(w_exact,wtheta[ii],tols[im]/(sig*sig*2*M_PI));
+    }
+  }
+
+  //Spin-2 correlations, which use the integrals of t J_n(t) for n=2 and 4 with the Bessel method
+  //and the bin-averaged P_l^2 weights with the Legendre method (full-sky xi+- is not supported)
+  int types[3]={CCL_CORR_GL,CCL_CORR_LP,CCL_CORR_LM};
+  int orders[3]={2,0,4};
+  for(int it=0;it<3;it++) {
+    for(im=0;im<3;im++) {
+      if((methods[im]==CCL_CORR_LGNDRE) && (types[it]!=CCL_CORR_GL))
+	continue;
+      ccl_correlation_binned(cosmo,nl,larr,clarr,nth,th_lo,th_hi,wtheta,types[it],
+			     0,NULL,methods[im],&status);
+      ASSERT_EQUAL(0,status);
+      for(ii=0;ii<nth;ii++) {
+	double w_exact=gaussian_xi_flat_bin(orders[it],sig,th_lo[ii]*M_PI/180,th_hi[ii]*M_PI/180);
+	ASSERT_DBL_NEAR_TOL(w_exact,wtheta[ii],tols[im]/(sig*sig*2*M_PI));
+      }
+    }
+  }
+
+  free(larr);
+  free(clarr);
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(corrs,binned_gaussian) {
+  check_corr_binned_gaussian(data);
+}
+
+//Flat-sky Bessel weights and projection of harmonic-space covariances
+static void check_corr_matrix_bessel(void)
+{
+  int ii,jj,ll,ll2,status=0;
+  int nl=3000,nth=6,nl_s=20;
+  double sig=1./300.;
+  double th_lo[6],th_hi[6],wth[6],wth_bin[6];
+  double ell_s[20],dell_s[20],var_cl[20],cov_cl[400];
+  double cov_xi[36],cov_xi_diag[36];
+
+  double *clarr=malloc(nl*sizeof(double));
+  for(ll=0;ll<nl;ll++)
+    clarr[ll]=exp(-0.5*ll*ll*sig*sig);
+  for(ii=0;ii<nth;ii++) {
+    th_lo[ii]=0.05*(ii+1);
+    th_hi[ii]=0.05*(ii+2);
+  }
+
+  CCL_CorrMatrix *cm=ccl_corr_matrix_bessel_new(CCL_CORR_GG,nl,NULL,NULL,nth,th_lo,NULL,&status);
+  CCL_CorrMatrix *cm_bin=ccl_corr_matrix_bessel_new(CCL_CORR_GG,nl,NULL,NULL,nth,th_lo,th_hi,&status);
+  ASSERT_EQUAL(0,status);
+  ASSERT_NOT_NULL(cm);
+  ASSERT_NOT_NULL(cm_bin);
+
+  //Gaussian beam: point values and bin averages with weight theta
+  ccl_corr_matrix_apply(cm,1,clarr,wth);
+  ccl_corr_matrix_apply(cm_bin,1,clarr,wth_bin);
+  for(ii=0;ii<nth;ii++) {
+    double t=th_lo[ii]*M_PI/180,t_lo=t,t_hi=th_hi[ii]*M_PI/180;
+    double w_exact=exp(-0.5*t*t/(sig*sig))/(sig*sig*2*M_PI);
+    double w_exact_bin=(exp(-0.5*t_lo*t_lo/(sig*sig))-exp(-0.5*t_hi*t_hi/(sig*sig)))/
+      (M_PI*(t_hi*t_hi-t_lo*t_lo));
+    ASSERT_DBL_NEAR_TOL(w_exact,wth[ii],1E-4/(sig*sig*2*M_PI));
+    ASSERT_DBL_NEAR_TOL(w_exact_bin,wth_bin[ii],1E-4/(sig*sig*2*M_PI));
+  }
+  ccl_corr_matrix_free(cm);
+  ccl_corr_matrix_free(cm_bin);
+  free(clarr);
+
+  //Projections of a small dense covariance over band powers must agree with a direct sum
+  for(ll=0;ll<nl_s;ll++) {
+    ell_s[ll]=50.*(ll+0.5);
+    dell_s[ll]=50.;
+    var_cl[ll]=exp(-ell_s[ll]*ell_s[ll]*sig*sig)/(ell_s[ll]*dell_s[ll]);
+  }
+  for(ll=0;ll<nl_s;ll++) {
+    for(ll2=0;ll2<nl_s;ll2++)
+      cov_cl[ll*nl_s+ll2]=0.1*sqrt(var_cl[ll]*var_cl[ll2])+((ll==ll2) ? var_cl[ll] : 0);
+  }
+  cm=ccl_corr_matrix_bessel_new(CCL_CORR_GG,nl_s,ell_s,dell_s,nth,th_lo,NULL,&status);
+  cm_bin=ccl_corr_matrix_bessel_new(CCL_CORR_GG,nl_s,ell_s,dell_s,nth,th_lo,th_hi,&status);
+  ASSERT_EQUAL(0,status);
+  ASSERT_NOT_NULL(cm);
+  ASSERT_NOT_NULL(cm_bin);
+
+  ccl_corr_matrix_project_cov(cm,cm_bin,cov_cl,cov_xi,&status);
+  ASSERT_EQUAL(0,status);
+  ccl_corr_matrix_project_cov_diag(cm,cm_bin,var_cl,cov_xi_diag,&status);
+  ASSERT_EQUAL(0,status);
+  for(ii=0;ii<nth;ii++) {
+    for(jj=0;jj<nth;jj++) {
+      double c=0,c_abs=0,c_diag=0,c_diag_abs=0;
+      for(ll=0;ll<nl_s;ll++) {
+	double d=cm->w[ii*nl_s+ll]*var_cl[ll]*cm_bin->w[jj*nl_s+ll];
+	c_diag+=d;
+	c_diag_abs+=fabs(d);
+	for(ll2=0;ll2<nl_s;ll2++) {
+	  d=cm->w[ii*nl_s+ll]*cov_cl[ll*nl_s+ll2]*cm_bin->w[jj*nl_s+ll2];
+	  c+=d;
+	  c_abs+=fabs(d);
+	}
+      }
+      ASSERT_DBL_NEAR_TOL(c,cov_xi[ii*nth+jj],1E-10*c_abs);
+      ASSERT_DBL_NEAR_TOL(c_diag,cov_xi_diag[ii*nth+jj],1E-10*c_diag_abs);
+    }
+  }
+
+  //Matrices defined on different multipoles cannot be combined
+  ccl_corr_matrix_free(cm_bin);
+  cm_bin=ccl_corr_matrix_bessel_new(CCL_CORR_GG,nl_s-1,ell_s,dell_s,nth,th_lo,th_hi,&status);
+  ASSERT_EQUAL(0,status);
+  ccl_corr_matrix_project_cov_diag(cm,cm_bin,var_cl,cov_xi_diag,&status);
+  ASSERT_EQUAL(CCL_ERROR_INCONSISTENT,status);
+  status=0;
+  ccl_corr_matrix_project_cov(cm,cm_bin,cov_cl,cov_xi,&status);
+  ASSERT_EQUAL(CCL_ERROR_INCONSISTENT,status);
+
+  ccl_corr_matrix_free(cm);
+  ccl_corr_matrix_free(cm_bin);
+}
+
+CTEST(corrs,bessel_matrix) {
+  check_corr_matrix_bessel();
+}
@@ -164,3 +164,137 @@ CTEST2(corrs_3dRSD,model_3) {
   int model=3;
   compare_correlation_3dRSD(model,data);
 }
+
+CTEST2(corrs_3dRSD,pi_sigma_grid) {
+  int i,j,status=0;
+  double beta=0.5;
+  double pi_arr[3]={0.,10.,50.};
+  double sig_arr[4]={5.,20.,40.,80.};
+  double xi_grid[12],xi_row[4],xi_3d[1];
+  ccl_configuration config = default_config;
+  ccl_parameters params = ccl_parameters_create(data->Omega_c,data->Omega_b,data->Omega_k[0],
+		data->Neff, data->mnu, data->mnu_type, data->w_0[0],data->w_a[0],
+		data->h,data->A_s,data->n_s,-1, -1, -1, -1,NULL,NULL, &status);
+  params.Omega_g=0.0;
+  params.Omega_l=data->Omega_v[0];
+  params.sigma8=data->sigma8;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  // The grid must agree with the row-by-row and point-by-point calculations
+  ccl_correlation_pi_sigma_grid(cosmo,1.0,beta,3,pi_arr,4,sig_arr,xi_grid,1,&status);
+  ASSERT_EQUAL(0,status);
+  for(j=0;j<3;j++) {
+    ccl_correlation_pi_sigma(cosmo,1.0,beta,pi_arr[j],4,sig_arr,xi_row,1,&status);
+    ASSERT_EQUAL(0,status);
+    for(i=0;i<4;i++) {
+      double s=sqrt(pi_arr[j]*pi_arr[j]+sig_arr[i]*sig_arr[i]);
+      ccl_correlation_3dRsd(cosmo,1.0,1,&s,pi_arr[j]/s,beta,xi_3d,1,&status);
+      ASSERT_EQUAL(0,status);
+      ASSERT_DBL_NEAR_TOL(xi_row[i],xi_grid[j*4+i],1E-10*fabs(xi_row[i]));
+      ASSERT_DBL_NEAR_TOL(xi_3d[0],xi_grid[j*4+i],1E-6*fabs(xi_3d[0]));
+    }
+  }
+
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(corrs_3dRSD,multipole_cache) {
+  int i,j,status=0;
+  double beta=0.5;
+  double a_arr[3]={0.5,0.8,1.0};
+  double r_arr[4]={1.,10.,50.,120.};
+  double xi_tab0[12],xi_tab4[12],xi_3d[4],xi_4[4];
+  ccl_configuration config = default_config;
+  ccl_parameters params = ccl_parameters_create(data->Omega_c,data->Omega_b,data->Omega_k[0],
+		data->Neff, data->mnu, data->mnu_type, data->w_0[0],data->w_a[0],
+		data->h,data->A_s,data->n_s,-1, -1, -1, -1,NULL,NULL, &status);
+  params.Omega_g=0.0;
+  params.Omega_l=data->Omega_v[0];
+  params.sigma8=data->sigma8;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  // Compute one scale factor first, then the rest in a single pass
+  ccl_correlation_multipole_spline(cosmo,a_arr[1],&status);
+  ASSERT_EQUAL(0,status);
+  ASSERT_EQUAL(1,cosmo->data.n_xi_cache);
+  ccl_correlation_multipole_cache(cosmo,3,a_arr,&status);
+  ASSERT_EQUAL(0,status);
+  ASSERT_EQUAL(3,cosmo->data.n_xi_cache);
+
+  ccl_correlation_multipole_table(cosmo,0,3,a_arr,4,r_arr,xi_tab0,&status);
+  ASSERT_EQUAL(0,status);
+  ccl_correlation_multipole_table(cosmo,4,3,a_arr,4,r_arr,xi_tab4,&status);
+  ASSERT_EQUAL(0,status);
+  ASSERT_EQUAL(3,cosmo->data.n_xi_cache);
+
+  // The table must agree with the uncached (tapered) and single-a calculations
+  double taper_pk_limits[4]={0.,0.,1E10,1E11};
+  for(j=0;j<3;j++) {
+    ccl_correlation_3d(cosmo,a_arr[j],4,r_arr,xi_3d,1,taper_pk_limits,&status);
+    ASSERT_EQUAL(0,status);
+    ccl_correlation_multipole(cosmo,a_arr[j],beta,4,4,r_arr,xi_4,&status);
+    ASSERT_EQUAL(0,status);
+    for(i=0;i<4;i++) {
+      ASSERT_DBL_NEAR_TOL(xi_3d[i],xi_tab0[j*4+i],1E-6*fabs(xi_3d[i]));
+      ASSERT_DBL_NEAR_TOL(xi_4[i],8./35*beta*beta*xi_tab4[j*4+i],1E-10*fabs(xi_4[i]));
+    }
+  }
+
+  // Scale factors differing only by rounding share an entry
+  double a_round=a_arr[1]*(1+1E-14);
+  ccl_correlation_multipole_spline(cosmo,a_round,&status);
+  ASSERT_EQUAL(0,status);
+  ASSERT_EQUAL(3,cosmo->data.n_xi_cache);
+
+  // Clearing the cache frees all entries, and they are recomputed identically
+  ccl_cosmology_clear_xi_cache(cosmo);
+  ASSERT_EQUAL(0,cosmo->data.n_xi_cache);
+  ccl_correlation_multipole_table(cosmo,0,3,a_arr,4,r_arr,xi_tab4,&status);
+  ASSERT_EQUAL(0,status);
+  ASSERT_EQUAL(3,cosmo->data.n_xi_cache);
+  for(i=0;i<12;i++)
+    ASSERT_DBL_NEAR_TOL(xi_tab0[i],xi_tab4[i],1E-10*fabs(xi_tab0[i]));
+
+  ccl_cosmology_free(cosmo);
+}
+
+CTEST2(corrs_3dRSD,kaiser_multipoles) {
+  int i,j,l,status=0;
+  double a_arr[2]={0.5,1.0};
+  double beta[2]={0.8,0.5};
+  double k_arr[3]={0.01,0.1,1.};
+  double r_arr[3]={5.,30.,100.};
+  double pk_ell[18],xi_ell[18],xi_l[3];
+  ccl_configuration config = default_config;
+  ccl_parameters params = ccl_parameters_create(data->Omega_c,data->Omega_b,data->Omega_k[0],
+		data->Neff, data->mnu, data->mnu_type, data->w_0[0],data->w_a[0],
+		data->h,data->A_s,data->n_s,-1, -1, -1, -1,NULL,NULL, &status);
+  params.Omega_g=0.0;
+  params.Omega_l=data->Omega_v[0];
+  params.sigma8=data->sigma8;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  ccl_rsd_multipoles(cosmo,2,a_arr,beta,3,k_arr,pk_ell,3,r_arr,xi_ell,&status);
+  ASSERT_EQUAL(0,status);
+  for(j=0;j<2;j++) {
+    double b=beta[j];
+    double fac[3]={1.+2.*b/3.+b*b/5.,4.*b/3.+4.*b*b/7.,8.*b*b/35.};
+    for(i=0;i<3;i++) {
+      double pk=ccl_nonlin_matter_power(cosmo,k_arr[i],a_arr[j],&status);
+      for(l=0;l<3;l++)
+	ASSERT_DBL_NEAR_TOL(1.,pk_ell[(j*3+l)*3+i]/(fac[l]*pk),1E-8);
+    }
+    // The correlation multipoles must match ccl_correlation_multipole
+    for(l=0;l<3;l++) {
+      ccl_correlation_multipole(cosmo,a_arr[j],b,2*l,3,r_arr,xi_l,&status);
+      ASSERT_EQUAL(0,status);
+      for(i=0;i<3;i++)
+	ASSERT_DBL_NEAR_TOL(xi_l[i],xi_ell[(j*3+l)*3+i],1E-10*fabs(xi_l[i]));
+    }
+  }
+
+  ccl_cosmology_free(cosmo);
+}
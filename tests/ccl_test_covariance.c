@@ -0,0 +1,290 @@
+#include "ccl.h"
+#include "ctest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <gsl/gsl_sf_bessel.h>
+
+#define COV_NTR 3
+#define COV_NELL 4
+
+CTEST_DATA(covariance) {
+  double Omega_c;
+  double Omega_b;
+  double h;
+  double sigma8;
+  double n_s;
+};
+
+CTEST_SETUP(covariance) {
+  data->Omega_c = 0.25;
+  data->Omega_b = 0.05;
+  data->h = 0.7;
+  data->sigma8 = 0.8;
+  data->n_s = 0.96;
+}
+
+//Brute-force Knox formula for a single element
+static double knox(double *cls,double *noise,double *ell,double *dell,double fsky,
+		   int i,int j,int k,int m,int l)
+{
+  double ct[COV_NTR][COV_NTR];
+  int a,b;
+  for(a=0;a<COV_NTR;a++) {
+    for(b=0;b<COV_NTR;b++)
+      ct[a][b]=cls[(CCL_MIN(a,b)*COV_NTR+CCL_MAX(a,b))*COV_NELL+l]+((a==b) ? noise[a] : 0);
+  }
+  return (ct[i][k]*ct[j][m]+ct[i][m]*ct[j][k])/((2*ell[l]+1)*dell[l]*fsky);
+}
+
+CTEST2(covariance,knox) {
+  int status=0,i,j,k,m,l,l2;
+  int n_pairs=COV_NTR*(COV_NTR+1)/2,n_data=n_pairs*COV_NELL;
+  double ell[COV_NELL]={20.,60.,150.,400.};
+  double dell[COV_NELL]={20.,60.,120.,380.};
+  double noise[COV_NTR]={1E-9,2E-9,3E-9};
+  double fsky=0.4;
+  double cls[COV_NTR*COV_NTR*COV_NELL];
+  double *cov=malloc(n_data*n_data*sizeof(double));
+  ASSERT_NOT_NULL(cov);
+
+  //Pair indices cover all pairs once
+  ASSERT_EQUAL(0,ccl_covariance_pair_index(COV_NTR,0,0));
+  ASSERT_EQUAL(COV_NTR,ccl_covariance_pair_index(COV_NTR,1,1));
+  ASSERT_EQUAL(ccl_covariance_pair_index(COV_NTR,2,1),ccl_covariance_pair_index(COV_NTR,1,2));
+  ASSERT_EQUAL(n_pairs-1,ccl_covariance_pair_index(COV_NTR,COV_NTR-1,COV_NTR-1));
+
+  for(i=0;i<COV_NTR;i++) {
+    for(j=0;j<COV_NTR;j++) {
+      for(l=0;l<COV_NELL;l++)
+	cls[(i*COV_NTR+j)*COV_NELL+l]=1E-8*(1+i+j)/(1+ell[l]/100.);
+    }
+  }
+
+  ccl_covariance_cls_gaussian(COV_NTR,COV_NELL,ell,dell,cls,noise,fsky,cov,&status);
+  ASSERT_EQUAL(0,status);
+
+  for(i=0;i<COV_NTR;i++) {
+    for(j=i;j<COV_NTR;j++) {
+      int p=ccl_covariance_pair_index(COV_NTR,i,j);
+      for(k=0;k<COV_NTR;k++) {
+	for(m=k;m<COV_NTR;m++) {
+	  int q=ccl_covariance_pair_index(COV_NTR,k,m);
+	  for(l=0;l<COV_NELL;l++) {
+	    for(l2=0;l2<COV_NELL;l2++) {
+	      double c=cov[(p*COV_NELL+l)*n_data+q*COV_NELL+l2];
+	      if(l!=l2)
+		ASSERT_DBL_NEAR_TOL(0.,c,1E-300);
+	      else {
+		double c_ex=knox(cls,noise,ell,dell,fsky,i,j,k,m,l);
+		ASSERT_DBL_NEAR_TOL(1.,c/c_ex,1E-12);
+	      }
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+  free(cov);
+}
+
+CTEST2(covariance,tracers) {
+  int status=0,ii,l;
+  int nz=256,n_pairs=3,n_data=3*COV_NELL;
+  double ell[COV_NELL]={20.,60.,150.,400.};
+  double dell[COV_NELL]={20.,60.,120.,380.};
+  double noise[2]={1E-8,1E-9};
+  double zarr[256],pzarr[256],bzarr[256];
+  double cl_nn[COV_NELL],cl_nw[COV_NELL],cl_ww[COV_NELL];
+  double *cov=malloc(n_data*n_data*sizeof(double));
+  ASSERT_NOT_NULL(cov);
+
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->sigma8,data->n_s,&status);
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  for(ii=0;ii<nz;ii++) {
+    zarr[ii]=0.25+1.5*(ii+0.5)/nz;
+    pzarr[ii]=exp(-0.5*(zarr[ii]-1.)*(zarr[ii]-1.)/(0.15*0.15));
+    bzarr[ii]=1.;
+  }
+  CCL_ClTracer *tr[2];
+  tr[0]=ccl_cl_tracer_number_counts_simple(cosmo,nz,zarr,pzarr,nz,zarr,bzarr,&status);
+  tr[1]=ccl_cl_tracer_lensing_simple(cosmo,nz,zarr,pzarr,&status);
+  ASSERT_NOT_NULL(tr[0]);
+  ASSERT_NOT_NULL(tr[1]);
+
+  ccl_covariance_gaussian(cosmo,NULL,2,tr,NULL,noise,0.4,COV_NELL,ell,dell,cov,&status);
+  ASSERT_EQUAL(0,status);
+
+  ccl_angular_cls_limber(cosmo,NULL,tr[0],tr[0],NULL,COV_NELL,ell,cl_nn,&status);
+  ccl_angular_cls_limber(cosmo,NULL,tr[0],tr[1],NULL,COV_NELL,ell,cl_nw,&status);
+  ccl_angular_cls_limber(cosmo,NULL,tr[1],tr[1],NULL,COV_NELL,ell,cl_ww,&status);
+  ASSERT_EQUAL(0,status);
+
+  //Check a few elements against the Knox formula
+  for(l=0;l<COV_NELL;l++) {
+    double pref=1./((2*ell[l]+1)*dell[l]*0.4);
+    double ct_nn=cl_nn[l]+noise[0],ct_ww=cl_ww[l]+noise[1];
+    //Var(C_nn)
+    ASSERT_DBL_NEAR_TOL(1.,cov[l*n_data+l]/(2*ct_nn*ct_nn*pref),1E-10);
+    //Cov(C_nn,C_nw)
+    ASSERT_DBL_NEAR_TOL(1.,cov[l*n_data+COV_NELL+l]/(2*ct_nn*cl_nw[l]*pref),1E-10);
+    //Var(C_nw)
+    ASSERT_DBL_NEAR_TOL(1.,cov[(COV_NELL+l)*n_data+COV_NELL+l]/
+			((ct_nn*ct_ww+cl_nw[l]*cl_nw[l])*pref),1E-10);
+  }
+  ASSERT_EQUAL(n_pairs-1,ccl_covariance_pair_index(2,1,1));
+
+  ccl_cl_tracer_free(tr[0]);
+  ccl_cl_tracer_free(tr[1]);
+  ccl_cosmology_free(cosmo);
+  free(cov);
+}
+
+CTEST2(covariance,nongaussian) {
+  int status=0,ii,l,l2;
+  int nz=256,n_data=3*COV_NELL,n_a=64,n_k=128,n_chi=2048;
+  double ell[COV_NELL]={20.,60.,150.,400.};
+  double zarr[256],pzarr[256],bzarr[256],a[64],k[128];
+  double *cov_1h=malloc(n_data*n_data*sizeof(double));
+  double *cov_ssc=malloc(n_data*n_data*sizeof(double));
+  double *cov_1h_half=malloc(n_data*n_data*sizeof(double));
+  double *chi=malloc(2*n_chi*sizeof(double));
+  ASSERT_NOT_NULL(cov_1h);
+  ASSERT_NOT_NULL(cov_ssc);
+  ASSERT_NOT_NULL(cov_1h_half);
+  ASSERT_NOT_NULL(chi);
+
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_eisenstein_hu;
+  config.matter_power_spectrum_method = ccl_linear;
+  config.mass_function_method = ccl_shethtormen;
+  config.halo_concentration_method = ccl_duffy2008;
+  ccl_parameters params = ccl_parameters_create_flat_lcdm(data->Omega_c,data->Omega_b,data->h,
+							  data->sigma8,data->n_s,&status);
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  for(ii=0;ii<nz;ii++) {
+    zarr[ii]=0.25+1.5*(ii+0.5)/nz;
+    pzarr[ii]=exp(-0.5*(zarr[ii]-1.)*(zarr[ii]-1.)/(0.15*0.15));
+    bzarr[ii]=1.;
+  }
+  CCL_ClTracer *tr[2];
+  tr[0]=ccl_cl_tracer_number_counts_simple(cosmo,nz,zarr,pzarr,nz,zarr,bzarr,&status);
+  tr[1]=ccl_cl_tracer_lensing_simple(cosmo,nz,zarr,pzarr,&status);
+  ASSERT_NOT_NULL(tr[0]);
+  ASSERT_NOT_NULL(tr[1]);
+
+  //The Limber kernels reproduce the Limber power spectra
+  for(ii=0;ii<n_chi;ii++)
+    chi[ii]=ccl_comoving_radial_distance(cosmo,1./(1.+2.*(ii+0.5)/n_chi),&status);
+  for(l=0;l<COV_NELL;l++) {
+    double cl_ww,cl=0;
+    ccl_angular_cls_limber(cosmo,NULL,tr[1],tr[1],NULL,1,&(ell[l]),&cl_ww,&status);
+    ccl_get_tracer_limber_kernel(cosmo,tr[1],ell[l],n_chi,chi,&(chi[n_chi]),&status);
+    for(ii=0;ii<n_chi-1;ii++) {
+      double chi_m=0.5*(chi[ii]+chi[ii+1]),q_m=0.5*(chi[n_chi+ii]+chi[n_chi+ii+1]);
+      double pk=ccl_linear_matter_power(cosmo,(ell[l]+0.5)/chi_m,
+					ccl_scale_factor_of_chi(cosmo,chi_m,&status),&status);
+      cl+=(chi[ii+1]-chi[ii])*q_m*q_m*pk/(chi_m*chi_m);
+    }
+    ASSERT_DBL_NEAR_TOL(1.,cl/cl_ww,1E-3);
+  }
+  ASSERT_EQUAL(0,status);
+
+  for(ii=0;ii<n_a;ii++)
+    a[ii]=1./(1.+2.5*(n_a-1-ii)/(n_a-1.));
+  for(ii=0;ii<n_k;ii++)
+    k[ii]=1E-4*pow(10.,6.*ii/(n_k-1.));
+  ccl_halomod_workspace *hw=ccl_halomod_workspace_new(cosmo,n_a,a,n_k,k,&status);
+  ASSERT_NOT_NULL(hw);
+
+  ccl_covariance_nongaussian(cosmo,hw,2,tr,0.4,COV_NELL,ell,cov_1h,cov_ssc,&status);
+  ccl_covariance_nongaussian(cosmo,hw,2,tr,0.2,COV_NELL,ell,cov_1h_half,NULL,&status);
+  ASSERT_EQUAL(0,status);
+
+  //Both terms are symmetric, positive on the diagonal, and the trispectrum term scales as 1/f_sky
+  for(l=0;l<n_data;l++) {
+    ASSERT_TRUE(cov_1h[l*n_data+l]>0);
+    ASSERT_TRUE(cov_ssc[l*n_data+l]>0);
+    for(l2=0;l2<n_data;l2++) {
+      ASSERT_DBL_NEAR_TOL(cov_1h[l*n_data+l2],cov_1h[l2*n_data+l],1E-12*fabs(cov_1h[l*n_data+l2]));
+      ASSERT_DBL_NEAR_TOL(cov_ssc[l*n_data+l2],cov_ssc[l2*n_data+l],1E-12*fabs(cov_ssc[l*n_data+l2]));
+      ASSERT_DBL_NEAR_TOL(2*cov_1h[l*n_data+l2],cov_1h_half[l*n_data+l2],1E-12*fabs(cov_1h_half[l*n_data+l2]));
+    }
+  }
+
+  //Direct quadrature of Cov(C^{nw}_60,C^{ww}_150) over the workspace scale factors. The
+  //trispectrum and the response are evaluated at the exact Limber wavenumbers, using a
+  //workspace per scale factor, and the variance of the background mode is integrated
+  //on a fine grid
+  {
+    int il1=1,il2=2,n_kb=20000;
+    double omega_s=4*M_PI*0.4,theta_s=sqrt(omega_s/M_PI);
+    double lkb_min=log(cosmo->spline_params.K_MIN),lkb_max=log(cosmo->spline_params.K_MAX);
+    double dlkb=(lkb_max-lkb_min)/(n_kb-1);
+    double c_1h=0,c_ssc=0;
+    double *chi_a=malloc(5*n_a*sizeof(double));
+    double *q_n1=&(chi_a[n_a]),*q_w1=&(chi_a[2*n_a]),*q_w2=&(chi_a[3*n_a]),*w_a=&(chi_a[4*n_a]);
+    ASSERT_NOT_NULL(chi_a);
+
+    for(ii=0;ii<n_a;ii++)
+      chi_a[ii]=ccl_comoving_radial_distance(cosmo,a[ii],&status);
+    for(ii=0;ii<n_a;ii++)
+      w_a[ii]=0.5*fabs(chi_a[(ii==n_a-1) ? ii : ii+1]-chi_a[(ii==0) ? ii : ii-1]);
+    ccl_get_tracer_limber_kernel(cosmo,tr[0],ell[il1],n_a,chi_a,q_n1,&status);
+    ccl_get_tracer_limber_kernel(cosmo,tr[1],ell[il1],n_a,chi_a,q_w1,&status);
+    ccl_get_tracer_limber_kernel(cosmo,tr[1],ell[il2],n_a,chi_a,q_w2,&status);
+    ASSERT_EQUAL(0,status);
+
+    for(ii=0;ii<n_a;ii++) {
+      double kl[2],tk[4],dpk[2],sb=0,qq=q_n1[ii]*q_w1[ii]*q_w2[ii]*q_w2[ii];
+      if((chi_a[ii]<=0) || (qq==0))
+	continue;
+      kl[0]=(ell[il1]+0.5)/chi_a[ii];
+      kl[1]=(ell[il2]+0.5)/chi_a[ii];
+      if((kl[0]<k[0]) || (kl[1]>k[n_k-1]))
+	continue;
+
+      ccl_halomod_workspace *hw_a=ccl_halomod_workspace_new(cosmo,1,&(a[ii]),2,kl,&status);
+      ASSERT_NOT_NULL(hw_a);
+      ccl_halomod_trispectrum_1h(cosmo,hw_a,tk,&status);
+      ccl_halomod_ssc_response(cosmo,hw_a,dpk,&status);
+      ccl_halomod_workspace_free(hw_a);
+
+      for(l=0;l<n_kb;l++) {
+	double kb=exp(lkb_min+l*dlkb),x=kb*chi_a[ii]*theta_s;
+	double wx=(x<1E-6) ? 1. : 2*gsl_sf_bessel_J1(x)/x;
+	double wt=((l==0) || (l==n_kb-1)) ? 0.5 : 1.;
+	sb+=wt*kb*kb*ccl_linear_matter_power(cosmo,kb,a[ii],&status)*wx*wx;
+      }
+      sb*=dlkb/(2*M_PI);
+
+      c_1h+=w_a[ii]*qq*tk[1]/(pow(chi_a[ii],6)*omega_s);
+      c_ssc+=w_a[ii]*qq*dpk[0]*dpk[1]*sb/pow(chi_a[ii],4);
+    }
+    ASSERT_EQUAL(0,status);
+    ASSERT_TRUE(c_1h>0);
+    ASSERT_TRUE(c_ssc!=0);
+    int d1=ccl_covariance_pair_index(2,0,1)*COV_NELL+il1,d2=ccl_covariance_pair_index(2,1,1)*COV_NELL+il2;
+    ASSERT_DBL_NEAR_TOL(1.,cov_1h[d1*n_data+d2]/c_1h,1E-2);
+    ASSERT_DBL_NEAR_TOL(1.,cov_ssc[d1*n_data+d2]/c_ssc,1E-2);
+    free(chi_a);
+  }
+
+  ccl_halomod_workspace_free(hw);
+  ccl_cl_tracer_free(tr[0]);
+  ccl_cl_tracer_free(tr[1]);
+  ccl_cosmology_free(cosmo);
+  free(cov_1h);
+  free(cov_ssc);
+  free(cov_1h_half);
+  free(chi);
+}
@@ -0,0 +1,82 @@
+#include "ccl.h"
+#include "fftlog.h"
+#include "ctest.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#define FFTLOG_N 512
+#define FFTLOG_TOLERANCE 1E-4
+#define FFTLOG_M 3
+
+// Hankel transform of order 0 of a Gaussian:
+// Integral[ r exp(-r^2/2) J_0(k*r) k dr ] = k exp(-k^2/2)
+static void check_gaussian_transform(void)
+{
+  int ii;
+  double r[FFTLOG_N],k[FFTLOG_N];
+  double complex a[FFTLOG_N],b[FFTLOG_N];
+
+  for(ii=0;ii<FFTLOG_N;ii++) {
+    r[ii]=pow(10.,-4+8.*ii/(FFTLOG_N-1.));
+    a[ii]=r[ii]*exp(-0.5*r[ii]*r[ii]);
+  }
+  fht(FFTLOG_N,r,a,k,b,0.,0.,1.,0,NULL);
+  for(ii=0;ii<FFTLOG_N;ii++) {
+    if((k[ii]<1E-2) || (k[ii]>3.))
+      continue;
+    double b_exact=k[ii]*exp(-0.5*k[ii]*k[ii]);
+    ASSERT_DBL_NEAR_TOL(b_exact,creal(b[ii]),FFTLOG_TOLERANCE);
+  }
+}
+
+CTEST(fftlog,cache) {
+  //The second call reuses the cached plans and coefficients
+  check_gaussian_transform();
+  check_gaussian_transform();
+  fftlog_clear_cache();
+  check_gaussian_transform();
+}
+
+CTEST(fftlog,wisdom) {
+  char fname[]="fftlog_wisdom.tmp";
+
+  fftlog_set_measure(1);
+  fftlog_clear_cache();
+  check_gaussian_transform();
+  ASSERT_TRUE(fftlog_export_wisdom(fname));
+  ASSERT_TRUE(fftlog_import_wisdom(fname));
+  remove(fname);
+
+  fftlog_set_measure(0);
+  fftlog_clear_cache();
+  check_gaussian_transform();
+}
+
+CTEST(fftlog,real_batch) {
+  int ii,jj,io;
+  double mu[2]={0.,4.};
+  double r[FFTLOG_N],k[FFTLOG_N],k_many[2*FFTLOG_N];
+  double a_many[FFTLOG_M*FFTLOG_N],b_many[2*FFTLOG_M*FFTLOG_N];
+  double complex a[FFTLOG_N],b[FFTLOG_N];
+
+  for(ii=0;ii<FFTLOG_N;ii++) {
+    r[ii]=pow(10.,-4+8.*ii/(FFTLOG_N-1.));
+    for(jj=0;jj<FFTLOG_M;jj++)
+      a_many[jj*FFTLOG_N+ii]=(jj+1)*r[ii]*exp(-0.5*r[ii]*r[ii]/(jj+1));
+  }
+  fht_real_many(2,mu,FFTLOG_M,FFTLOG_N,r,a_many,k_many,b_many,0,1,1);
+
+  //Compare with the complex transform of each function and order
+  for(io=0;io<2;io++) {
+    for(jj=0;jj<FFTLOG_M;jj++) {
+      for(ii=0;ii<FFTLOG_N;ii++)
+	a[ii]=a_many[jj*FFTLOG_N+ii];
+      fht(FFTLOG_N,r,a,k,b,mu[io],0,1,1,NULL);
+      for(ii=0;ii<FFTLOG_N;ii++) {
+	ASSERT_DBL_NEAR_TOL(1.,k_many[io*FFTLOG_N+ii]/k[ii],1E-10);
+	ASSERT_DBL_NEAR_TOL(creal(b[ii]),b_many[(io*FFTLOG_M+jj)*FFTLOG_N+ii],1E-10);
+      }
+    }
+  }
+}
@@ -2,8 +2,10 @@
 #include "ccl_halomod.h"
 #include "ctest.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <gsl/gsl_sf_expint.h>
 
 // Relative error tolerance in the halomodel matter power spectrum
 #define HALOMOD_TOLERANCE 1E-3
@@ -181,3 +183,282 @@ CTEST2(halomod, model_3) {
   int model = 2;
   compare_halomod(model, data);
 }
+
+// Check the tabulated halo-model engine against the adaptive mass integrals
+CTEST(halomod, mass_table) {
+
+  int status = 0;
+  double mnu = 0.;
+  double k[5] = {1E-3, 1E-2, 0.1, 1., 10.};
+  double a[2] = {1.0, 0.5};
+  double pk_1h[5], pk_2h[5], pk_arr[10];
+
+  ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 0., &mnu, ccl_mnu_sum, -1., 0.,
+						0.7, 0.8, 0.96, -1, -1, -1, -1, NULL, NULL, &status);
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_eisenstein_hu;
+  config.matter_power_spectrum_method = ccl_halo_model;
+  config.mass_function_method = ccl_shethtormen;
+  config.halo_concentration_method = ccl_duffy2008;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  ccl_halomodel_matter_power_array(cosmo, 2, a, 5, k, pk_arr, &status);
+  ASSERT_EQUAL(0, status);
+
+  for (int ia=0; ia<2; ia++) {
+    ccl_halomod_table *tab = ccl_halomod_table_new(cosmo, a[ia], &status);
+    ASSERT_NOT_NULL(tab);
+    ccl_halomod_table_power(cosmo, tab, 5, k, pk_1h, pk_2h, &status);
+    ASSERT_EQUAL(0, status);
+
+    for (int ik=0; ik<5; ik++) {
+      double p1h = ccl_onehalo_matter_power(cosmo, k[ik], a[ia], &status);
+      double p2h = ccl_twohalo_matter_power(cosmo, k[ik], a[ia], &status);
+      ASSERT_DBL_NEAR_TOL(p1h, pk_1h[ik], HALOMOD_TOLERANCE*p1h);
+      ASSERT_DBL_NEAR_TOL(p2h, pk_2h[ik], HALOMOD_TOLERANCE*p2h);
+      ASSERT_DBL_NEAR_TOL(pk_1h[ik]+pk_2h[ik], pk_arr[ia*5+ik], 1E-10*pk_arr[ia*5+ik]);
+    }
+    ccl_halomod_table_free(tab);
+  }
+  ASSERT_EQUAL(0, status);
+
+  ccl_cosmology_free(cosmo);
+}
+
+// Check the NFW Fourier profile against the sine and cosine integrals
+CTEST(halomod, nfw_fourier) {
+
+  double c[3] = {1., 4., 20.};
+  double rv = 1.5;
+  double k[50], uk[50];
+
+  k[0] = 0.;
+  for (int ik=1; ik<50; ik++)
+    k[ik] = pow(10., -3.+5.*(ik-1)/48.);
+
+  for (int ic=0; ic<3; ic++) {
+    double rs = rv/c[ic];
+    double fc = log(1.+c[ic])-c[ic]/(1.+c[ic]);
+
+    ccl_halo_profile_nfw_fourier(rv, c[ic], 50, k, uk);
+    ASSERT_DBL_NEAR_TOL(1., uk[0], 1E-15);
+
+    for (int ik=1; ik<50; ik++) {
+      double ks = k[ik]*rs;
+      double u = (sin(ks)*(gsl_sf_Si(ks*(1.+c[ic]))-gsl_sf_Si(ks))+
+		  cos(ks)*(gsl_sf_Ci(ks*(1.+c[ic]))-gsl_sf_Ci(ks))-
+		  sin(c[ic]*ks)/(ks*(1.+c[ic])))/fc;
+      // The direct form loses precision to cancellations at large k
+      ASSERT_DBL_NEAR_TOL(u, uk[ik], 1E-10*fmax(fabs(u), 1E-4));
+    }
+  }
+}
+
+// Check the catalogue annotation against the scalar functions
+CTEST(halomod, catalog) {
+
+  int status = 0;
+  double mnu = 0.;
+  int n_halo = 5000;
+  double *m = malloc(6*n_halo*sizeof(double));
+  double *z = &(m[n_halo]), *dndlogm = &(m[2*n_halo]), *bias = &(m[3*n_halo]);
+  double *conc = &(m[4*n_halo]), *chi = &(m[5*n_halo]);
+  ASSERT_NOT_NULL(m);
+
+  ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 0., &mnu, ccl_mnu_sum, -1., 0.,
+						0.7, 0.8, 0.96, -1, -1, -1, -1, NULL, NULL, &status);
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_eisenstein_hu;
+  config.matter_power_spectrum_method = ccl_linear;
+  config.mass_function_method = ccl_shethtormen;
+  config.halo_concentration_method = ccl_duffy2008;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  // Half of the haloes sit at a few snapshot redshifts, the rest are spread out
+  unsigned int seed = 1234;
+  for (int i=0; i<n_halo; i++) {
+    seed = 1103515245*seed+12345;
+    double u = (seed>>8)/16777216.;
+    m[i] = pow(10., 11.+4.*u);
+    z[i] = (i%2) ? 0.5*(i%5) : 2.*(1.-u);
+  }
+
+  ccl_halo_catalog_annotate(cosmo, n_halo, m, z, -1., dndlogm, bias, conc, chi, &status);
+  ASSERT_EQUAL(0, status);
+
+  for (int i=0; i<n_halo; i+=7) {
+    double a = 1./(1.+z[i]);
+    double odelta = Dv_BryanNorman(cosmo, a, &status);
+    double mf = ccl_massfunc(cosmo, m[i], a, odelta, &status);
+    double b = ccl_halo_bias(cosmo, m[i], a, odelta, &status);
+    double c = ccl_halo_concentration(cosmo, m[i], a, odelta, &status);
+    double d = ccl_comoving_radial_distance(cosmo, a, &status);
+    ASSERT_DBL_NEAR_TOL(mf, dndlogm[i], 1E-12*mf);
+    ASSERT_DBL_NEAR_TOL(b, bias[i], 1E-12*b);
+    ASSERT_DBL_NEAR_TOL(c, conc[i], 1E-12*c);
+    ASSERT_DBL_NEAR_TOL(d, chi[i], 1E-12*d+1E-12);
+  }
+  ASSERT_EQUAL(0, status);
+
+  ccl_cosmology_free(cosmo);
+  free(m);
+}
+
+// Check the HOD power spectra of a halo-model workspace against direct sums over a mass table
+CTEST(halomod, hod) {
+
+  int status = 0;
+  double mnu = 0.;
+  double k[5] = {1E-3, 1E-2, 0.1, 1., 10.};
+  double a[4] = {0.25, 0.5, 0.75, 1.0};
+  double n_g[4], pk_gg[20], pk_gm[20], pk_mm[20], uk[5];
+  ccl_hod_params hod = {12., 0.3, 12.5, 13.5, 1.};
+
+  ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 0., &mnu, ccl_mnu_sum, -1., 0.,
+						0.7, 0.8, 0.96, -1, -1, -1, -1, NULL, NULL, &status);
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_eisenstein_hu;
+  config.matter_power_spectrum_method = ccl_linear;
+  config.mass_function_method = ccl_shethtormen;
+  config.halo_concentration_method = ccl_duffy2008;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  ccl_halomod_workspace *w = ccl_halomod_workspace_new(cosmo, 4, a, 5, k, &status);
+  ASSERT_NOT_NULL(w);
+  ccl_halomodel_matter_power_array(cosmo, 4, a, 5, k, pk_mm, &status);
+  ccl_halomod_hod_power(cosmo, w, &hod, n_g, pk_gg, pk_gm, &status);
+  ASSERT_EQUAL(0, status);
+
+  for (int ia=0; ia<4; ia++) {
+    ccl_halomod_table *tab = w->tab[ia];
+    double ng = 0, i_g[5] = {0}, i_m[5] = {0}, i_gg[5] = {0}, i_gm[5] = {0};
+
+    for (int im=0; im<tab->n_m; im++) {
+      double m = pow(10, tab->lmass[im]);
+      double wn = tab->weight[im]*tab->dndlogm[im];
+      double n_c = 0.5*(1.+erf((tab->lmass[im]-hod.log10_mmin)/hod.sigma_logm));
+      double f_s = m > pow(10, hod.log10_m0) ?
+	pow((m-pow(10, hod.log10_m0))/pow(10, hod.log10_m1), hod.alpha) : 0;
+      double n_s = n_c*f_s;
+      ccl_halo_profile_nfw_fourier(tab->rdelta[im], tab->conc[im], 5, k, uk);
+      ng += wn*(n_c+n_s);
+      for (int ik=0; ik<5; ik++) {
+	i_g[ik] += wn*tab->bias[im]*(n_c+n_s*uk[ik]);
+	i_m[ik] += wn*tab->bias[im]*m*uk[ik]/tab->rho_m;
+	i_gg[ik] += wn*n_s*uk[ik]*(2.+f_s*uk[ik]);
+	i_gm[ik] += wn*(n_c+n_s*uk[ik])*m*uk[ik]/tab->rho_m;
+      }
+    }
+    ASSERT_DBL_NEAR_TOL(ng, n_g[ia], 1E-10*ng);
+
+    ccl_halo_profile_nfw_fourier(tab->rdelta[0], tab->conc[0], 5, k, uk);
+    for (int ik=0; ik<5; ik++) {
+      double plin = ccl_linear_matter_power(cosmo, k[ik], a[ia], &status);
+      double im = i_m[ik]+tab->corr_2h*uk[ik];
+      double pgg = plin*i_g[ik]*i_g[ik]/(ng*ng)+i_gg[ik]/(ng*ng);
+      double pgm = plin*i_g[ik]*im/ng+i_gm[ik]/ng;
+      ASSERT_DBL_NEAR_TOL(pgg, pk_gg[ia*5+ik], 1E-10*pgg);
+      ASSERT_DBL_NEAR_TOL(pgm, pk_gm[ia*5+ik], 1E-10*pgm);
+      ASSERT_DBL_NEAR_TOL(pk_mm[ia*5+ik], w->pk_mm[ia*5+ik], 1E-10*pk_mm[ia*5+ik]);
+    }
+  }
+
+  // The splines go through the tabulated values
+  ccl_p2d_t *p_gg = NULL, *p_gm = NULL, *p_mm = NULL;
+  ccl_halomod_hod_p2d(cosmo, w, &hod, &p_gg, &p_gm, &p_mm, &status);
+  ASSERT_EQUAL(0, status);
+  for (int ia=0; ia<4; ia++) {
+    for (int ik=0; ik<5; ik++) {
+      double lk = log(k[ik]);
+      ASSERT_DBL_NEAR_TOL(pk_gg[ia*5+ik], ccl_p2d_t_eval(p_gg, lk, a[ia], cosmo, &status), 1E-8*pk_gg[ia*5+ik]);
+      ASSERT_DBL_NEAR_TOL(pk_gm[ia*5+ik], ccl_p2d_t_eval(p_gm, lk, a[ia], cosmo, &status), 1E-8*pk_gm[ia*5+ik]);
+      ASSERT_DBL_NEAR_TOL(pk_mm[ia*5+ik], ccl_p2d_t_eval(p_mm, lk, a[ia], cosmo, &status), 1E-8*pk_mm[ia*5+ik]);
+    }
+  }
+  ASSERT_EQUAL(0, status);
+
+  // Empty grids are rejected
+  ASSERT_NULL(ccl_halomod_workspace_new(cosmo, 0, a, 5, k, &status));
+  ASSERT_EQUAL(CCL_ERROR_INCONSISTENT, status);
+  status = 0;
+
+  // So are grids too small for bicubic splines, and a vanishing central width
+  ccl_halomod_workspace *w_small = ccl_halomod_workspace_new(cosmo, 2, &(a[2]), 5, k, &status);
+  ASSERT_EQUAL(0, status);
+  ccl_halomod_hod_p2d(cosmo, w_small, &hod, &p_gg, NULL, NULL, &status);
+  ASSERT_EQUAL(CCL_ERROR_INCONSISTENT, status);
+  status = 0;
+  hod.sigma_logm = 0;
+  ccl_halomod_hod_power(cosmo, w, &hod, n_g, pk_gg, pk_gm, &status);
+  ASSERT_EQUAL(CCL_ERROR_INCONSISTENT, status);
+  ccl_halomod_workspace_free(w_small);
+
+  ccl_p2d_t_free(p_gg);
+  ccl_p2d_t_free(p_gm);
+  ccl_p2d_t_free(p_mm);
+  ccl_halomod_workspace_free(w);
+  ccl_cosmology_free(cosmo);
+}
+
+// Check the one-halo trispectrum and the super-sample response against direct sums over a mass table
+CTEST(halomod, trispectrum) {
+
+  int status = 0;
+  double mnu = 0.;
+  double k[5] = {1E-3, 1E-2, 0.1, 1., 10.};
+  double a[2] = {0.5, 1.0};
+  double tk[50], dpk[10], uk[5];
+
+  ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 0., &mnu, ccl_mnu_sum, -1., 0.,
+						0.7, 0.8, 0.96, -1, -1, -1, -1, NULL, NULL, &status);
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_eisenstein_hu;
+  config.matter_power_spectrum_method = ccl_linear;
+  config.mass_function_method = ccl_shethtormen;
+  config.halo_concentration_method = ccl_duffy2008;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  ccl_halomod_workspace *w = ccl_halomod_workspace_new(cosmo, 2, a, 5, k, &status);
+  ASSERT_NOT_NULL(w);
+  ccl_halomod_trispectrum_1h(cosmo, w, tk, &status);
+  ccl_halomod_ssc_response(cosmo, w, dpk, &status);
+  ASSERT_EQUAL(0, status);
+
+  for (int ia=0; ia<2; ia++) {
+    ccl_halomod_table *tab = w->tab[ia];
+    double t[25] = {0}, i12[5] = {0};
+
+    for (int im=0; im<tab->n_m; im++) {
+      double mrho = pow(10, tab->lmass[im])/tab->rho_m;
+      double wn = tab->weight[im]*tab->dndlogm[im];
+      ccl_halo_profile_nfw_fourier(tab->rdelta[im], tab->conc[im], 5, k, uk);
+      for (int ik1=0; ik1<5; ik1++) {
+	i12[ik1] += wn*tab->bias[im]*pow(mrho*uk[ik1], 2);
+	for (int ik2=0; ik2<5; ik2++)
+	  t[ik1*5+ik2] += wn*pow(mrho*uk[ik1], 2)*pow(mrho*uk[ik2], 2);
+      }
+    }
+
+    for (int ik1=0; ik1<5; ik1++) {
+      for (int ik2=0; ik2<5; ik2++) {
+	double tv = t[ik1*5+ik2];
+	ASSERT_DBL_NEAR_TOL(tv, tk[(ia*5+ik1)*5+ik2], 1E-10*tv);
+      }
+
+      double pk = w->pk_lin[ia*5+ik1], i_m = w->i_m[ia*5+ik1];
+      double pkp = ccl_linear_matter_power(cosmo, k[ik1]*exp(0.01), a[ia], &status);
+      double pkm = ccl_linear_matter_power(cosmo, k[ik1]*exp(-0.01), a[ia], &status);
+      double dlpk = 3.+log(pkp/pkm)/0.02;
+      double r = (68./21.-dlpk/3.)*i_m*i_m*pk+i12[ik1];
+      ASSERT_DBL_NEAR_TOL(r, dpk[ia*5+ik1], 1E-10*fabs(r));
+    }
+  }
+  ASSERT_EQUAL(0, status);
+
+  ccl_halomod_workspace_free(w);
+  ccl_cosmology_free(cosmo);
+}
@@ -133,3 +133,168 @@ CTEST2(massfunc, model_1) {
    int model = 0;
    compare_massfunc(model, data);
 }
+
+// Check the batched mass function and halo bias against the scalar functions
+CTEST(massfunc, array) {
+  int status = 0;
+  double mnu = 0.;
+  double mass[20], dndlogm[40], bias[40], dndlogm1[20], bias1[20];
+  double a[2] = {1.0, 0.5};
+  mass_function_t methods[2] = {ccl_tinker10, ccl_shethtormen};
+
+  for (int im=0; im<20; im++)
+    mass[im] = pow(10, 10.+0.25*im);
+
+  for (int imf=0; imf<2; imf++) {
+    ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 3.046, &mnu, ccl_mnu_sum,
+						  -1., 0., 0.7, 0.8, 0.96, -1, -1, -1, -1,
+						  NULL, NULL, &status);
+    ccl_configuration config = default_config;
+    config.transfer_function_method = ccl_bbks;
+    config.matter_power_spectrum_method = ccl_linear;
+    config.mass_function_method = methods[imf];
+    ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+    ASSERT_NOT_NULL(cosmo);
+
+    double odelta[2];
+    for (int ia=0; ia<2; ia++)
+      odelta[ia] = (imf == 0) ? 200. : Dv_BryanNorman(cosmo, a[ia], &status);
+
+    ccl_massfunc_bias_grid(cosmo, 2, a, odelta, 20, mass, dndlogm, bias, &status);
+    ASSERT_EQUAL(0, status);
+
+    for (int ia=0; ia<2; ia++) {
+      ccl_massfunc_array(cosmo, 20, mass, a[ia], odelta[ia], dndlogm1, &status);
+      ccl_halo_bias_array(cosmo, 20, mass, a[ia], odelta[ia], bias1, &status);
+      ASSERT_EQUAL(0, status);
+
+      for (int im=0; im<20; im++) {
+	double mf = ccl_massfunc(cosmo, mass[im], a[ia], odelta[ia], &status);
+	double b = ccl_halo_bias(cosmo, mass[im], a[ia], odelta[ia], &status);
+	ASSERT_DBL_NEAR_TOL(mf, dndlogm[ia*20+im], 1E-12*mf);
+	ASSERT_DBL_NEAR_TOL(b, bias[ia*20+im], 1E-12*fabs(b));
+	ASSERT_DBL_NEAR_TOL(mf, dndlogm1[im], 1E-12*mf);
+	ASSERT_DBL_NEAR_TOL(b, bias1[im], 1E-12*fabs(b));
+      }
+    }
+    ASSERT_EQUAL(0, status);
+
+    ccl_cosmology_free(cosmo);
+  }
+}
+
+// Check the tabulated sigma(M,a) against the growth-rescaled sigma(M) at z=0
+CTEST(massfunc, sigma_2d) {
+  int status = 0;
+  double mnu = 0.;
+  double mass[6], dndlogm[18], a[3] = {1.0, 0.5, 0.25}, odelta[3] = {200., 200., 200.};
+
+  for (int im=0; im<6; im++)
+    mass[im] = pow(10, 10.+im);
+
+  ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 3.046, &mnu, ccl_mnu_sum,
+						-1., 0., 0.7, 0.8, 0.96, -1, -1, -1, -1,
+						NULL, NULL, &status);
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  config.mass_function_method = ccl_tinker10;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ccl_cosmology * cosmo_2d = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+  ASSERT_NOT_NULL(cosmo_2d);
+  cosmo_2d->spline_params.SIGMA_SPLINE_2D = 1;
+
+  ccl_massfunc_bias_grid(cosmo_2d, 3, a, odelta, 6, mass, dndlogm, NULL, &status);
+  ASSERT_EQUAL(0, status);
+  ASSERT_NOT_NULL(cosmo_2d->data.logsigma_2d);
+
+  for (int ia=0; ia<3; ia++) {
+    for (int im=0; im<6; im++) {
+      double s = ccl_sigmaM(cosmo, mass[im], a[ia], &status);
+      double s_2d = ccl_sigmaM(cosmo_2d, mass[im], a[ia], &status);
+      double mf = ccl_massfunc(cosmo, mass[im], a[ia], odelta[ia], &status);
+      double mf_2d = ccl_massfunc(cosmo_2d, mass[im], a[ia], odelta[ia], &status);
+      ASSERT_DBL_NEAR_TOL(s, s_2d, 1E-3*s);
+      ASSERT_DBL_NEAR_TOL(mf, mf_2d, 5E-3*mf);
+      ASSERT_DBL_NEAR_TOL(mf_2d, dndlogm[ia*6+im], 1E-12*mf_2d);
+    }
+  }
+  ASSERT_EQUAL(0, status);
+
+  ccl_cosmology_free(cosmo);
+  ccl_cosmology_free(cosmo_2d);
+}
+
+// With massive neutrinos sigma(M,a) is always tabulated from P_lin(k,a), and the mass function
+// and halo bias are available
+CTEST(massfunc, sigma_2d_neutrinos) {
+  int status = 0;
+  double mnu = 0.15;
+  double a[3] = {1.0, 0.5, 0.25};
+
+  ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 3.046, &mnu, ccl_mnu_sum,
+						-1., 0., 0.7, 2.1E-9, 0.96, -1, -1, -1, -1,
+						NULL, NULL, &status);
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_boltzmann_class;
+  config.matter_power_spectrum_method = ccl_linear;
+  config.mass_function_method = ccl_tinker10;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+  ASSERT_TRUE(cosmo->params.N_nu_mass > 0);
+
+  for (int ia=0; ia<3; ia++) {
+    for (int im=0; im<6; im++) {
+      double mass = pow(10, 10.+im);
+      double s = ccl_sigmaR(cosmo, ccl_massfunc_m2r(cosmo, mass, &status), a[ia], &status);
+      double s_2d = ccl_sigmaM(cosmo, mass, a[ia], &status);
+      ASSERT_EQUAL(0, status);
+      ASSERT_DBL_NEAR_TOL(s, s_2d, 1E-3*s);
+
+      double mf = ccl_massfunc(cosmo, mass, a[ia], 200., &status);
+      ASSERT_EQUAL(0, status);
+      ASSERT_TRUE(mf > 0);
+      double b = ccl_halo_bias(cosmo, mass, a[ia], 200., &status);
+      ASSERT_EQUAL(0, status);
+      ASSERT_TRUE(b > 0);
+    }
+  }
+  ASSERT_NOT_NULL(cosmo->data.logsigma_2d);
+
+  ccl_cosmology_free(cosmo);
+}
+
+// Check sigma(M) and its logarithmic slope against direct integrals of the power spectrum
+CTEST(massfunc, sigma_slope) {
+  int status = 0;
+  double mnu = 0., dlm = 0.02;
+
+  ccl_parameters params = ccl_parameters_create(0.25, 0.05, 0., 3.046, &mnu, ccl_mnu_sum,
+						-1., 0., 0.7, 0.8, 0.96, -1, -1, -1, -1,
+						NULL, NULL, &status);
+  ccl_configuration config = default_config;
+  config.transfer_function_method = ccl_bbks;
+  config.matter_power_spectrum_method = ccl_linear;
+  config.mass_function_method = ccl_angulo;
+  ccl_cosmology * cosmo = ccl_cosmology_create(params, config);
+  ASSERT_NOT_NULL(cosmo);
+
+  double rho_m = ccl_constants.RHO_CRITICAL*cosmo->params.Omega_m*cosmo->params.h*cosmo->params.h;
+  for (int im=0; im<9; im++) {
+    double lm = 11.+0.5*im, mass = pow(10, lm);
+    double s = ccl_sigmaR(cosmo, ccl_massfunc_m2r(cosmo, mass, &status), 1., &status);
+    double sp = ccl_sigmaR(cosmo, ccl_massfunc_m2r(cosmo, pow(10, lm+dlm), &status), 1., &status);
+    double sm = ccl_sigmaR(cosmo, ccl_massfunc_m2r(cosmo, pow(10, lm-dlm), &status), 1., &status);
+    double dlns = log(sm/sp)/(2*dlm);
+    ASSERT_DBL_NEAR_TOL(s, ccl_sigmaM(cosmo, mass, 1., &status), 1E-4*s);
+
+    // The Angulo et al. fitting function gives access to dln(1/sigma)/dlog10(M)
+    double f = 0.201*pow(2.08/s+1., 1.7)*exp(-1.172/(s*s));
+    double mf = ccl_massfunc(cosmo, mass, 1., 200., &status);
+    ASSERT_DBL_NEAR_TOL(dlns, mf*mass/(rho_m*f), 2E-3*dlns);
+  }
+  ASSERT_EQUAL(0, status);
+
+  ccl_cosmology_free(cosmo);
+}
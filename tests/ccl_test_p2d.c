@@ -171,3 +171,42 @@ CTEST2(p2d,sanity) {
   
   ccl_cosmology_free(cosmo);
 }
+
+CTEST2(p2d,eval_array) {
+  int status=0;
+  ccl_p2d_t *psp;
+  //Scale factors inside and below the interpolation range, wavenumbers inside and outside
+  double a_ev[3]={0.02,0.5,1.};
+  double lk_ev[4]={data->lk_arr[0]/1.1,-2.,0.5,data->lk_arr[data->n_k-1]*1.1};
+  double pk_ev[12];
+
+  psp=ccl_p2d_t_new(data->n_a,data->a_arr,
+  		    data->n_k,data->lk_arr,
+  		    data->pk_arr,
+  		    2, //extrap_lok
+		    2, //extrap_hik
+  		    ccl_p2d_customgrowth, //extrap_growth
+  		    1, //is_pk_log
+  		    growth_function,0,
+  		    ccl_p2d_3,
+  		    &status);
+  ASSERT_TRUE(status==0);
+
+  //The array version must agree with the point-by-point evaluation
+  ccl_p2d_t_eval_array(psp,4,lk_ev,3,a_ev,NULL,pk_ev,&status);
+  ASSERT_TRUE(status==0);
+  for(int ii=0;ii<3;ii++) {
+    for(int jj=0;jj<4;jj++) {
+      double pk=ccl_p2d_t_eval(psp,lk_ev[jj],a_ev[ii],NULL,&status);
+      ASSERT_TRUE(status==0);
+      ASSERT_DBL_NEAR_TOL(1.,pk_ev[ii*4+jj]/pk,1E-10);
+    }
+  }
+
+  //Get an error if we evaluate above a=1
+  a_ev[2]=1.1;
+  ccl_p2d_t_eval_array(psp,4,lk_ev,3,a_ev,NULL,pk_ev,&status);
+  ASSERT_TRUE(status);
+
+  ccl_p2d_t_free(psp);
+}